@@ -0,0 +1,63 @@
+#include "AndroidAssetSource.h"
+#include "Trace.h"
+
+#include <unistd.h>
+
+namespace soundscape {
+
+    namespace {
+
+        // Holds the asset open so that the buffer stays valid
+        class AndroidAssetData : public AssetData {
+        public:
+            explicit AndroidAssetData(AAsset *asset)
+                    : m_pAsset(asset),
+                      m_pData(static_cast<const unsigned char *>(AAsset_getBuffer(asset))),
+                      m_Size(m_pData ? static_cast<size_t>(AAsset_getLength(asset)) : 0) {
+            }
+
+            ~AndroidAssetData() override { AAsset_close(m_pAsset); }
+
+            const unsigned char *data() const override { return m_pData; }
+
+            size_t size() const override { return m_Size; }
+
+        private:
+            AAsset *m_pAsset;
+            const unsigned char *m_pData;
+            size_t m_Size;
+        };
+
+    } // namespace
+
+    std::unique_ptr<AssetData> AndroidAssetSource::open(const std::string &path) {
+        AAsset *asset = AAssetManager_open(m_pAssetManager, path.c_str(), AASSET_MODE_BUFFER);
+        if (!asset) {
+            TRACE("AndroidAssetSource: failed to open asset: %s", path.c_str());
+            return nullptr;
+        }
+        return std::make_unique<AndroidAssetData>(asset);
+    }
+
+    std::unique_ptr<AssetData> AndroidAssetSource::openMapped(const std::string &path) {
+        // Open without buffering, which for a compressed asset would inflate it into memory
+        AAsset *asset = AAssetManager_open(m_pAssetManager, path.c_str(), AASSET_MODE_UNKNOWN);
+        if (!asset) {
+            TRACE("AndroidAssetSource: failed to open asset: %s", path.c_str());
+            return nullptr;
+        }
+
+        // Only assets stored uncompressed in the APK have a file descriptor
+        off64_t start = 0;
+        off64_t length = 0;
+        int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+        AAsset_close(asset);
+        if (fd < 0)
+            return open(path);
+
+        auto data = mapAssetData(fd, start, static_cast<size_t>(length));
+        close(fd);
+        return data ? std::move(data) : open(path);
+    }
+
+} // soundscape
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <android/asset_manager.h>
+
+#include "AssetSource.h"
+
+namespace soundscape {
+
+    // Assets from the APK. AAssetManager is thread safe, though opens serialise on its lock.
+    class AndroidAssetSource : public AssetSource {
+    public:
+        explicit AndroidAssetSource(AAssetManager *mgr) : m_pAssetManager(mgr) {}
+
+        std::unique_ptr<AssetData> open(const std::string &path) override;
+
+        std::unique_ptr<AssetData> openMapped(const std::string &path) override;
+
+    private:
+        AAssetManager *m_pAssetManager;
+    };
+
+} // soundscape
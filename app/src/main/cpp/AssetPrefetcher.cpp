@@ -0,0 +1,66 @@
+#include "AssetPrefetcher.h"
+#include "WavDecoder.h"
+
+#include <algorithm>
+
+namespace soundscape {
+
+    AssetPrefetcher::AssetPrefetcher(AssetSource *assets) : m_pAssets(assets) {
+        m_Thread = std::thread(&AssetPrefetcher::run, this);
+    }
+
+    AssetPrefetcher::~AssetPrefetcher() {
+        {
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            m_Quit = true;
+            m_Queue.clear();
+        }
+        m_Wake.notify_one();
+        m_Thread.join();
+    }
+
+    void AssetPrefetcher::prefetch(const std::string &path, int targetRate, bool urgent) {
+        {
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            auto queued = std::find_if(m_Queue.begin(), m_Queue.end(), [&](const Request &r) {
+                return r.path == path && r.targetRate == targetRate;
+            });
+            if (queued != m_Queue.end())
+                return;
+
+            if (urgent)
+                m_Queue.push_front({path, targetRate});
+            else
+                m_Queue.push_back({path, targetRate});
+        }
+        m_Wake.notify_one();
+    }
+
+    void AssetPrefetcher::waitUntilIdle() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Idle.wait(lock, [this] { return m_Quit || (m_Queue.empty() && !m_Busy); });
+    }
+
+    void AssetPrefetcher::run() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (!m_Quit) {
+            if (m_Queue.empty()) {
+                m_Busy = false;
+                m_Idle.notify_all();
+                m_Wake.wait(lock);
+                continue;
+            }
+
+            Request request = std::move(m_Queue.front());
+            m_Queue.pop_front();
+            m_Busy = true;
+
+            lock.unlock();
+            WavDecoder::prefetch(m_pAssets, request.path, request.targetRate);
+            lock.lock();
+        }
+        m_Busy = false;
+        m_Idle.notify_all();
+    }
+
+} // soundscape
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "AssetSource.h"
+
+namespace soundscape {
+
+    // Loads assets into the WavDecoder cache on a background thread, so that whatever plays them
+    // first finds them ready rather than decoding them on its own thread. If it gets there before
+    // the prefetch has finished, it waits for the decode already under way instead of starting
+    // another.
+    class AssetPrefetcher {
+    public:
+        // assets must outlive the prefetcher
+        explicit AssetPrefetcher(AssetSource *assets);
+
+        // Abandons anything still queued, but waits for the asset being loaded
+        ~AssetPrefetcher();
+
+        // Queue an asset to be loaded at targetRate. Urgent requests go ahead of anything already
+        // queued. Requests for an asset and rate which is already queued are ignored. Any thread.
+        void prefetch(const std::string &path, int targetRate, bool urgent = false);
+
+        // Block until everything queued has been loaded
+        void waitUntilIdle();
+
+    private:
+        struct Request {
+            std::string path;
+            int targetRate;
+        };
+
+        void run();
+
+        AssetSource *m_pAssets;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Wake;
+        std::condition_variable m_Idle;
+        std::deque<Request> m_Queue;
+        bool m_Busy = false;
+        bool m_Quit = false;
+        std::thread m_Thread;
+    };
+
+} // soundscape
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace soundscape {
+
+    // The contents of an opened asset, valid until it's destroyed
+    class AssetData {
+    public:
+        virtual ~AssetData() = default;
+
+        virtual const unsigned char *data() const = 0;
+
+        virtual size_t size() const = 0;
+
+        // True if data() points into a read-only mapping of the asset rather than a copy
+        virtual bool isMapped() const { return false; }
+
+        // Fault every page of a mapping in, so that the first read of each doesn't stop to wait
+        // for storage or to fill in the page table. Blocks, so never call it on the audio thread.
+        // Nothing to do for a copy.
+        virtual void populate() const {}
+    };
+
+    // Where the engine loads sound assets from: the APK via AAssetManager on Android, or a
+    // directory when running on a host. Implementations must be safe to call from any thread.
+    class AssetSource {
+    public:
+        virtual ~AssetSource() = default;
+
+        // path is relative to the assets root, without any "file:///android_asset/" prefix.
+        // Returns nullptr if the asset can't be opened.
+        virtual std::unique_ptr<AssetData> open(const std::string &path) = 0;
+
+        // As open, but maps the asset straight from storage where that's possible, so that only
+        // the pages in use are resident and the kernel can drop them again under memory pressure.
+        // Falls back to open() otherwise, e.g. for an asset which is compressed in the APK.
+        virtual std::unique_ptr<AssetData> openMapped(const std::string &path) {
+            return open(path);
+        }
+    };
+
+    // Map length bytes of fd starting at offset, which needn't be page aligned. The mapping stays
+    // valid after fd is closed. Returns nullptr on failure.
+    std::unique_ptr<AssetData> mapAssetData(int fd, int64_t offset, size_t length);
+
+    // Assets read from a directory, e.g. app/src/main/assets in a host build
+    class FileAssetSource : public AssetSource {
+    public:
+        explicit FileAssetSource(std::string root);
+
+        std::unique_ptr<AssetData> open(const std::string &path) override;
+
+        std::unique_ptr<AssetData> openMapped(const std::string &path) override;
+
+    private:
+        std::string m_Root;
+    };
+
+} // soundscape
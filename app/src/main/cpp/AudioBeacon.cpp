@@ -15,25 +15,30 @@ PositionedAudio::PositionedAudio(AudioEngine *engine,
                                  bool dimmable,
                                  std::string utterance_id)
         : m_Mode(mode),
-          m_Eof(false),
           m_Dimmable(dimmable) {
     static std::atomic<uint64_t> s_nextHandle{1};
     m_Handle = s_nextHandle.fetch_add(1);
+    m_pEofReporter = std::make_shared<EofReporter>(engine, m_Handle);
     m_pEngine = engine;
     m_UtteranceId = std::move(utterance_id);
 }
 
 PositionedAudio::~PositionedAudio() {
-    // Unregister from mixer
+    // Unregister from mixer, which deletes the source once the audio thread is done with it
     if (m_pAudioSource) {
         auto *mixer = m_pEngine->GetMixer();
         if (mixer) {
-            mixer->removeSource(m_pAudioSource.get());
+            mixer->removeSource(std::move(m_pAudioSource));
         }
     }
     m_pEngine->RemoveBeacon(this);
 }
 
+void EofReporter::Eof() {
+    if (!m_Eof.exchange(true))
+        m_pEngine->Eof(m_Handle);
+}
+
 void PositionedAudio::UpdateAzimuth(double heading, double latitude, double longitude) {
     if (m_Mode.m_AudioType == PositioningMode::RELATIVE) {
         m_pAudioSource->azimuth.store(static_cast<float>(toRadians(m_Mode.m_Heading)));
@@ -60,6 +65,23 @@ void PositionedAudio::RegisterWithMixer() {
 
     m_pAudioSource->category = m_Dimmable ? AudioCategory::BEACON : AudioCategory::SPEECH;
     m_pAudioSource->needsSpatialize = (m_Mode.m_AudioType != PositioningMode::STANDARD);
+    switch (m_Mode.m_AudioType) {
+        case PositioningMode::RELATIVE:
+            m_pAudioSource->azimuthMode = AzimuthMode::RELATIVE;
+            break;
+        case PositioningMode::COMPASS:
+            m_pAudioSource->azimuthMode = AzimuthMode::COMPASS;
+            break;
+        case PositioningMode::LOCALIZED:
+            m_pAudioSource->azimuthMode = AzimuthMode::LOCALIZED;
+            break;
+        default:
+            m_pAudioSource->azimuthMode = AzimuthMode::FIXED;
+            break;
+    }
+    m_pAudioSource->positionHeading = m_Mode.m_Heading;
+    m_pAudioSource->positionLatitude = m_Mode.m_Latitude;
+    m_pAudioSource->positionLongitude = m_Mode.m_Longitude;
 
     double heading, latitude, longitude;
     m_pEngine->GetListenerPosition(heading, latitude, longitude);
@@ -165,14 +187,14 @@ bool Beacon::CreateAudioSource(double degrees_off_axis,
                                int audioFormat,
                                int channelCount,
                                bool proximityBeacon) {
-    auto *mgr = m_pEngine->GetAssetManager();
+    auto *assets = m_pEngine->GetAssetSource();
     int targetRate = m_pEngine->GetMixer() ? m_pEngine->GetMixer()->getSampleRate() : 48000;
 
-    m_pAudioSource = std::make_unique<BeaconBufferGroup>(mgr,
+    m_pAudioSource = std::make_unique<BeaconBufferGroup>(assets,
                                                          proximityBeacon ?
                                                          &msc_ProximityDescriptor
                                                                          : m_pEngine->GetBeaconDescriptor(),
-                                                         this,
+                                                         m_pEofReporter,
                                                          degrees_off_axis,
                                                          targetRate);
     m_pAudioSource->isProximityBeacon = proximityBeacon;
@@ -187,8 +209,10 @@ bool Beacon::CreateAudioSource(double degrees_off_axis,
 TextToSpeech::TextToSpeech(AudioEngine *engine,
                            PositioningMode mode,
                            int tts_socket,
-                           std::string &utterance_id)
+                           std::string &utterance_id,
+                           std::string cache_key)
         : m_TtsSocket(tts_socket),
+          m_CacheKey(std::move(cache_key)),
           PositionedAudio(engine, mode, false, utterance_id) {
     Init(0.0);
 }
@@ -198,15 +222,43 @@ bool TextToSpeech::CreateAudioSource(double degrees_off_axis,
                                      int audioFormat,
                                      int channelCount,
                                      bool proximityBeacon) {
-    m_pAudioSource = std::make_unique<TtsAudioSource>(this,
+    int targetRate = m_pEngine->GetMixer() ? m_pEngine->GetMixer()->getSampleRate() : 48000;
+
+    // The format isn't known until synthesis begins and UpdateAudioConfig is called
+    m_pAudioSource = std::make_unique<TtsAudioSource>(m_pEofReporter,
+                                                      m_pEngine->GetTtsIngest(),
                                                       m_TtsSocket,
-                                                      sampleRate,
+                                                      0,
                                                       audioFormat,
-                                                      channelCount);
+                                                      channelCount,
+                                                      targetRate,
+                                                      &AudioEngine::GetSpeechCache(),
+                                                      m_CacheKey);
     // Text to speech audio are queued to play one after the other
     return true;
 }
 
+//
+// CachedTextToSpeech
+//
+CachedTextToSpeech::CachedTextToSpeech(AudioEngine *engine,
+                                       std::shared_ptr<const TtsCache::Clip> clip,
+                                       PositioningMode mode)
+        : PositionedAudio(engine, mode),
+          m_pClip(std::move(clip)) {
+    Init(0.0);
+}
+
+bool CachedTextToSpeech::CreateAudioSource(double degrees_off_axis,
+                                           int sampleRate,
+                                           int audioFormat,
+                                           int channelCount,
+                                           bool proximityBeacon) {
+    m_pAudioSource = std::make_unique<CachedSpeechSource>(m_pEofReporter, m_pClip);
+    // Queued in turn with the speech still being synthesized
+    return true;
+}
+
 //
 // Earcon
 //
@@ -223,10 +275,11 @@ bool Earcon::CreateAudioSource(double degrees_off_axis,
                                int audioFormat,
                                int channelCount,
                                bool proximityBeacon) {
-    auto *mgr = m_pEngine->GetAssetManager();
+    auto *assets = m_pEngine->GetAssetSource();
     int targetRate = m_pEngine->GetMixer() ? m_pEngine->GetMixer()->getSampleRate() : 48000;
 
-    m_pAudioSource = std::make_unique<EarconSource>(this, m_Asset, mgr, targetRate);
+    m_pAudioSource = std::make_unique<EarconSource>(m_pEofReporter, m_Asset, assets,
+                                                    targetRate);
     // Earcons are queued along with the TextToSpeech audio
     return true;
 }
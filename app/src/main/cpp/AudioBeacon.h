@@ -22,6 +22,23 @@ namespace soundscape {
                     }
             };
 
+    // Tells the engine when a PositionedAudio's source has played all of its audio. The engine
+    // ignores handles it no longer has, so this is safe to call after the PositionedAudio has gone.
+    class EofReporter : public SourceEofListener {
+    public:
+        EofReporter(AudioEngine *engine, uint64_t handle) : m_pEngine(engine), m_Handle(handle) {}
+
+        bool IsEof() const { return m_Eof.load(); }
+
+        // On the audio thread. The engine reaps the audio and starts what's queued next.
+        void Eof() override;
+
+    private:
+        AudioEngine *m_pEngine;
+        uint64_t m_Handle;
+        std::atomic<bool> m_Eof{false};
+    };
+
     class PositionedAudio {
     public:
         PositionedAudio(AudioEngine *engine, PositioningMode mode, bool dimmable = false,
@@ -41,9 +58,7 @@ namespace soundscape {
                                        int channelCount,
                                        bool proximityBeacon) = 0;
 
-        bool IsEof() { return m_Eof; }
-
-        void Eof() { m_Eof = true; }
+        bool IsEof() { return m_pEofReporter->IsEof(); }
 
         void PlayNow();
 
@@ -72,7 +87,8 @@ namespace soundscape {
 
         PositioningMode m_Mode;
 
-        std::atomic<bool> m_Eof;
+        // Given to the audio source as its SourceEofListener
+        std::shared_ptr<EofReporter> m_pEofReporter;
 
         std::unique_ptr<BeaconAudioSource> m_pAudioSource;
         bool m_Dimmable = false;
@@ -114,10 +130,12 @@ namespace soundscape {
     public:
         bool CanStart() override { return m_AudioConfigured; }
 
+        // With a cache_key, the speech is kept in the engine's speech cache once it has played
         TextToSpeech(AudioEngine *engine,
                      PositioningMode mode,
                      int tts_socket,
-                     std::string &utterance_id);
+                     std::string &utterance_id,
+                     std::string cache_key = "");
 
     protected:
         bool CreateAudioSource(double degrees_off_axis,
@@ -127,6 +145,26 @@ namespace soundscape {
                                bool proximityBeacon) final;
 
         int m_TtsSocket;
+        std::string m_CacheKey;
+    };
+
+    // Speech found in the speech cache, queued along with that still to be synthesized
+    class CachedTextToSpeech : public PositionedAudio {
+    public:
+        CachedTextToSpeech(AudioEngine *engine,
+                           std::shared_ptr<const TtsCache::Clip> clip,
+                           PositioningMode mode);
+
+    protected:
+        bool CanStart() override { return true; }
+
+        bool CreateAudioSource(double degrees_off_axis,
+                               int sampleRate,
+                               int audioFormat,
+                               int channelCount,
+                               bool proximityBeacon) final;
+
+        std::shared_ptr<const TtsCache::Clip> m_pClip;
     };
 
     class Earcon : public PositionedAudio {
@@ -1,26 +1,26 @@
 #include <unistd.h>
 #include <thread>
+#include <algorithm>
 #include <cassert>
-#include <android/log.h>
-#include <fcntl.h>
+#include <chrono>
 #include <cmath>
-#include <jni.h>
 #include <cstring>
 #include "AudioBeaconBuffer.h"
 #include "BeaconDescriptor.h"
-#include "AudioBeacon.h"
+#include "MixKernels.h"
 #include "Trace.h"
+#include "WorkStealingPool.h"
 
 using namespace soundscape;
 
 //
 // BeaconBuffer
 //
-BeaconBuffer::BeaconBuffer(AAssetManager *mgr, const std::string &filename,
+BeaconBuffer::BeaconBuffer(AssetSource *assets, const std::string &filename,
                            double max_angle, int targetSampleRate)
         : m_MaxAngle(max_angle),
           m_Name(filename) {
-    m_Decoder = std::make_unique<WavDecoder>(mgr, filename, targetSampleRate);
+    m_Decoder = std::make_unique<WavDecoder>(assets, filename, targetSampleRate);
     if (!m_Decoder->isValid()) {
         TRACE("BeaconBuffer: failed to load %s", filename.c_str());
     }
@@ -42,7 +42,6 @@ unsigned int BeaconBuffer::Read(float *data, unsigned int numFrames, unsigned lo
     }
 
     auto totalFrames = static_cast<unsigned int>(m_Decoder->numFrames());
-    const float *src = m_Decoder->data();
 
     pos %= totalFrames;
     unsigned int remainder = 0;
@@ -53,14 +52,14 @@ unsigned int BeaconBuffer::Read(float *data, unsigned int numFrames, unsigned lo
         toRead = totalFrames - pos;
     }
 
-    memcpy(data, src + pos, toRead * sizeof(float));
+    m_Decoder->read(data, static_cast<int>(pos), static_cast<int>(toRead));
 
     if (remainder) {
         if (pad_with_silence) {
             memset(data + toRead, 0, remainder * sizeof(float));
         } else {
             // Loop from start
-            memcpy(data + toRead, src, remainder * sizeof(float));
+            m_Decoder->read(data + toRead, 0, static_cast<int>(remainder));
         }
     }
 
@@ -70,8 +69,9 @@ unsigned int BeaconBuffer::Read(float *data, unsigned int numFrames, unsigned lo
 //
 // BeaconAudioSource
 //
-BeaconAudioSource::BeaconAudioSource(PositionedAudio *parent, double degrees_off_axis)
-        : m_pParent(parent),
+BeaconAudioSource::BeaconAudioSource(std::shared_ptr<SourceEofListener> listener,
+                                     double degrees_off_axis)
+        : m_pEofListener(std::move(listener)),
           m_DegreesOffAxis(degrees_off_axis) {
 }
 
@@ -84,27 +84,32 @@ void BeaconAudioSource::UpdateGeometry(double degrees_off_axis,
 //
 // BeaconBufferGroup
 //
-BeaconBufferGroup::BeaconBufferGroup(AAssetManager *mgr,
+BeaconBufferGroup::BeaconBufferGroup(AssetSource *assets,
                                      const BeaconDescriptor *beacon_descriptor,
-                                     PositionedAudio *parent,
+                                     std::shared_ptr<SourceEofListener> listener,
                                      double degrees_off_axis,
                                      int targetSampleRate)
-        : BeaconAudioSource(parent, degrees_off_axis) {
+        : BeaconAudioSource(std::move(listener), degrees_off_axis) {
     TRACE("Create BeaconBufferGroup %p", this);
     m_pDescription = beacon_descriptor;
 
-    for (const auto &asset: m_pDescription->m_Beacons) {
-        auto buffer = std::make_unique<BeaconBuffer>(mgr, asset.m_Filename,
-                                                     asset.m_MaxAngle, targetSampleRate);
-        m_pBuffers.push_back(std::move(buffer));
-    }
-
-    m_pIntro = std::make_unique<BeaconBuffer>(mgr,
-                                              "file:///android_asset/Sounds/Route_Start.wav",
-                                              180.0, targetSampleRate);
-    m_pOutro = std::make_unique<BeaconBuffer>(mgr,
-                                              "file:///android_asset/Sounds/Route_End.wav",
-                                              180.0, targetSampleRate);
+    // Load every asset at once across the decode pool, the beacons followed by intro and outro
+    const auto &beacons = m_pDescription->m_Beacons;
+    int count = static_cast<int>(beacons.size());
+    m_pBuffers.resize(count);
+    WorkStealingPool::parallelFor(WavDecoder::decodePool(), count + 2, [&](int i) {
+        if (i < count) {
+            m_pBuffers[i] = std::make_unique<BeaconBuffer>(assets, beacons[i].m_Filename,
+                                                           beacons[i].m_MaxAngle,
+                                                           targetSampleRate);
+        } else if (i == count) {
+            m_pIntro = std::make_unique<BeaconBuffer>(assets, INTRO_ASSET, 180.0,
+                                                      targetSampleRate);
+        } else {
+            m_pOutro = std::make_unique<BeaconBuffer>(assets, OUTRO_ASSET, 180.0,
+                                                      targetSampleRate);
+        }
+    });
 }
 
 BeaconBufferGroup::~BeaconBufferGroup() {
@@ -224,30 +229,36 @@ bool BeaconBufferGroup::isFinished() const {
 // TtsAudioSource
 //
 
-TtsAudioSource::TtsAudioSource(PositionedAudio *parent,
+TtsAudioSource::TtsAudioSource(std::shared_ptr<SourceEofListener> listener,
+                               TtsIngest *ingest,
                                int tts_socket,
-                               int sampleRate, int audioFormat, int channelCount)
-        : BeaconAudioSource(parent, 0) {
-    m_SrcSampleRate = sampleRate;
-    m_SrcAudioFormat = audioFormat;
-    m_SrcChannelCount = channelCount;
-
+                               int sampleRate, int audioFormat, int channelCount,
+                               int targetSampleRate,
+                               TtsCache *cache,
+                               const std::string &cacheKey)
+        : BeaconAudioSource(std::move(listener), 0),
+          m_pIngest(ingest),
+          m_TargetSampleRate(targetSampleRate) {
     // The file descriptor is owned by the object in Kotlin, so use a duplicate.
-    m_TtsSocket = dup(tts_socket);
+    m_pStream = std::make_shared<TtsStream>(dup(tts_socket), targetSampleRate);
+    m_pStream->recordFor(cache, cacheKey);
     m_SourceSocketForDebug = tts_socket;
 
-    // Set it to non-blocking
-    int flags = fcntl(m_TtsSocket, F_GETFL, 0);
-    fcntl(m_TtsSocket, F_SETFL, flags | O_NONBLOCK);
-
-    // Allocate intermediate buffers
-    // Each callback reads ~512 frames at device rate
-    m_RawBuf.resize(4096);
-    m_SrcBuf.resize(4096);
+    if (sampleRate > 0)
+        UpdateAudioConfig(sampleRate, audioFormat, channelCount);
 }
 
 TtsAudioSource::~TtsAudioSource() {
-    close(m_TtsSocket);
+    m_pIngest->remove(*m_pStream);
+}
+
+void TtsAudioSource::UpdateAudioConfig(int sample_rate, int audio_format, int channel_count) {
+    BeaconAudioSource::UpdateAudioConfig(sample_rate, audio_format, channel_count);
+    m_pStream->setFormat(sample_rate, audio_format, channel_count);
+    if (!m_Ingesting) {
+        m_Ingesting = true;
+        m_pIngest->add(m_pStream);
+    }
 }
 
 int TtsAudioSource::readPcm(float *outMono, int numFrames) {
@@ -255,139 +266,170 @@ int TtsAudioSource::readPcm(float *outMono, int numFrames) {
         return 0;
     }
 
-    // Set up resampler if needed (rate may change via UpdateAudioConfig)
-    m_Resampler.setRates(m_SrcSampleRate, deviceSampleRate);
+    // The mixer's rate can change when its output is reopened
+    if (deviceSampleRate != m_TargetSampleRate) {
+        m_TargetSampleRate = deviceSampleRate;
+        m_pStream->setTargetSampleRate(deviceSampleRate);
+    }
+
+    // The ingest thread has already read, converted and resampled the audio, so this only
+    // decides when to play it
+    TtsJitterBuffer &jitter = m_pIngest->jitterBuffer();
+    bool atEnd = m_pStream->atEnd();
+    if (m_BufferState != PLAYING) {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (m_WaitingSinceNs == 0) {
+            m_WaitingSinceNs = now;
+            // Half the ring at most, so that it can always fill that far
+            m_PreRollFrames = std::min(jitter.preRollFrames(deviceSampleRate),
+                                       static_cast<int>(TtsStream::RING_FRAMES / 2));
+        }
 
-    // How many source frames do we need?
-    int srcFramesNeeded = m_Resampler.inputFramesNeeded(numFrames);
-    if (srcFramesNeeded > static_cast<int>(m_SrcBuf.size())) {
-        m_SrcBuf.resize(srcFramesNeeded);
+        // Nothing new since it was first needed, or since it last arrived, for too long. The
+        // socket isn't always closed at the end, so this is often how an utterance finishes.
+        int64_t lastArrivalNs = m_pStream->lastArrivalNs();
+        int64_t limitNs = jitter.stallLimitNs(lastArrivalNs != 0, m_pStream->maxGapNs());
+        bool stalled = !atEnd && now - std::max(lastArrivalNs, m_WaitingSinceNs) > limitNs;
+        int buffered = m_pStream->buffered();
+        if (buffered == 0 && (atEnd || stalled)) {
+            Finish(stalled);
+            return 0;
+        }
+        if (buffered < m_PreRollFrames && !atEnd && !stalled) {
+            m_SilentFrames += numFrames;
+            return 0;
+        }
+
+        if (m_BufferState == PRE_ROLL) {
+            jitter.started(m_SilentFrames, deviceSampleRate);
+        } else {
+            jitter.underrun(m_SilentFrames, deviceSampleRate);
+            m_Underran = true;
+        }
+        m_BufferState = PLAYING;
+        m_SilentFrames = 0;
+        m_WaitingSinceNs = 0;
     }
 
-    // Determine bytes per sample
-    int bytesPerSample;
-    switch (m_SrcAudioFormat) {
-        case 0:
-            bytesPerSample = 1;
-            break;
-        default:
-        case 1:
-            bytesPerSample = 2;
-            break;
-        case 2:
-            bytesPerSample = 4;
-            break;
+    int framesRead = m_pStream->read(outMono, numFrames);
+    m_FramesPlayed += framesRead;
+    if (framesRead < numFrames && !atEnd) {
+        // Ran dry part way through, so buffer up again
+        m_BufferState = REBUFFERING;
+        m_SilentFrames = numFrames - framesRead;
     }
-    int bytesPerFrame = bytesPerSample * m_SrcChannelCount;
-    int rawBytesNeeded = srcFramesNeeded * bytesPerFrame;
-    if (rawBytesNeeded > static_cast<int>(m_RawBuf.size())) {
-        m_RawBuf.resize(rawBytesNeeded);
+    if (framesRead == 0) {
+        if (atEnd)
+            Finish(false);
+        return 0;
     }
 
-    // Read raw PCM data from socket
-    ssize_t totalBytesRead = 0;
-    auto *writePtr = m_RawBuf.data();
-    int remaining = rawBytesNeeded;
-
-#define TIMEOUT_READS_WITHOUT_DATA 5
-
-    while (remaining > 0) {
-        ssize_t bytesRead = read(m_TtsSocket, writePtr, remaining);
-        if (bytesRead == 0) {
-            if (totalBytesRead == 0) {
-                TRACE("TTS EOF socket %d", m_SourceSocketForDebug);
-                m_Finished = true;
-                m_pParent->Eof();
-                return 0;
-            }
-            break;
-        } else if (bytesRead == -1) {
-            ++m_ReadsWithoutData;
-            if (m_ReadsWithoutData > TIMEOUT_READS_WITHOUT_DATA) {
-                m_Finished = true;
-                m_pParent->Eof();
-                return 0;
-            }
-            break;
-        }
-        m_ReadsWithoutData = 0;
-        writePtr += bytesRead;
-        remaining -= static_cast<int>(bytesRead);
-        totalBytesRead += bytesRead;
+    // Zero-fill remainder
+    if (framesRead < numFrames) {
+        memset(outMono + framesRead, 0, (numFrames - framesRead) * sizeof(float));
     }
+    return numFrames;
+}
 
-    // Convert raw bytes to float32 mono
-    int srcFramesRead = static_cast<int>(totalBytesRead / bytesPerFrame);
-    for (int i = 0; i < srcFramesRead; i++) {
-        float sample = 0.0f;
-        for (int ch = 0; ch < m_SrcChannelCount; ch++) {
-            const auto *src = m_RawBuf.data() + (i * bytesPerFrame) + (ch * bytesPerSample);
-            float chSample = 0.0f;
-            if (m_SrcAudioFormat == 0) {
-                chSample = (static_cast<float>(src[0]) - 128.0f) / 128.0f;
-            } else if (m_SrcAudioFormat == 1) {
-                int16_t s;
-                memcpy(&s, src, 2);
-                chSample = static_cast<float>(s) / 32768.0f;
-            } else if (m_SrcAudioFormat == 2) {
-                memcpy(&chSample, src, 4);
-            }
-            sample += chSample;
-        }
-        m_SrcBuf[i] = sample / static_cast<float>(m_SrcChannelCount);
+void TtsAudioSource::Finish(bool stalled) {
+    TRACE("TTS %s socket %d", stalled ? "stalled" : "EOF", m_SourceSocketForDebug);
+    int64_t arrivedFrames, arrivalNs;
+    m_pStream->arrival(arrivedFrames, arrivalNs);
+    m_pIngest->jitterBuffer().finished(m_FramesPlayed, deviceSampleRate, arrivedFrames,
+                                       arrivalNs, m_pStream->maxGapNs(), m_Underran, stalled);
+    m_pStream->finished(m_FramesPlayed);
+    m_Finished = true;
+    m_pEofListener->Eof();
+}
+
+bool TtsAudioSource::isFinished() const {
+    return m_Finished.load();
+}
+
+//
+// CachedSpeechSource
+//
+CachedSpeechSource::CachedSpeechSource(std::shared_ptr<SourceEofListener> listener,
+                                       std::shared_ptr<const TtsCache::Clip> clip)
+        : BeaconAudioSource(std::move(listener), 0.0),
+          m_pClip(std::move(clip)) {
+}
+
+int CachedSpeechSource::readPcm(float *outMono, int numFrames) {
+    if (m_Finished.load()) {
+        return 0;
     }
 
-    // Resample to device rate
-    if (m_Resampler.needsResampling() && srcFramesRead > 0) {
-        int consumed;
-        int outFrames = m_Resampler.process(m_SrcBuf.data(), srcFramesRead,
-                                            outMono, numFrames, consumed);
-        // Zero-fill remainder
-        if (outFrames < numFrames) {
-            memset(outMono + outFrames, 0, (numFrames - outFrames) * sizeof(float));
-        }
-        return outFrames > 0 ? numFrames : 0;
-    } else {
-        // No resampling - direct copy
-        int toCopy = (srcFramesRead < numFrames) ? srcFramesRead : numFrames;
-        memcpy(outMono, m_SrcBuf.data(), toCopy * sizeof(float));
-        if (toCopy < numFrames) {
-            memset(outMono + toCopy, 0, (numFrames - toCopy) * sizeof(float));
-        }
-        return toCopy > 0 ? numFrames : 0;
+    // The clip is at the rate the mixer had when it was recorded. Should the mixer's rate change
+    // under it, resampling would mean building a filter on the audio thread, so it ends instead.
+    if (m_pClip->sampleRate != deviceSampleRate) {
+        m_Finished = true;
+        m_pEofListener->Eof();
+        return 0;
+    }
+
+    size_t total = m_pClip->samples.size();
+    int toRead = static_cast<int>(std::min<size_t>(numFrames, total - m_FramePos));
+    kernels::convertPcm16(outMono, m_pClip->samples.data() + m_FramePos, toRead);
+    m_FramePos += toRead;
+
+    // Reported along with the last of the audio, so that whatever is queued next can follow
+    // straight on
+    if (m_FramePos >= total) {
+        m_Finished = true;
+        m_pEofListener->Eof();
     }
+    if (toRead == 0) {
+        return 0;
+    }
+
+    // Pad with silence if needed
+    if (toRead < numFrames) {
+        memset(outMono + toRead, 0, (numFrames - toRead) * sizeof(float));
+    }
+
+    return numFrames;
 }
 
-bool TtsAudioSource::isFinished() const {
+bool CachedSpeechSource::isFinished() const {
     return m_Finished.load();
 }
 
 //
 // EarconSource
 //
-EarconSource::EarconSource(PositionedAudio *parent, std::string &asset,
-                           AAssetManager *mgr, int targetSampleRate)
-        : BeaconAudioSource(parent, 0.0) {
-    m_Decoder = std::make_unique<WavDecoder>(mgr, asset, targetSampleRate);
+EarconSource::EarconSource(std::shared_ptr<SourceEofListener> listener, std::string &asset,
+                           AssetSource *assets, int targetSampleRate)
+        : BeaconAudioSource(std::move(listener), 0.0) {
+    m_Decoder = std::make_unique<WavDecoder>(assets, asset, targetSampleRate);
     if (!m_Decoder->isValid()) {
         TRACE("EarconSource: failed to load %s", asset.c_str());
     }
 }
 
 int EarconSource::readPcm(float *outMono, int numFrames) {
-    if (!m_Decoder || !m_Decoder->isValid()) {
+    if (m_Finished.load()) {
         return 0;
     }
 
-    int totalFrames = m_Decoder->numFrames();
-    int remaining = totalFrames - static_cast<int>(m_FramePos);
-    if (remaining <= 0) {
-        return 0;
+    // One which failed to load finishes on its first read
+    int totalFrames = 0;
+    int toRead = 0;
+    if (m_Decoder && m_Decoder->isValid()) {
+        totalFrames = m_Decoder->numFrames();
+        toRead = m_Decoder->read(outMono, static_cast<int>(m_FramePos), numFrames);
+        m_FramePos += toRead;
     }
 
-    int toRead = (numFrames < remaining) ? numFrames : remaining;
-    memcpy(outMono, m_Decoder->data() + m_FramePos, toRead * sizeof(float));
-    m_FramePos += toRead;
+    // Finished in the same callback as the last frames are read, not the one after
+    if (static_cast<int>(m_FramePos) >= totalFrames) {
+        m_Finished = true;
+        m_pEofListener->Eof();
+    }
+    if (toRead == 0) {
+        return 0;
+    }
 
     // Pad with silence if needed
     if (toRead < numFrames) {
@@ -398,13 +440,5 @@ int EarconSource::readPcm(float *outMono, int numFrames) {
 }
 
 bool EarconSource::isFinished() const {
-    if (!m_Decoder || !m_Decoder->isValid()) return true;
-    return static_cast<int>(m_FramePos) >= m_Decoder->numFrames();
-}
-
-void EarconSource::UpdateGeometry(double degrees_off_axis,
-                                  BeaconAudioSource::SourceMode mode) {
-    if (isFinished()) {
-        m_pParent->Eof();
-    }
+    return m_Finished.load();
 }
@@ -4,22 +4,29 @@
 #include <atomic>
 #include <vector>
 #include <memory>
-#include <android/asset_manager.h>
 
+#include "AssetSource.h"
 #include "AudioSourceBase.h"
 #include "BeaconDescriptor.h"
 #include "WavDecoder.h"
-#include "SimpleResampler.h"
+#include "TtsCache.h"
+#include "TtsIngest.h"
 
 namespace soundscape {
 
-    class PositionedAudio;
+    // Told when a source has played all of its audio. Sources call Eof once, from readPcm on the
+    // audio thread, so it mustn't block. Sources share ownership of their listener, as the mixer
+    // can still read a source for a callback after whatever created it has been deleted.
+    class SourceEofListener {
+    public:
+        virtual ~SourceEofListener() = default;
 
-    class AudioEngine;
+        virtual void Eof() = 0;
+    };
 
     class BeaconBuffer {
     public:
-        BeaconBuffer(AAssetManager *mgr, const std::string &filename,
+        BeaconBuffer(AssetSource *assets, const std::string &filename,
                      double max_angle, int targetSampleRate);
 
         ~BeaconBuffer();
@@ -42,7 +49,7 @@ namespace soundscape {
 
     class BeaconAudioSource : public AudioSourceBase {
     public:
-        explicit BeaconAudioSource(PositionedAudio *parent,
+        explicit BeaconAudioSource(std::shared_ptr<SourceEofListener> listener,
                                    double degrees_off_axis);
 
         ~BeaconAudioSource() override = default;
@@ -60,14 +67,14 @@ namespace soundscape {
             return !isFinished() && !muted.load() && m_Mode.load() != TOO_FAR_MODE;
         }
 
-        void UpdateAudioConfig(int sample_rate, int audio_format, int channel_count) {
+        virtual void UpdateAudioConfig(int sample_rate, int audio_format, int channel_count) {
             m_SrcSampleRate = sample_rate;
             m_SrcAudioFormat = audio_format;
             m_SrcChannelCount = channel_count;
         }
 
     protected:
-        PositionedAudio *m_pParent;
+        std::shared_ptr<SourceEofListener> m_pEofListener;
 
         int m_SrcSampleRate = 44100;
         int m_SrcAudioFormat = 1;   // 0=PCM8, 1=PCM16, 2=PCMFLOAT
@@ -79,14 +86,18 @@ namespace soundscape {
 
     class BeaconBufferGroup : public BeaconAudioSource {
     public:
-        BeaconBufferGroup(AAssetManager *mgr,
+        BeaconBufferGroup(AssetSource *assets,
                           const BeaconDescriptor *beacon_descriptor,
-                          PositionedAudio *parent,
+                          std::shared_ptr<SourceEofListener> listener,
                           double degrees_off_axis,
                           int targetSampleRate);
 
         ~BeaconBufferGroup() override;
 
+        // Played before the first beat and after the last
+        static constexpr const char *INTRO_ASSET = "file:///android_asset/Sounds/Route_Start.wav";
+        static constexpr const char *OUTRO_ASSET = "file:///android_asset/Sounds/Route_End.wav";
+
         // AudioSourceBase interface
         int readPcm(float *outMono, int numFrames) override;
 
@@ -113,35 +124,76 @@ namespace soundscape {
 
     class TtsAudioSource : public BeaconAudioSource {
     public:
-        TtsAudioSource(PositionedAudio *parent,
+        // The socket is read by ingest, from as soon as its format is known. sampleRate is 0
+        // when it isn't yet, and UpdateAudioConfig then gives it. With a cache and key, the
+        // audio is kept in the cache if all of it plays.
+        TtsAudioSource(std::shared_ptr<SourceEofListener> listener,
+                       TtsIngest *ingest,
                        int tts_socket,
                        int sampleRate,
                        int audioFormat,
-                       int channelCount);
+                       int channelCount,
+                       int targetSampleRate,
+                       TtsCache *cache = nullptr,
+                       const std::string &cacheKey = "");
 
         ~TtsAudioSource() override;
 
+        void UpdateAudioConfig(int sample_rate, int audio_format, int channel_count) override;
+
         // AudioSourceBase interface
         int readPcm(float *outMono, int numFrames) override;
 
         bool isFinished() const override;
 
     private:
-        int m_TtsSocket;
-        int m_ReadsWithoutData = 0;
+        void Finish(bool stalled);
+
+        TtsIngest *m_pIngest;
+        std::shared_ptr<TtsStream> m_pStream;
+        bool m_Ingesting = false;
+        int m_TargetSampleRate;
         int m_SourceSocketForDebug;
         std::atomic<bool> m_Finished{false};
-        SimpleResampler m_Resampler;
 
-        // Intermediate buffer for reading raw socket data
-        std::vector<unsigned char> m_RawBuf;
-        std::vector<float> m_SrcBuf;
+        // Silent until enough is buffered to start, and again after running dry
+        enum BufferState {
+            PRE_ROLL,
+            PLAYING,
+            REBUFFERING
+        };
+        BufferState m_BufferState = PRE_ROLL;
+        int m_PreRollFrames = 0;
+        int m_SilentFrames = 0;
+        int64_t m_WaitingSinceNs = 0;
+        int64_t m_FramesPlayed = 0;
+        bool m_Underran = false;
+    };
+
+    // Speech played from TtsCache rather than the synthesizer. It ends early if the mixer's rate
+    // changes from the clip's.
+    class CachedSpeechSource : public BeaconAudioSource {
+    public:
+        CachedSpeechSource(std::shared_ptr<SourceEofListener> listener,
+                           std::shared_ptr<const TtsCache::Clip> clip);
+
+        ~CachedSpeechSource() override = default;
+
+        // AudioSourceBase interface
+        int readPcm(float *outMono, int numFrames) override;
+
+        bool isFinished() const override;
+
+    private:
+        std::shared_ptr<const TtsCache::Clip> m_pClip;
+        size_t m_FramePos = 0;
+        std::atomic<bool> m_Finished{false};
     };
 
     class EarconSource : public BeaconAudioSource {
     public:
-        EarconSource(PositionedAudio *parent, std::string &asset,
-                     AAssetManager *mgr, int targetSampleRate);
+        EarconSource(std::shared_ptr<SourceEofListener> listener, std::string &asset,
+                     AssetSource *assets, int targetSampleRate);
 
         ~EarconSource() override = default;
 
@@ -150,10 +202,9 @@ namespace soundscape {
 
         bool isFinished() const override;
 
-        void UpdateGeometry(double degrees_off_axis, SourceMode mode) override;
-
     private:
         std::unique_ptr<WavDecoder> m_Decoder;
         unsigned long m_FramePos = 0;
+        std::atomic<bool> m_Finished{false};
     };
 }
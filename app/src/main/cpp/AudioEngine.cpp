@@ -1,18 +1,38 @@
 #include "AudioEngine.h"
 #include "AudioBeacon.h"
 #include "GeoUtils.h"
+#include "OboeAudioOutput.h"
 #include "Trace.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <thread>
 #include <memory>
 #include <mutex>
-#include <android/log.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <android/asset_manager_jni.h>
 #include <jni.h>
 #include <cassert>
 
 namespace soundscape {
 
+    namespace {
+        // Earcons played often enough to be worth having ready as soon as the engine starts
+        const char *const COMMON_EARCONS[] = {
+                "file:///android_asset/Sounds/mode_enter.wav",
+                "file:///android_asset/Sounds/mode_exit.wav",
+                "file:///android_asset/Sounds/callouts_on.wav",
+                "file:///android_asset/Sounds/callouts_off.wav",
+                "file:///android_asset/Sounds/information_alert.wav",
+                "file:///android_asset/Sounds/sense_location.wav",
+                "file:///android_asset/Sounds/sense_mobility.wav",
+                "file:///android_asset/Sounds/sense_poi.wav",
+                "file:///android_asset/Sounds/sense_safety.wav",
+        };
+    } // namespace
+
     const BeaconDescriptor AudioEngine::msc_BeaconDescriptors[] =
             {
                     {
@@ -138,22 +158,152 @@ namespace soundscape {
             };
 
     AudioEngine::AudioEngine(AAssetManager *assetManager) noexcept
-            : m_pAssetManager(assetManager),
+            : m_pAssetSource(std::make_unique<AndroidAssetSource>(assetManager)),
               m_BeaconTypeIndex(1) {
 
         TRACE("%s %p", __FUNCTION__, this);
 
         // Create and start the audio mixer (Oboe + Steam Audio)
-        m_pMixer = std::make_unique<AudioMixer>();
+        auto output = std::make_unique<OboeAudioOutput>(AudioMixer::FRAME_SIZE);
+        m_pOutput = output.get();
+        m_pMixer = std::make_unique<AudioMixer>(std::move(output));
         if (!m_pMixer->start()) {
             TRACE("AudioEngine: mixer failed to start");
         }
+
+        m_pTtsIngest = std::make_unique<TtsIngest>();
+
+        m_EofFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        m_Dispatcher = std::thread(&AudioEngine::DispatchEofs, this);
+
+        m_pPrefetcher = std::make_unique<AssetPrefetcher>(m_pAssetSource.get());
+        for (const char *earcon: COMMON_EARCONS)
+            PrefetchAsset(earcon, false);
+    }
+
+    void AudioEngine::PrefetchAsset(const std::string &path, bool urgent) {
+        int targetRate = m_pMixer ? m_pMixer->getSampleRate() : 48000;
+        if (targetRate <= 0)
+            targetRate = 48000;
+        m_pPrefetcher->prefetch(path, targetRate, urgent);
+    }
+
+    void AudioEngine::SetLowLatency(bool enable) {
+        if (!m_pMixer || m_pOutput->isLowLatencyRequested() == enable)
+            return;
+
+        m_pOutput->setLowLatencyRequested(enable);
+        if (!m_pMixer->reopenOutput())
+            TRACE("AudioEngine: failed to reopen output for low latency %d", enable);
+    }
+
+    std::vector<double> AudioEngine::GetCallbackProfile() {
+        std::vector<double> values;
+        if (!m_pMixer)
+            return values;
+
+        auto report = m_pMixer->getProfile();
+        auto pool = m_pMixer->getEffectPoolStats();
+        values = {
+                report.budgetUs,
+                static_cast<double>(report.callbacks),
+                static_cast<double>(report.deadlineMisses),
+                static_cast<double>(report.voices),
+                static_cast<double>(report.spatializedVoices),
+                static_cast<double>(report.peakVoices),
+                static_cast<double>(m_pMixer->getCallbackContention()),
+                static_cast<double>(m_pOutput->getXRunCount()),
+                static_cast<double>(m_pOutput->getBufferSizeInFrames()),
+                m_pOutput->isLowLatency() ? 1.0 : 0.0,
+                static_cast<double>(pool.hits),
+                static_cast<double>(pool.misses)
+        };
+        auto add = [&values](const CallbackProfiler::Summary &summary) {
+            values.push_back(summary.p50Us);
+            values.push_back(summary.p99Us);
+            values.push_back(summary.maxUs);
+        };
+        add(report.callback);
+        for (const auto &stage: report.stages)
+            add(stage);
+        for (const auto &category: report.categories)
+            add(category);
+        return values;
+    }
+
+    std::vector<double> AudioEngine::GetSpeechBufferStats() {
+        auto stats = m_pTtsIngest->jitterBuffer().getStats();
+        return {
+                static_cast<double>(stats.utterances),
+                static_cast<double>(stats.lateStarts),
+                stats.startDelayMs,
+                stats.maxStartDelayMs,
+                static_cast<double>(stats.underruns),
+                stats.underrunMs,
+                static_cast<double>(stats.stalls),
+                stats.preRollMs,
+                stats.arrivalRate
+        };
+    }
+
+    TtsCache &AudioEngine::GetSpeechCache() {
+        static TtsCache s_SpeechCache;
+        return s_SpeechCache;
+    }
+
+    std::vector<double> AudioEngine::GetSpeechCacheStats() {
+        auto stats = GetSpeechCache().getStats();
+        return {
+                static_cast<double>(stats.bytes),
+                static_cast<double>(stats.budget),
+                static_cast<double>(stats.entries),
+                static_cast<double>(stats.hits),
+                static_cast<double>(stats.misses),
+                static_cast<double>(stats.insertions),
+                static_cast<double>(stats.evictions)
+        };
+    }
+
+    void AudioEngine::TrimMemory(int level) {
+        // ComponentCallbacks2 levels
+        constexpr int TRIM_MEMORY_RUNNING_LOW = 10;
+        constexpr int TRIM_MEMORY_RUNNING_CRITICAL = 15;
+        constexpr int TRIM_MEMORY_UI_HIDDEN = 20;
+        constexpr int TRIM_MEMORY_BACKGROUND = 40;
+
+        // Once memory is critical or the process is a candidate for killing, keep only what's
+        // playing. On the way there keep half, which still covers the current beacon's assets.
+        auto before = WavDecoder::getCacheStats();
+        size_t keep = before.budget;
+        if (level >= TRIM_MEMORY_BACKGROUND || level == TRIM_MEMORY_RUNNING_CRITICAL)
+            keep = 0;
+        else if (level == TRIM_MEMORY_RUNNING_LOW || level == TRIM_MEMORY_UI_HIDDEN)
+            keep = before.budget / 2;
+        WavDecoder::trimCache(keep);
+
+        // Speech is quick enough to synthesize again that it goes first
+        auto &speech = GetSpeechCache();
+        auto speechBefore = speech.getStats();
+        speech.trim(keep < before.budget ? 0 : speechBefore.budget);
+
+        auto after = WavDecoder::getCacheStats();
+        TRACE("TrimMemory %d: asset cache %zu -> %zu bytes, %d entries (%d pinned)", level,
+              before.bytes, after.bytes, after.entries, after.pinnedEntries);
+        TRACE("TrimMemory %d: speech cache %zu -> %zu bytes", level, speechBefore.bytes,
+              speech.getStats().bytes);
     }
 
     AudioEngine::~AudioEngine() {
 
         TRACE("%s %p", __FUNCTION__, this);
 
+        // Nothing is reaped behind the destructor's back from here on
+        m_DispatcherQuit = true;
+        uint64_t one = 1;
+        if (write(m_EofFd, &one, sizeof(one)) < 0)
+            TRACE("AudioEngine: failed to wake dispatcher %d", errno);
+        m_Dispatcher.join();
+
         {
             std::lock_guard<std::recursive_mutex> guard(m_BeaconsMutex);
 
@@ -171,6 +321,9 @@ namespace soundscape {
             m_pMixer->stop();
         }
 
+        // The audio thread could report finished audio until the mixer stopped
+        close(m_EofFd);
+
         TRACE("AudioEngine destroyed");
 
         // We rely on clearBeaconEventsListener having been called prior to this call
@@ -179,6 +332,8 @@ namespace soundscape {
     }
 
     void AudioEngine::SetBeaconEventsListener(JNIEnv *env, jobject listener_obj) {
+        std::lock_guard<std::mutex> guard(m_ListenerMutex);
+
         // Store the JavaVM pointer
         if (env->GetJavaVM(&m_pJvm) != JNI_OK) {
             TRACE("AudioEngine::SetBeaconEventsListener - Failed to get JavaVM");
@@ -212,55 +367,87 @@ namespace soundscape {
             m_jBeaconListener = nullptr;
             return;
         }
+
+        m_jMethodId_onAudioFinished = env->GetMethodID(listener_class, "onAudioFinished",
+                                                       "(J)V");
+        if (m_jMethodId_onAudioFinished == nullptr) {
+            TRACE("AudioEngine::SetBeaconEventsListener - Failed to get method ID for onAudioFinished");
+            env->DeleteGlobalRef(m_jBeaconListener);
+            m_jBeaconListener = nullptr;
+            return;
+        }
         TRACE("AudioEngine::SetBeaconEventsListener - Successfully set up listener.");
     }
 
     void AudioEngine::ClearBeaconEventsListener(JNIEnv *env) {
+        std::lock_guard<std::mutex> guard(m_ListenerMutex);
         if (m_jBeaconListener != nullptr) {
             env->DeleteGlobalRef(m_jBeaconListener);
             m_jBeaconListener = nullptr;
             m_pJvm = nullptr;
             m_jMethodId_onAllBeaconsCleared = nullptr;
+            m_jMethodId_onAudioFinished = nullptr;
             TRACE("AudioEngine::ClearBeaconEventsListener - Listener cleared.");
         }
     }
 
-    void AudioEngine::NotifyAllBeaconsCleared(int line) {
-        if (m_pJvm == nullptr || m_jBeaconListener == nullptr ||
-            m_jMethodId_onAllBeaconsCleared == nullptr) {
-            TRACE("NotifyAllBeaconsCleared: JNI listener not set up, cannot notify Kotlin.");
-            return;
-        }
-
+    bool AudioEngine::CallListener(ListenerMethod method, uint64_t handle) {
         JNIEnv *env;
+        jobject listener;
+        jmethodID methodId;
         bool didAttach = false;
-        int getEnvStat = m_pJvm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6);
+        {
+            // Only long enough to take a reference to the listener, so that Kotlin can clear it
+            // whilst it's being called
+            std::lock_guard<std::mutex> guard(m_ListenerMutex);
+            methodId = method == AUDIO_FINISHED ? m_jMethodId_onAudioFinished
+                                                : m_jMethodId_onAllBeaconsCleared;
+            if (m_pJvm == nullptr || m_jBeaconListener == nullptr || methodId == nullptr) {
+                TRACE("CallListener: JNI listener not set up, cannot notify Kotlin.");
+                return false;
+            }
 
-        if (getEnvStat == JNI_EDETACHED) {
-            if (m_pJvm->AttachCurrentThread(&env, nullptr) != 0) {
-                TRACE("NotifyAllBeaconsCleared: Failed to attach current thread to JVM");
-                return;
+            int getEnvStat = m_pJvm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6);
+            if (getEnvStat == JNI_EDETACHED) {
+                if (m_pJvm->AttachCurrentThread(&env, nullptr) != 0) {
+                    TRACE("CallListener: Failed to attach current thread to JVM");
+                    return false;
+                }
+                didAttach = true;
+            } else if (getEnvStat == JNI_EVERSION) {
+                TRACE("CallListener: JNI version not supported");
+                return false;
             }
-            didAttach = true;
-        } else if (getEnvStat == JNI_EVERSION) {
-            TRACE("NotifyAllBeaconsCleared: JNI version not supported");
-            return;
-        } else if (getEnvStat == JNI_OK) {
-            // Already attached
+            listener = env->NewLocalRef(m_jBeaconListener);
         }
 
-        env->CallVoidMethod(m_jBeaconListener, m_jMethodId_onAllBeaconsCleared);
+        if (method == AUDIO_FINISHED)
+            env->CallVoidMethod(listener, methodId, static_cast<jlong>(handle));
+        else
+            env->CallVoidMethod(listener, methodId);
 
         if (env->ExceptionCheck()) {
-            TRACE("NotifyAllBeaconsCleared: Exception occurred calling Kotlin method");
+            TRACE("CallListener: Exception occurred calling Kotlin method");
             env->ExceptionDescribe();
             env->ExceptionClear();
         }
+        env->DeleteLocalRef(listener);
 
         if (didAttach) {
-            m_pJvm->DetachCurrentThread();
+            JavaVM *jvm;
+            if (env->GetJavaVM(&jvm) == JNI_OK)
+                jvm->DetachCurrentThread();
         }
-        TRACE("NotifyAllBeaconsCleared from %d: Kotlin notified.", line);
+        return true;
+    }
+
+    void AudioEngine::NotifyAllBeaconsCleared(int line) {
+        if (CallListener(ALL_BEACONS_CLEARED))
+            TRACE("NotifyAllBeaconsCleared from %d: Kotlin notified.", line);
+    }
+
+    void AudioEngine::NotifyAudioFinished(uint64_t handle) {
+        CallListener(AUDIO_FINISHED, handle);
     }
 
     void
@@ -299,30 +486,31 @@ namespace soundscape {
             }
         }
 
-        // store pos for next time
-        m_LastLatitude = listenerLatitude;
-        m_LastLongitude = listenerLongitude;
-        m_LastHeading = listenerHeading;
-
+        // store pos for next time, and hand it to the mixer so that it can track the listener's
+        // heading between updates
+        ListenerPose pose;
+        pose.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        pose.heading = listenerHeading;
+        pose.latitude = listenerLatitude;
+        pose.longitude = listenerLongitude;
+        m_ListenerPose.store(pose);
+        if (m_pMixer)
+            m_pMixer->setListenerPose(pose);
+
+        std::vector<uint64_t> finished;
         {
             std::lock_guard<std::recursive_mutex> guard(m_BeaconsMutex);
 
             bool wasEmpty = m_Beacons.empty();
 
+            // The dispatcher normally has these already
             auto it = m_Beacons.begin();
-            bool start_next = false;
             while (it != m_Beacons.end()) {
                 if ((*it)->IsEof()) {
-                    if (*m_QueuedBeacons.begin() == *it) {
-                        m_QueuedBeacons.pop_front();
-                        start_next = true;
-                        m_QueuedBeaconPlaying = false;
-                    }
-
-                    auto id = (long long) *it;
-                    delete *it;
+                    finished.push_back((*it)->m_Handle);
+                    Reap(*it);
                     it = m_Beacons.begin();
-                    Eof(id);
                     continue;
                 }
 
@@ -331,30 +519,112 @@ namespace soundscape {
                                       proximityNear);
                 ++it;
             }
-            if (!m_QueuedBeacons.empty()) {
-                auto queued_beacon = *m_QueuedBeacons.begin();
-                if (start_next && queued_beacon->CanStart()) {
-                    m_Beacons.insert(queued_beacon);
-                    queued_beacon->PlayNow();
-                    m_QueuedBeaconPlaying = true;
-                } else if (!m_QueuedBeaconPlaying) {
-                    if (queued_beacon->CanStart()) {
-                        m_Beacons.insert(queued_beacon);
-                        queued_beacon->PlayNow();
-                        m_QueuedBeaconPlaying = true;
+            StartNextQueued();
+
+            if (m_Beacons.empty() && !wasEmpty && m_QueuedBeacons.empty()) {
+                NotifyAllBeaconsCleared(__LINE__);
+            }
+        }
+        for (auto handle: finished)
+            NotifyAudioFinished(handle);
+    }
+
+    void AudioEngine::Reap(PositionedAudio *beacon) {
+        if (!m_QueuedBeacons.empty() && m_QueuedBeacons.front() == beacon) {
+            m_QueuedBeacons.pop_front();
+            m_QueuedBeaconPlaying = false;
+        }
+        // Deleting it removes it from m_Beacons
+        delete beacon;
+    }
+
+    void AudioEngine::StartNextQueued() {
+        if (m_QueuedBeaconPlaying || m_QueuedBeacons.empty())
+            return;
+
+        auto *next = m_QueuedBeacons.front();
+        if (next->CanStart()) {
+            m_Beacons.insert(next);
+            next->PlayNow();
+            m_QueuedBeaconPlaying = true;
+        }
+    }
+
+    void AudioEngine::Eof(uint64_t handle) {
+        // Should the queue ever fill, UpdateGeometry will find the rest
+        if (!m_Eofs.push(handle))
+            return;
+        uint64_t one = 1;
+        if (write(m_EofFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            TRACE("AudioEngine: failed to wake dispatcher %d", errno);
+    }
+
+    void AudioEngine::DispatchEofs() {
+        // Attached to the JVM for as long as it runs, rather than for each callback
+        JavaVM *attachedJvm = nullptr;
+
+        pollfd wake{m_EofFd, POLLIN, 0};
+        while (true) {
+            if (poll(&wake, 1, -1) < 0 && errno != EINTR) {
+                TRACE("AudioEngine: dispatcher poll failed %d", errno);
+                break;
+            }
+            uint64_t value;
+            while (read(m_EofFd, &value, sizeof(value)) > 0) {
+            }
+            if (m_DispatcherQuit.load())
+                break;
+
+            std::vector<uint64_t> finished;
+            bool cleared;
+            {
+                std::lock_guard<std::recursive_mutex> guard(m_BeaconsMutex);
+                bool wasEmpty = m_Beacons.empty();
+
+                // Anything deleted since it finished, by ClearQueue for instance, is no longer
+                // in m_Beacons
+                uint64_t handle;
+                while (m_Eofs.pop(handle)) {
+                    auto it = std::find_if(m_Beacons.begin(), m_Beacons.end(),
+                                           [handle](PositionedAudio *beacon) {
+                                               return beacon->m_Handle == handle;
+                                           });
+                    if (it != m_Beacons.end() && (*it)->IsEof()) {
+                        Reap(*it);
+                        finished.push_back(handle);
                     }
                 }
+                StartNextQueued();
+                cleared = !wasEmpty && m_Beacons.empty() && m_QueuedBeacons.empty();
             }
 
-            if (m_Beacons.empty() && !wasEmpty && m_QueuedBeacons.empty()) {
-                NotifyAllBeaconsCleared(__LINE__);
+            if (attachedJvm == nullptr && (cleared || !finished.empty())) {
+                std::lock_guard<std::mutex> guard(m_ListenerMutex);
+                JNIEnv *env;
+                if (m_pJvm && m_pJvm->AttachCurrentThread(&env, nullptr) == JNI_OK)
+                    attachedJvm = m_pJvm;
             }
+            for (auto handle: finished)
+                NotifyAudioFinished(handle);
+            if (cleared)
+                NotifyAllBeaconsCleared(__LINE__);
         }
+
+        if (attachedJvm)
+            attachedJvm->DetachCurrentThread();
     }
 
     void AudioEngine::SetBeaconType(int beaconType) {
         if (beaconType < (sizeof(msc_BeaconDescriptors) / sizeof(BeaconDescriptor))) {
             m_BeaconTypeIndex = beaconType;
+
+            // The next beacon will need all of these, ahead of anything else being prefetched.
+            // Each goes to the front of the queue, so they're queued in reverse order of use.
+            const auto &descriptor = msc_BeaconDescriptors[beaconType];
+            PrefetchAsset(BeaconBufferGroup::OUTRO_ASSET, true);
+            for (auto it = descriptor.m_Beacons.rbegin(); it != descriptor.m_Beacons.rend(); ++it)
+                PrefetchAsset(it->m_Filename, true);
+            PrefetchAsset(BeaconBufferGroup::INTRO_ASSET, true);
             return;
         }
         TRACE("BeaconType failed, invalid type: %d", beaconType);
@@ -400,18 +670,16 @@ namespace soundscape {
                 queued_beacon->UpdateAudioConfig(sample_rate, audio_format, channel_count);
             }
         }
+
+        // It may have been waiting for this to start
+        StartNextQueued();
     }
 
     uint64_t AudioEngine::AddBeacon(PositionedAudio *beacon, bool queued) {
         std::lock_guard<std::recursive_mutex> guard(m_BeaconsMutex);
         if (queued) {
-            if (m_QueuedBeacons.empty() && beacon->CanStart()) {
-                TRACE("First beacon in queue - PlayNow");
-                beacon->PlayNow();
-                m_Beacons.insert(beacon);
-                m_QueuedBeaconPlaying = true;
-            }
             m_QueuedBeacons.push_back(beacon);
+            StartNextQueued();
         } else {
             beacon->Mute(m_BeaconMute);
             m_Beacons.insert(beacon);
@@ -436,11 +704,6 @@ namespace soundscape {
         return m_BeaconMute;
     }
 
-    void AudioEngine::Eof(long long id) {
-        // This could be used to generate callbacks to the kotlin code
-        // to indicate that some audio has finished.
-    }
-
 } // soundscape
 
 extern "C"
@@ -645,7 +908,8 @@ Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_createNativeTextToS
         jdouble longitude,
         jdouble heading,
         jint tts_socket,
-        jstring utterance_id) {
+        jstring utterance_id,
+        jstring cache_key) {
     auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
     if (ae) {
 
@@ -653,6 +917,10 @@ Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_createNativeTextToS
         std::string id_string(id);
         env->ReleaseStringUTFChars(utterance_id, id);
 
+        const char *key = env->GetStringUTFChars(cache_key, nullptr);
+        std::string key_string(key);
+        env->ReleaseStringUTFChars(cache_key, key);
+
         auto tts = std::make_unique<soundscape::TextToSpeech>(
                 ae,
                 soundscape::PositioningMode(
@@ -662,7 +930,8 @@ Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_createNativeTextToS
                         longitude,
                         heading),
                 tts_socket,
-                id_string
+                id_string,
+                key_string
         );
         if (not tts) {
             TRACE("Failed to create text to speech");
@@ -676,6 +945,45 @@ Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_createNativeTextToS
     return 0L;
 }
 
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_createNativeCachedTextToSpeech(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jlong engine_handle,
+        jint mode,
+        jdouble latitude,
+        jdouble longitude,
+        jdouble heading,
+        jstring cache_key) {
+    auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
+    if (ae) {
+        const char *key = env->GetStringUTFChars(cache_key, nullptr);
+        std::string key_string(key);
+        env->ReleaseStringUTFChars(cache_key, key);
+
+        // Kept at the rate it was recorded at, so only of use if the mixer is still at it
+        int rate = ae->GetMixer() ? ae->GetMixer()->getSampleRate() : 48000;
+        auto clip = soundscape::AudioEngine::GetSpeechCache().find(key_string, rate);
+        if (!clip)
+            return 0L;
+
+        auto tts = std::make_unique<soundscape::CachedTextToSpeech>(
+                ae,
+                clip,
+                soundscape::PositioningMode(
+                        static_cast<soundscape::PositioningMode::AudioType>(mode),
+                        soundscape::PositioningMode::HEADING,
+                        latitude,
+                        longitude,
+                        heading));
+        auto handle = tts->m_Handle;
+        tts.release();
+        return static_cast<jlong>(handle);
+    }
+    return 0L;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_clearNativeTextToSpeechQueue(
@@ -766,6 +1074,154 @@ Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setHrtfEnabled(
     }
 }
 
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setAmbisonicsOrder(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jlong engine_handle,
+        jint order) {
+    auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
+    if (ae) {
+        ae->SetAmbisonicsOrder(order);
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setLowLatencyMode(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jlong engine_handle,
+        jboolean enabled) {
+    auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
+    if (ae) {
+        ae->SetLowLatency(enabled);
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setProcessingBlockSize(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jlong engine_handle,
+        jint frames) {
+    auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
+    if (ae) {
+        ae->SetProcessingBlockSize(frames);
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setSpatializerType(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jlong engine_handle,
+        jint type) {
+    auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
+    if (ae) {
+        ae->SetSpatializerType(type);
+    }
+}
+
+extern "C"
+JNIEXPORT jdoubleArray JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_getCallbackProfile(
+        JNIEnv *env,
+        jobject thiz MAYBE_UNUSED,
+        jlong engine_handle) {
+    auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
+    if (!ae)
+        return nullptr;
+
+    auto values = ae->GetCallbackProfile();
+    jdoubleArray array = env->NewDoubleArray(static_cast<jsize>(values.size()));
+    if (array)
+        env->SetDoubleArrayRegion(array, 0, static_cast<jsize>(values.size()), values.data());
+    return array;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setSpeechBuffering(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jlong engine_handle,
+        jint pre_roll_ms,
+        jint max_pre_roll_ms,
+        jint start_timeout_ms,
+        jint stall_timeout_ms) {
+    auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
+    if (ae) {
+        soundscape::TtsBufferConfig config;
+        config.preRollMs = pre_roll_ms;
+        config.maxPreRollMs = max_pre_roll_ms;
+        config.startTimeoutMs = start_timeout_ms;
+        config.stallTimeoutMs = stall_timeout_ms;
+        ae->SetSpeechBuffering(config);
+    }
+}
+
+extern "C"
+JNIEXPORT jdoubleArray JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_getSpeechBufferStats(
+        JNIEnv *env,
+        jobject thiz MAYBE_UNUSED,
+        jlong engine_handle) {
+    auto *ae = reinterpret_cast<soundscape::AudioEngine *>(engine_handle);
+    if (!ae)
+        return nullptr;
+
+    auto values = ae->GetSpeechBufferStats();
+    jdoubleArray array = env->NewDoubleArray(static_cast<jsize>(values.size()));
+    if (array)
+        env->SetDoubleArrayRegion(array, 0, static_cast<jsize>(values.size()), values.data());
+    return array;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_trimMemory(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jint level) {
+    soundscape::AudioEngine::TrimMemory(level);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setAssetCacheBudget(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jlong bytes) {
+    if (bytes >= 0)
+        soundscape::AudioEngine::SetAssetCacheBudget(static_cast<size_t>(bytes));
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setSpeechCacheBudget(
+        JNIEnv *env MAYBE_UNUSED,
+        jobject thiz MAYBE_UNUSED,
+        jlong bytes) {
+    if (bytes >= 0)
+        soundscape::AudioEngine::SetSpeechCacheBudget(static_cast<size_t>(bytes));
+}
+
+extern "C"
+JNIEXPORT jdoubleArray JNICALL
+Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_getNativeSpeechCacheStats(
+        JNIEnv *env,
+        jobject thiz MAYBE_UNUSED) {
+    auto values = soundscape::AudioEngine::GetSpeechCacheStats();
+    jdoubleArray array = env->NewDoubleArray(static_cast<jsize>(values.size()));
+    if (array)
+        env->SetDoubleArrayRegion(array, 0, static_cast<jsize>(values.size()), values.data());
+    return array;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_org_scottishtecharmy_soundscape_audio_NativeAudioEngine_setSuppressRestart(
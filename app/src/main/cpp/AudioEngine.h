@@ -6,11 +6,19 @@
 #include <mutex>
 #include <jni.h>
 #include <android/asset_manager.h>
+#include "AndroidAssetSource.h"
+#include "AssetPrefetcher.h"
 #include "BeaconDescriptor.h"
 #include "AudioMixer.h"
+#include "SpscQueue.h"
+#include "TtsCache.h"
+#include "TtsIngest.h"
+#include "WavDecoder.h"
 
 namespace soundscape {
 
+    class OboeAudioOutput;
+
     /**
      * iOS Soundscape supports a number of different sound types. Although the terms used are 2D and
      * 3D audio, we're really dealing with 1D (no positioning) and 2D audio (positioned on a plane).
@@ -69,7 +77,9 @@ namespace soundscape {
 
         AudioMixer *GetMixer() { return m_pMixer.get(); }
 
-        AAssetManager *GetAssetManager() const { return m_pAssetManager; }
+        AssetSource *GetAssetSource() const { return m_pAssetSource.get(); }
+
+        TtsIngest *GetTtsIngest() const { return m_pTtsIngest.get(); }
 
         void SetBeaconType(int beaconType);
 
@@ -81,7 +91,9 @@ namespace soundscape {
 
         bool ToggleBeaconMute();
 
-        void Eof(long long id);
+        // The audio with handle has finished. Called on the audio thread, so only queues it for
+        // the dispatcher thread and wakes it, without locking or allocating.
+        void Eof(uint64_t handle);
 
         void BeaconDestroyed();
 
@@ -93,9 +105,10 @@ namespace soundscape {
         const static BeaconDescriptor msc_BeaconDescriptors[];
 
         void GetListenerPosition(double &heading, double &latitude, double &longitude) const {
-            heading = m_LastHeading;
-            latitude = m_LastLatitude;
-            longitude = m_LastLongitude;
+            auto pose = m_ListenerPose.load();
+            heading = pose.heading;
+            latitude = pose.latitude;
+            longitude = pose.longitude;
         }
 
         void ClearQueue();
@@ -106,6 +119,55 @@ namespace soundscape {
 
         void SetUseHrtf(bool use) { if (m_pMixer) m_pMixer->setUseHrtf(use); }
 
+        void SetAmbisonicsOrder(int order) { if (m_pMixer) m_pMixer->setAmbisonicsOrder(order); }
+
+        void SetLowLatency(bool enable);
+
+        void SetProcessingBlockSize(int frames) {
+            if (m_pMixer)
+                m_pMixer->setProcessingBlockSize(frames);
+        }
+
+        // 0 for Steam Audio, 1 for the built in convolution renderer
+        void SetSpatializerType(int type) {
+            if (m_pMixer)
+                m_pMixer->setSpatializerType(type == 1 ? SpatializerType::CONVOLUTION
+                                                       : SpatializerType::STEAM_AUDIO);
+        }
+
+        // Mixer callback profile flattened for JNI, in the order NativeAudioEngine unpacks it:
+        // budget, callbacks, deadline misses, voices, spatialized voices, peak voices, contention,
+        // xruns, buffer size, low latency, effect pool hits and misses, then p50/p99/max in
+        // microseconds for the whole
+        // callback, each CallbackProfiler stage and each category.
+        std::vector<double> GetCallbackProfile();
+
+        void SetSpeechBuffering(const TtsBufferConfig &config) {
+            m_pTtsIngest->jitterBuffer().setConfig(config);
+        }
+
+        // Text to speech buffering statistics flattened for JNI, in the order SpeechBufferStats
+        // unpacks them: utterances, late starts, total and max start delay, underruns, underrun
+        // time, stalls, current pre-roll and arrival rate.
+        std::vector<double> GetSpeechBufferStats();
+
+        // Synthesized speech kept for reuse. Shared by all engines, like the asset cache, and
+        // keyed by everything which affects how speech sounds, so an engine change doesn't
+        // need it emptying.
+        static TtsCache &GetSpeechCache();
+
+        static void SetSpeechCacheBudget(size_t bytes) { GetSpeechCache().setBudget(bytes); }
+
+        // Speech cache statistics flattened for JNI, in the order SpeechCacheStats unpacks them:
+        // bytes, budget, entries, hits, misses, insertions and evictions.
+        static std::vector<double> GetSpeechCacheStats();
+
+        // Shrink the decoded asset and speech caches for an onTrimMemory level. The cache is shared by all
+        // engines, so these don't need one.
+        static void TrimMemory(int level);
+
+        static void SetAssetCacheBudget(size_t bytes) { WavDecoder::setCacheBudget(bytes); }
+
         void SetSuppressRestart(bool suppress) {
             if (m_pMixer)
                 m_pMixer->setSuppressRestart(suppress);
@@ -117,12 +179,14 @@ namespace soundscape {
                                int channel_count);
 
     private:
-        AAssetManager *m_pAssetManager;
+        std::unique_ptr<AndroidAssetSource> m_pAssetSource;
+        std::unique_ptr<AssetPrefetcher> m_pPrefetcher;
+        std::unique_ptr<TtsIngest> m_pTtsIngest;
         std::unique_ptr<AudioMixer> m_pMixer;
+        OboeAudioOutput *m_pOutput = nullptr;     // owned by the mixer
 
-        double m_LastLatitude = 0.0;
-        double m_LastLongitude = 0.0;
-        double m_LastHeading = 0.0;
+        // Written by UpdateGeometry, read from whichever thread creates audio
+        SeqLock<ListenerPose> m_ListenerPose{ListenerPose{0, 0.0, 0.0, 0.0}};
         std::chrono::time_point<std::chrono::system_clock> m_LastTime;
 
         std::atomic<int> m_BeaconTypeIndex;
@@ -134,13 +198,48 @@ namespace soundscape {
 
         bool m_BeaconMute = false;
 
-        // For JNI callbacks
+        // Finished audio, reported by the audio thread. The dispatcher reaps it and starts
+        // whatever is queued next as soon as it's woken, rather than on the next UpdateGeometry,
+        // which still catches anything the dispatcher misses.
+        static constexpr size_t EOF_QUEUE_SIZE = 64;
+        SpscQueue<uint64_t, EOF_QUEUE_SIZE> m_Eofs;
+        int m_EofFd = -1;
+        std::atomic<bool> m_DispatcherQuit{false};
+        std::thread m_Dispatcher;
+
+        // For JNI callbacks. The listener is set and cleared by Kotlin whilst the dispatcher
+        // may be calling it.
+        std::mutex m_ListenerMutex;
         JavaVM *m_pJvm = nullptr;
         jobject m_jBeaconListener = nullptr;
         jmethodID m_jMethodId_onAllBeaconsCleared = nullptr;
+        jmethodID m_jMethodId_onAudioFinished = nullptr;
+
+        void DispatchEofs();
+
+        // Delete beacon, which has finished. Called with m_BeaconsMutex held.
+        void Reap(PositionedAudio *beacon);
 
-        // Helper to notify Kotlin
+        // Start the item at the front of the queue if nothing queued is playing and it's ready.
+        // Called with m_BeaconsMutex held.
+        void StartNextQueued();
+
+        // Call onAllBeaconsCleared, or onAudioFinished with handle, on the Kotlin listener
+        enum ListenerMethod {
+            ALL_BEACONS_CLEARED,
+            AUDIO_FINISHED
+        };
+
+        // Returns false if there's no listener to call
+        bool CallListener(ListenerMethod method, uint64_t handle = 0);
+
+        // Warm the asset cache at the mixer's rate, ahead of the asset's first use
+        void PrefetchAsset(const std::string &path, bool urgent);
+
+        // Helpers to notify Kotlin
         void NotifyAllBeaconsCleared(int line);
+
+        void NotifyAudioFinished(uint64_t handle);
     };
 
 } // soundscape
@@ -1,169 +1,420 @@
 #include "AudioMixer.h"
+#include "MixKernels.h"
 #include "Trace.h"
 #include <cstring>
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <chrono>
+#include <thread>
 
 namespace soundscape {
 
-    AudioMixer::AudioMixer() {
+    AudioMixer::AudioMixer(std::unique_ptr<AudioOutput> output) : m_Output(std::move(output)) {
         m_MonoBuf.resize(FRAME_SIZE);
-        m_StereoBuf.resize(FRAME_SIZE * 2);
+        m_SpatialBuf.resize(FRAME_SIZE * 2);
+        m_Bus.resize(FRAME_SIZE * 2);
+        // The audio thread can never grow this, so reserve the maximum up front
+        m_Sources.reserve(MAX_SOURCES);
+        m_PoolThread = std::thread(&AudioMixer::poolThread, this);
     }
 
     AudioMixer::~AudioMixer() {
         stop();
+        {
+            std::lock_guard<std::mutex> guard(m_ControlMutex);
+            m_PoolThreadQuit = true;
+        }
+        m_PoolCondition.notify_one();
+        m_PoolThread.join();
     }
 
-    bool AudioMixer::openStream() {
-        oboe::AudioStreamBuilder builder;
-        builder.setDirection(oboe::Direction::Output)
-                ->setPerformanceMode(oboe::PerformanceMode::None)
-                ->setSharingMode(oboe::SharingMode::Shared)
-                ->setFormat(oboe::AudioFormat::Float)
-                ->setChannelCount(oboe::ChannelCount::Stereo)
-                ->setSampleRate(48000)
-                ->setFramesPerDataCallback(FRAME_SIZE)
-                ->setUsage(oboe::Usage::Media)
-                ->setContentType(oboe::ContentType::Music)
-                ->setDataCallback(this)
-                ->setErrorCallback(this);
-
-        auto result = builder.openStream(m_Stream);
-        if (result != oboe::Result::OK) {
-            TRACE("AudioMixer: failed to open stream: %s", oboe::convertToText(result));
-            return false;
+    void AudioMixer::poolThread() {
+        std::unique_lock<std::mutex> lock(m_ControlMutex);
+        while (!m_PoolThreadQuit) {
+            if (m_Spatializer && m_Spatializer->poolNeedsGrowth()) {
+                // One at a time, so that other control calls can get in between
+                if (!m_Spatializer->growPool())
+                    m_PoolCondition.wait(lock);
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            } else if (m_RetiringSources > 0) {
+                // The audio thread hands removed sources back at its next callback
+                m_PoolCondition.wait_for(lock, std::chrono::milliseconds(RETIRE_POLL_MS));
+                releaseRetired();
+            } else {
+                m_PoolCondition.wait(lock);
+            }
         }
+    }
+
+    Spatializer::PoolStats AudioMixer::getEffectPoolStats() {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        return m_Spatializer ? m_Spatializer->getPoolStats() : Spatializer::PoolStats{};
+    }
+
+    bool AudioMixer::openOutput() {
+        if (!m_Output || !m_Output->open(this))
+            return false;
 
-        m_SampleRate = m_Stream->getSampleRate();
-        TRACE("AudioMixer: stream opened (rate=%d, framesPerCallback=%d, bufferCapacity=%d)",
-              m_SampleRate, m_Stream->getFramesPerCallback(),
-              m_Stream->getBufferCapacityInFrames());
+        m_SampleRate = m_Output->getSampleRate();
+        int requested = m_RequestedBlockSize.load();
+        if (!initSpatializer(requested > 0 ? requested : m_Output->getFramesPerBlock())) {
+            m_Output->close();
+            return false;
+        }
+        return true;
+    }
 
-        m_Spatializer = std::make_unique<SteamAudioSpatializer>(m_SampleRate, FRAME_SIZE);
-        if (!m_Spatializer->isInitialized()) {
+    bool AudioMixer::initSpatializer(int framesPerBlock) {
+        m_FramesPerBlock = framesPerBlock;
+        SpatializerType type = m_SpatializerType.load();
+        m_Spatializer = createSpatializer(type, m_SampleRate, framesPerBlock);
+        if ((!m_Spatializer || !m_Spatializer->isInitialized()) &&
+            type != SpatializerType::STEAM_AUDIO) {
+            TRACE("AudioMixer: spatializer %d unavailable, falling back to Steam Audio",
+                  static_cast<int>(type));
+            m_Spatializer = createSpatializer(SpatializerType::STEAM_AUDIO, m_SampleRate,
+                                              framesPerBlock);
+        }
+        if (!m_Spatializer || !m_Spatializer->isInitialized()) {
             TRACE("AudioMixer: spatializer init failed");
-            m_Stream->close();
-            m_Stream.reset();
+            m_Spatializer.reset();
             return false;
         }
+        TRACE("AudioMixer: using %s spatializer", m_Spatializer->getName());
 
-        m_MonoBuf.resize(m_Stream->getBufferCapacityInFrames());
-        m_StereoBuf.resize(m_Stream->getBufferCapacityInFrames() * 2);
+        // Effects for every existing source, when restarting, plus the usual headroom
+        m_Spatializer->reservePool(static_cast<int>(m_Sources.size()) + EFFECT_POOL_SIZE);
 
+        m_MonoBuf.resize(framesPerBlock);
+        m_SpatialBuf.resize(framesPerBlock * 2);
+        m_Bus.resize(framesPerBlock * 2);
+        m_FifoBuf.resize(framesPerBlock * 2);
+        m_FifoRead = 0;
+        m_FifoFrames = 0;
         return true;
     }
 
-    bool AudioMixer::startStream() {
-        // Start the stream
-        auto result = m_Stream->requestStart();
-        if (result != oboe::Result::OK) {
-            TRACE("AudioMixer: failed to start stream: %s", oboe::convertToText(result));
-            m_Stream->close();
-            m_Stream.reset();
+    bool AudioMixer::startOutput() {
+        m_StreamRunning.store(true);
+        if (!m_Output->start()) {
+            m_StreamRunning.store(false);
+            m_Output->close();
             return false;
         }
         return true;
     }
 
     bool AudioMixer::start() {
-        if (!openStream())
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        if (!openOutput())
             return false;
 
-        return startStream();
+        return startOutput();
+    }
+
+    bool AudioMixer::startOffline(int sampleRate, int framesPerBlock) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_SampleRate = sampleRate;
+        TRACE("AudioMixer: offline (rate=%d, framesPerBlock=%d)", sampleRate, framesPerBlock);
+
+        // With no stream running, commands are applied by whichever thread calls render(), or by
+        // the posting thread itself if it has to wait for one.
+        return initSpatializer(framesPerBlock);
     }
 
     void AudioMixer::stop() {
-        if (m_Stream) {
-            m_Stream->requestStop();
-            m_Stream->close();
-            m_Stream.reset();
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_StreamRunning.store(false);
+        if (m_Output)
+            m_Output->close();
+
+        // The stream is closed, so take over the audio-owned state and clean up effects
+        while (!tryAcquireMixState()) {
+            std::this_thread::yield();
         }
-
-        // Clean up spatializer effects
-        {
-            std::lock_guard<std::mutex> guard(m_SourcesMutex);
-            for (auto &ms: m_Sources) {
-                if (ms.effectId >= 0 && m_Spatializer) {
-                    m_Spatializer->removeSourceEffect(ms.effectId);
-                }
+        applyPendingCommands();
+        releaseRetired();
+        for (auto &ms: m_Sources) {
+            if (ms.effect.isValid() && m_Spatializer) {
+                m_Spatializer->removeSourceEffect(ms.effect);
             }
-            m_Sources.clear();
         }
+        m_Sources.clear();
+        m_RegisteredSources.clear();
+        releaseMixState();
 
         m_Spatializer.reset();
         TRACE("AudioMixer: stopped");
     }
 
-    void AudioMixer::addSource(AudioSourceBase *source) {
-        source->setDeviceSampleRate(m_SampleRate);
-
-        MixerSource ms;
-        ms.source = source;
+    uint64_t AudioMixer::postCommand(MixerCommand command) {
+        releaseRetired();
 
-        if (source->needsSpatialize && m_Spatializer) {
-            ms.effectId = m_Spatializer->createSourceEffect();
+        command.sequence = m_NextSequence++;
+        while (!m_Commands.push(command)) {
+            // Queue full: the audio thread isn't draining it, wait for it or take over. A full
+            // queue holds the COMMAND_QUEUE_SIZE commands before this one, so the oldest of them
+            // has a sequence number of at least 1.
+            waitForCommand(command.sequence - COMMAND_QUEUE_SIZE);
         }
-        {
-            std::lock_guard<std::mutex> guard(m_SourcesMutex);
-            m_Sources.push_back(ms);
+        return command.sequence;
+    }
+
+    void AudioMixer::waitForCommand(uint64_t sequence) {
+        // A running stream applies the command at its next callback, so sleep until it has,
+        // backing off, rather than take the mix state from under it. Only when the stream isn't
+        // running is the command applied from this thread.
+        auto sleep = std::chrono::microseconds(500);
+        while (m_AppliedSequence.load(std::memory_order_acquire) < sequence) {
+            if (!m_StreamRunning.load() && tryAcquireMixState()) {
+                applyPendingCommands();
+                releaseMixState();
+                continue;
+            }
+            std::this_thread::sleep_for(sleep);
+            sleep = std::min(sleep * 2, std::chrono::microseconds(20000));
         }
     }
 
-    void AudioMixer::removeSource(AudioSourceBase *source) {
-        int effectId = -1;
-        {
-            std::lock_guard<std::mutex> guard(m_SourcesMutex);
+    void AudioMixer::applyPendingCommands() {
+        MixerCommand command;
+        while (m_Commands.pop(command)) {
+            switch (command.type) {
+                case MixerCommand::ADD_SOURCE:
+                    // Capacity is checked by addSource, so this never allocates
+                    m_Sources.push_back(command.source);
+                    break;
 
-            for (auto it = m_Sources.begin(); it != m_Sources.end(); ++it) {
-                if (it->source == source) {
-                    if (it->effectId >= 0 && m_Spatializer)
-                        effectId = it->effectId;
-                    m_Sources.erase(it);
+                case MixerCommand::REMOVE_SOURCE: {
+                    auto it = std::find_if(m_Sources.begin(), m_Sources.end(),
+                                           [&command](const MixerSource &ms) {
+                                               return ms.source == command.source.source;
+                                           });
+                    if (it != m_Sources.end()) {
+                        if (it->effect.isValid())
+                            m_RetiredEffects.push(it->effect);
+                        m_Sources.erase(it);
+                    }
+                    m_RetiredSources.push(command.source.source);
                     break;
                 }
+
+                case MixerCommand::SET_BEACON_VOLUME:
+                    m_BeaconVolume = command.value;
+                    break;
+
+                case MixerCommand::SET_SPEECH_VOLUME:
+                    m_SpeechVolume = command.value;
+                    break;
+
+                case MixerCommand::SET_USE_HRTF:
+                    m_UseHrtf = (command.value != 0.0f);
+                    break;
+
+                case MixerCommand::SET_AMBISONICS_ORDER:
+                    m_AmbisonicsOrder = static_cast<int>(command.value);
+                    break;
             }
+            m_AppliedSequence.store(command.sequence, std::memory_order_release);
+        }
+    }
+
+    void AudioMixer::releaseRetired() {
+        Spatializer::EffectHandle effect;
+        while (m_RetiredEffects.pop(effect)) {
+            if (m_Spatializer)
+                m_Spatializer->removeSourceEffect(effect);
+        }
+        AudioSourceBase *source;
+        while (m_RetiredSources.pop(source)) {
+            delete source;
+            --m_RetiringSources;
+        }
+    }
+
+    void AudioMixer::addSource(AudioSourceBase *source) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        if (m_RegisteredSources.count(source))
+            return;
+        if (static_cast<int>(m_RegisteredSources.size()) >= MAX_SOURCES) {
+            TRACE("AudioMixer: too many sources, ignoring %p", source);
+            return;
+        }
+
+        source->setDeviceSampleRate(m_SampleRate);
+
+        MixerCommand command;
+        command.type = MixerCommand::ADD_SOURCE;
+        command.source.source = source;
+
+        if (source->needsSpatialize && m_Spatializer) {
+            command.source.effect = m_Spatializer->createSourceEffect();
+            if (m_Spatializer->poolNeedsGrowth())
+                m_PoolCondition.notify_one();
         }
-        if (effectId != -1)
-            m_Spatializer->removeSourceEffect(effectId);
+        m_RegisteredSources.insert(source);
+        postCommand(command);
+    }
+
+    void AudioMixer::removeSource(std::unique_ptr<AudioSourceBase> source) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+
+        // Queued audio which never played, and sources turned away above, were never added and
+        // can go straight away
+        if (m_RegisteredSources.erase(source.get()) == 0)
+            return;
+
+        // The audio thread hands the source back once it has dropped it from the mix
+        MixerCommand command;
+        command.type = MixerCommand::REMOVE_SOURCE;
+        command.source.source = source.release();
+        postCommand(command);
+        ++m_RetiringSources;
+
+        // With no stream running there's no callback to do that, so do it here. Otherwise the
+        // pool thread deletes it after the next callback.
+        if (!m_StreamRunning.load() && tryAcquireMixState()) {
+            applyPendingCommands();
+            releaseMixState();
+        }
+        releaseRetired();
+        if (m_RetiringSources > 0)
+            m_PoolCondition.notify_one();
+    }
+
+    void AudioMixer::setBeaconVolume(float vol) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        if (vol == m_PostedBeaconVolume)
+            return;
+        m_PostedBeaconVolume = vol;
+
+        MixerCommand command;
+        command.type = MixerCommand::SET_BEACON_VOLUME;
+        command.value = vol;
+        postCommand(command);
+    }
+
+    void AudioMixer::setSpeechVolume(float vol) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        if (vol == m_PostedSpeechVolume)
+            return;
+        m_PostedSpeechVolume = vol;
+
+        MixerCommand command;
+        command.type = MixerCommand::SET_SPEECH_VOLUME;
+        command.value = vol;
+        postCommand(command);
+    }
+
+    void AudioMixer::setUseHrtf(bool use) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        if (use == m_PostedUseHrtf)
+            return;
+        m_PostedUseHrtf = use;
+
+        MixerCommand command;
+        command.type = MixerCommand::SET_USE_HRTF;
+        command.value = use ? 1.0f : 0.0f;
+        postCommand(command);
+    }
+
+    void AudioMixer::setAmbisonicsOrder(int order) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        order = std::clamp(order, 0, Spatializer::MAX_AMBISONICS_ORDER);
+        if (order == m_PostedAmbisonicsOrder)
+            return;
+        m_PostedAmbisonicsOrder = order;
+        TRACE("AudioMixer: ambisonics order %d", order);
+
+        MixerCommand command;
+        command.type = MixerCommand::SET_AMBISONICS_ORDER;
+        command.value = static_cast<float>(order);
+        postCommand(command);
+    }
+
+    void AudioMixer::setListenerPose(const ListenerPose &pose) {
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        m_PostedPoses.previous = m_PostedPoses.current;
+        m_PostedPoses.current = pose;
+        m_ListenerPoses.store(m_PostedPoses);
+    }
+
+    void AudioMixer::setProcessingBlockSize(int frames) {
+        if (frames > 0)
+            frames = std::clamp(frames, MIN_BLOCK_SIZE, MAX_BLOCK_SIZE);
+        if (m_RequestedBlockSize.exchange(frames) == frames)
+            return;
+        TRACE("AudioMixer: processing block size %d", frames);
+
+        // Effects are created for a fixed frame size, so the spatializer has to be rebuilt
+        if (m_StreamRunning.load())
+            restart();
+    }
+
+    void AudioMixer::setSpatializerType(SpatializerType type) {
+        if (m_SpatializerType.exchange(type) == type)
+            return;
+        TRACE("AudioMixer: spatializer type %d", static_cast<int>(type));
+
+        if (m_StreamRunning.load())
+            restart();
+    }
+
+    bool AudioMixer::reopenOutput() {
+        return restart();
     }
 
     bool AudioMixer::restart() {
-        TRACE("AudioMixer: restarting after disconnect");
-        // Stream is already closed by Oboe before onErrorAfterClose fires; just drop the handle.
-        m_Stream.reset();
+        TRACE("AudioMixer: restarting output");
+        std::lock_guard<std::mutex> guard(m_ControlMutex);
+        if (!m_Output)
+            return false;
+        m_StreamRunning.store(false);
+
+        // After a disconnect the output has already closed itself and this just releases it
+        m_Output->close();
+
+        // With the stream closed we own the audio-side state. Bring it up to date and release
+        // effects belonging to the old spatializer before openOutput replaces it.
+        while (!tryAcquireMixState()) {
+            std::this_thread::yield();
+        }
+        applyPendingCommands();
+        releaseRetired();
 
         int prevRate = m_SampleRate;
-        if (!openStream())
+        if (!openOutput()) {
+            releaseMixState();
             return false;
+        }
 
         // Re-register all existing sources with the new spatializer.
         bool rateChanged = (m_SampleRate != prevRate);
         if (rateChanged)
             TRACE("AudioMixer: sample rate changed %d -> %d on restart", prevRate, m_SampleRate);
-        {
-            std::lock_guard<std::mutex> guard(m_SourcesMutex);
-            for (auto &ms: m_Sources) {
-                if (rateChanged)
-                    ms.source->setDeviceSampleRate(m_SampleRate);
-                ms.effectId = ms.source->needsSpatialize
-                              ? m_Spatializer->createSourceEffect()
-                              : -1;
-            }
+        for (auto &ms: m_Sources) {
+            if (rateChanged)
+                ms.source->setDeviceSampleRate(m_SampleRate);
+            ms.effect = ms.source->needsSpatialize
+                        ? m_Spatializer->createSourceEffect()
+                        : Spatializer::EffectHandle{};
         }
+        releaseMixState();
 
         // Allow the audio sink (e.g. Bluetooth A2DP) to stabilise before
         // mixing real audio. ~400 ms of silence at the device sample rate.
         m_WarmupFrames.store(m_SampleRate * 4 / 10);
 
         // Start the stream
-        return startStream();
+        return startOutput();
     }
 
-    void AudioMixer::onErrorAfterClose(oboe::AudioStream * /*stream*/, oboe::Result result) {
-        TRACE("AudioMixer: onErrorAfterClose: %s", oboe::convertToText(result));
-        if (result == oboe::Result::ErrorDisconnected) {
+    void AudioMixer::onOutputClosed(bool disconnected) {
+        m_StreamRunning.store(false);
+        if (disconnected) {
             if (m_SuppressRestart.load()) {
                 TRACE("AudioMixer: restart suppressed (SCO active), deferring");
                 m_RestartPending.store(true);
@@ -182,25 +433,74 @@ namespace soundscape {
         }
     }
 
-    oboe::DataCallbackResult AudioMixer::onAudioReady(
-            oboe::AudioStream *stream, void *audioData, int32_t numFrames) {
+    void AudioMixer::render(float *output, int numFrames, int64_t presentationTimeNs) {
+        m_Profiler.beginCallback(numFrames, m_SampleRate);
+
+        // The spatializer always runs on whole blocks of m_FramesPerBlock. Whole blocks are
+        // rendered straight into the output, and a block which straddles the end of the callback
+        // is rendered into the FIFO and handed out over this callback and the next.
+        int64_t startNs = presentationTimeNs - static_cast<int64_t>(numFrames) * 500000000LL /
+                                               m_SampleRate;
+        int done = 0;
+        while (done < numFrames) {
+            if (m_FifoFrames == 0) {
+                int64_t blockNs = startNs + (2 * static_cast<int64_t>(done) + m_FramesPerBlock) *
+                                            500000000LL / m_SampleRate;
+                if (numFrames - done >= m_FramesPerBlock) {
+                    renderBlock(output + done * 2, m_FramesPerBlock, blockNs);
+                    done += m_FramesPerBlock;
+                    continue;
+                }
+                renderBlock(m_FifoBuf.data(), m_FramesPerBlock, blockNs);
+                m_FifoRead = 0;
+                m_FifoFrames = m_FramesPerBlock;
+            }
 
-        auto *output = static_cast<float *>(audioData);
+            int frames = std::min(numFrames - done, m_FifoFrames);
+            memcpy(output + done * 2, m_FifoBuf.data() + m_FifoRead * 2,
+                   frames * 2 * sizeof(float));
+            m_FifoRead += frames;
+            m_FifoFrames -= frames;
+            done += frames;
+        }
+        m_Profiler.endCallback();
+    }
 
-        // Clear output
-        memset(output, 0, numFrames * 2 * sizeof(float));
+    void AudioMixer::renderBlock(float *output, int numFrames, int64_t presentationTimeNs) {
+        // A non-real-time thread only holds the mix state whilst the stream isn't delivering
+        // callbacks, so failing to get it here is rare. Don't wait, just output silence.
+        if (!tryAcquireMixState()) {
+            m_CallbackContention.fetch_add(1, std::memory_order_relaxed);
+            memset(output, 0, numFrames * 2 * sizeof(float));
+            return;
+        }
+
+        // Apply all changes made since the last callback at this block boundary
+        applyPendingCommands();
 
         // After a restart, output silence to let the audio sink stabilise.
         int warmup = m_WarmupFrames.load();
         if (warmup > 0) {
             m_WarmupFrames.store(std::max(0, warmup - numFrames));
-            return oboe::DataCallbackResult::Continue;
+            releaseMixState();
+            memset(output, 0, numFrames * 2 * sizeof(float));
+            return;
         }
 
-        std::lock_guard<std::mutex> guard(m_SourcesMutex);
+        // Everything is mixed into the planar bus, which is interleaved into output at the end
+        float *busLeft = m_Bus.data();
+        float *busRight = m_Bus.data() + m_FramesPerBlock;
+        memset(busLeft, 0, numFrames * sizeof(float));
+        memset(busRight, 0, numFrames * sizeof(float));
+
+        // Listener heading at the time this block will be heard
+        ListenerPoseHistory poses = m_ListenerPoses.load();
+        double listenerHeading = m_HeadingPredictor.predict(
+                poses, presentationTimeNs,
+                static_cast<double>(numFrames) / m_SampleRate);
 
-        float beaconVol = m_BeaconVolume.load();
-        float speechVol = m_SpeechVolume.load();
+        float beaconVol = m_BeaconVolume;
+        float speechVol = m_SpeechVolume;
 
         // Determine which source types are actively producing audio.
         bool hasSpeech = false;
@@ -224,6 +524,22 @@ namespace soundscape {
             // close to full scale.
         }
         // Otherwise (proximity silent, no speech): main beacon at full volume.
+
+        bool useAmbisonics = m_UseHrtf && m_AmbisonicsOrder > 0 && m_Spatializer;
+        if (useAmbisonics)
+            m_Spatializer->beginAmbisonicsBlock(m_AmbisonicsOrder);
+
+        int voices = 0;
+        int spatializedVoices = 0;
+
+        // Time each stage as it completes
+        int64_t lapNs = CallbackProfiler::nowNs();
+        auto lap = [&](CallbackProfiler::Stage stage) {
+            int64_t now = CallbackProfiler::nowNs();
+            m_Profiler.addStage(stage, now - lapNs);
+            lapNs = now;
+        };
+
         for (auto &ms: m_Sources) {
             auto *src = ms.source;
 
@@ -232,10 +548,16 @@ namespace soundscape {
             }
 
             // Read mono audio from source
+            int64_t sourceStartNs = lapNs;
             int framesRead = src->readPcm(m_MonoBuf.data(), numFrames);
+            lap(CallbackProfiler::READ);
             if (framesRead <= 0) {
+                m_Profiler.addCategory(static_cast<int>(src->category), lapNs - sourceStartNs);
                 continue;
             }
+            voices++;
+            if (src->needsSpatialize)
+                spatializedVoices++;
 
             // Pad with silence if needed
             if (framesRead < numFrames) {
@@ -245,14 +567,22 @@ namespace soundscape {
 
             // Get volume for this source's category
             float vol = (src->category == AudioCategory::BEACON) ? beaconVol : speechVol;
-            if (src->needsSpatialize && ms.effectId >= 0 && m_Spatializer && m_UseHrtf.load()) {
+
+            // Direction from the predicted listener pose, falling back to the azimuth last set by
+            // the game thread
+            float az = src->azimuth.load();
+            if (src->needsSpatialize && !std::isnan(listenerHeading)) {
+                float predicted = azimuthForSource(*src, listenerHeading,
+                                                   poses.current.latitude,
+                                                   poses.current.longitude);
+                if (!std::isnan(predicted))
+                    az = predicted;
+            }
+
+            if (src->needsSpatialize && ms.effect.isValid() && m_Spatializer && m_UseHrtf) {
                 // Spatialize: mono -> stereo HRTF
-                float az = src->azimuth.load();
                 float el = src->elevation.load();
 
-                m_Spatializer->spatialize(ms.effectId, m_MonoBuf.data(),
-                                          m_StereoBuf.data(), numFrames, az, el);
-
                 // Reduce volume for rear-facing sounds
                 float cosAz = cosf(az);
                 if (cosAz < 0.0) {
@@ -260,15 +590,27 @@ namespace soundscape {
                     vol *= rearFactor;
                 }
 
-                // Mix into output with volume
-                for (int i = 0; i < numFrames * 2; i++) {
-                    output[i] += m_StereoBuf[i] * vol;
+                if (useAmbisonics) {
+                    // Encode into the shared bus; decoded once after the loop
+                    m_Spatializer->encodeToAmbisonics(ms.effect, m_MonoBuf.data(),
+                                                      numFrames, az, el, vol);
+                    lap(CallbackProfiler::SPATIALIZE);
+                } else {
+                    float *left = m_SpatialBuf.data();
+                    float *right = m_SpatialBuf.data() + m_FramesPerBlock;
+                    m_Spatializer->spatialize(ms.effect, m_MonoBuf.data(), left, right,
+                                              numFrames, az, el);
+                    lap(CallbackProfiler::SPATIALIZE);
+
+                    // Mix into the bus with volume
+                    kernels::accumulateWithGain(busLeft, left, vol, numFrames);
+                    kernels::accumulateWithGain(busRight, right, vol, numFrames);
+                    lap(CallbackProfiler::MIX);
                 }
-            } else if (src->needsSpatialize && !m_UseHrtf.load()) {
+            } else if (src->needsSpatialize && !m_UseHrtf) {
 
                 // Stereo pan over full 360°: sin(az) gives a smooth, periodic response with
                 // no jumps. 0=center, +π/2=right, π=center(behind), -π/2=left.
-                float az = src->azimuth.load();
                 float pan = sinf(az);
                 float panAngle = (pan + 1.0f) * (float) M_PI_4;
 
@@ -282,26 +624,28 @@ namespace soundscape {
                 float attVol = vol * rearFactor;
                 float leftGain = cosf(panAngle) * attVol;
                 float rightGain = sinf(panAngle) * attVol;
-                for (int i = 0; i < numFrames; i++) {
-                    output[i * 2] += m_MonoBuf[i] * leftGain;
-                    output[i * 2 + 1] += m_MonoBuf[i] * rightGain;
-                }
+                kernels::accumulateMonoPlanar(busLeft, busRight, m_MonoBuf.data(), leftGain,
+                                              rightGain, numFrames);
+                lap(CallbackProfiler::PAN);
             } else {
                 // Non-spatialized: duplicate mono to stereo
-                for (int i = 0; i < numFrames; i++) {
-                    float s = m_MonoBuf[i] * vol;
-                    output[i * 2] += s;
-                    output[i * 2 + 1] += s;
-                }
+                kernels::accumulateMonoPlanar(busLeft, busRight, m_MonoBuf.data(), vol, vol,
+                                              numFrames);
+                lap(CallbackProfiler::MIX);
             }
+            m_Profiler.addCategory(static_cast<int>(src->category), lapNs - sourceStartNs);
         }
-
-        // Clamp output to [-1, 1]
-        for (int i = 0; i < numFrames * 2; i++) {
-            output[i] = std::clamp(output[i], -1.0f, 1.0f);
+        m_Profiler.setVoices(voices, spatializedVoices);
+        if (useAmbisonics) {
+            m_Spatializer->decodeAmbisonics(busLeft, busRight, numFrames);
+            lap(CallbackProfiler::SPATIALIZE);
         }
 
-        return oboe::DataCallbackResult::Continue;
+        // The only pass over the interleaved output, clamping to [-1, 1] on the way. The bus is
+        // mix state, so it's only released once this has read it.
+        kernels::interleaveClamped(output, busLeft, busRight, numFrames);
+        lap(CallbackProfiler::CLAMP);
+        releaseMixState();
     }
 
 } // soundscape
@@ -1,83 +1,236 @@
 #pragma once
 
-#include <oboe/Oboe.h>
+#include <memory>
 #include <vector>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
+#include "AudioOutput.h"
 #include "AudioSourceBase.h"
-#include "SteamAudioSpatializer.h"
+#include "CallbackProfiler.h"
+#include "ListenerPose.h"
+#include "SeqLock.h"
+#include "SpscQueue.h"
+#include "Spatializer.h"
 
 namespace soundscape {
 
-    class AudioMixer : public oboe::AudioStreamDataCallback,
-                       public oboe::AudioStreamErrorCallback {
+    class AudioMixer : public AudioOutput::Callback {
     public:
-        AudioMixer();
+        // Callback size requested from the output in its normal (not low latency) mode
+        static constexpr int FRAME_SIZE = 1024;
+
+        // output can be nullptr if the mixer is only ever going to be run offline
+        explicit AudioMixer(std::unique_ptr<AudioOutput> output = nullptr);
 
-        ~AudioMixer();
+        ~AudioMixer() override;
 
         bool start();
 
+        // Prepare to be driven by render() rather than the output, e.g. by OfflineRenderer.
+        // framesPerBlock is the block size the spatializer runs at, which render() calls needn't
+        // match.
+        bool startOffline(int sampleRate, int framesPerBlock);
+
         void stop();
 
+        // Close and reopen the output, e.g. after changing its mode, keeping all sources
+        bool reopenOutput();
+
+        // Mix one block of interleaved stereo into output. presentationTimeNs is the monotonic
+        // time at which the middle of the block will be heard. Called on the output's audio
+        // thread, or in a loop when running offline; must only ever be called from one thread at
+        // a time.
+        void render(float *output, int numFrames, int64_t presentationTimeNs) override;
+
         int getSampleRate() const { return m_SampleRate; }
 
-        // Source management (called from game thread)
+        // Source management (called from game thread). removeSource doesn't wait for the audio
+        // thread: it takes the source and deletes it once the audio thread has dropped it from the
+        // mix, which may be a callback after this returns.
         void addSource(AudioSourceBase *source);
 
-        void removeSource(AudioSourceBase *source);
+        void removeSource(std::unique_ptr<AudioSourceBase> source);
 
         // Volume control (called from game thread)
-        void setBeaconVolume(float vol) { m_BeaconVolume.store(vol); }
+        void setBeaconVolume(float vol);
 
-        void setSpeechVolume(float vol) { m_SpeechVolume.store(vol); }
+        void setSpeechVolume(float vol);
 
         // Spatialization mode (called from game thread)
-        void setUseHrtf(bool use) { m_UseHrtf.store(use); }
+        void setUseHrtf(bool use);
+
+        // HRTF render mode (called from game thread). 0 gives every source its own binaural
+        // effect; 1 or 2 encodes all sources into a shared ambisonics bus of that order which is
+        // decoded binaurally once per callback, so HRTF cost no longer grows with voice count.
+        void setAmbisonicsOrder(int order);
+
+        // Latest listener pose (called from game thread). The audio thread extrapolates the
+        // heading to each block's presentation time and derives source azimuths from it.
+        void setListenerPose(const ListenerPose &pose);
+
+        // Block size the spatializer runs at (called from game thread). Output callbacks of any
+        // size are fed from a FIFO of processed blocks, so small blocks give lower latency and
+        // large ones lower CPU. 0 follows the output's own block size. Reopens a running output.
+        void setProcessingBlockSize(int frames);
+
+        // HRTF renderer (called from game thread). Reopens a running output. If the renderer
+        // can't be created for the output's format, Steam Audio is used instead.
+        void setSpatializerType(SpatializerType type);
 
         // Suppress restart during SCO transitions
         void setSuppressRestart(bool suppress);
 
-        SteamAudioSpatializer *getSpatializer() { return m_Spatializer.get(); }
+        Spatializer *getSpatializer() { return m_Spatializer.get(); }
+
+        // Number of callbacks which found the mix state held by a non-real-time thread (only
+        // possible whilst the stream is stalled or being torn down). The callback never waits in
+        // that case, it outputs silence instead.
+        uint64_t getCallbackContention() const { return m_CallbackContention.load(); }
 
-        // Oboe callbacks
-        oboe::DataCallbackResult onAudioReady(
-                oboe::AudioStream *stream, void *audioData, int32_t numFrames) override;
+        // Callback timing over the last few seconds (any thread)
+        CallbackProfiler::Report getProfile() const { return m_Profiler.report(); }
 
-        void onErrorAfterClose(oboe::AudioStream *stream, oboe::Result result) override;
+        // Binaural effect pool use since the spatializer was last created (any thread)
+        Spatializer::PoolStats getEffectPoolStats();
+
+        void onOutputClosed(bool disconnected) override;
 
     private:
-        bool openStream();      // open, init spatializer and get ready to playback
-        bool startStream();     // start the stream
+        bool openOutput();      // open, init spatializer and get ready to playback
+        bool initSpatializer(int framesPerBlock);
+
+        // Mix one block of m_FramesPerBlock frames
+        void renderBlock(float *output, int numFrames, int64_t presentationTimeNs);
+        bool startOutput();     // start playback
         bool restart();
 
-        static constexpr int FRAME_SIZE = 1024;
+        static constexpr int MAX_SOURCES = 64;
+        // Effects created up front: a few beacons plus overlapping callouts
+        static constexpr int EFFECT_POOL_SIZE = 8;
+        static constexpr int MIN_BLOCK_SIZE = 32;
+        static constexpr int MAX_BLOCK_SIZE = 4096;
+        static constexpr size_t COMMAND_QUEUE_SIZE = 256;
+        // How often the pool thread looks for removed sources to delete
+        static constexpr int RETIRE_POLL_MS = 20;
 
         int m_SampleRate = 48000;
-        std::shared_ptr<oboe::AudioStream> m_Stream;
+        int m_FramesPerBlock = FRAME_SIZE;
+        std::atomic<int> m_RequestedBlockSize{0};
+        std::atomic<SpatializerType> m_SpatializerType{SpatializerType::STEAM_AUDIO};
+        std::unique_ptr<AudioOutput> m_Output;
 
-        std::unique_ptr<SteamAudioSpatializer> m_Spatializer;
+        std::unique_ptr<Spatializer> m_Spatializer;
 
         struct MixerSource {
             AudioSourceBase *source;
-            int effectId = -1;  // Steam Audio binaural effect ID
+            Spatializer::EffectHandle effect;
+        };
+
+        // Every change to the mix is posted from the game thread as a command and applied by the
+        // audio thread at the top of the next callback, so that all of the state below marked as
+        // audio-owned is only ever touched by one thread at a time.
+        struct MixerCommand {
+            enum Type {
+                ADD_SOURCE,
+                REMOVE_SOURCE,
+                SET_BEACON_VOLUME,
+                SET_SPEECH_VOLUME,
+                SET_USE_HRTF,
+                SET_AMBISONICS_ORDER
+            };
+            Type type = ADD_SOURCE;
+            uint64_t sequence = 0;
+            MixerSource source{};
+            float value = 0.0f;
         };
 
-        std::mutex m_SourcesMutex;
+        // Must be called with m_ControlMutex held. Returns the command's sequence number.
+        uint64_t postCommand(MixerCommand command);
+
+        // Only for when the command queue is full
+        void waitForCommand(uint64_t sequence);
+
+        // Must be called whilst holding m_MixStateBusy
+        void applyPendingCommands();
+
+        bool tryAcquireMixState() { return !m_MixStateBusy.exchange(true, std::memory_order_acquire); }
+        void releaseMixState() { m_MixStateBusy.store(false, std::memory_order_release); }
+
+        // Releases effects and deletes sources the audio thread has finished with. Must be called
+        // with m_ControlMutex held.
+        void releaseRetired();
+
+        // Tops up the spatializer's effect pool whenever it runs short, so that neither the
+        // audio thread nor the thread adding a source pays for creating them. Also deletes
+        // removed sources once the audio thread lets go of them.
+        void poolThread();
+
+        // Serialises the producer side of the command queue, spatializer lifetime and effect
+        // creation/destruction. Never taken on the audio thread.
+        std::mutex m_ControlMutex;
+        SpscQueue<MixerCommand, COMMAND_QUEUE_SIZE> m_Commands;
+        uint64_t m_NextSequence = 1;
+        // Sources added and not yet removed, so that at most MAX_SOURCES are ever in m_Sources
+        std::unordered_set<AudioSourceBase *> m_RegisteredSources;
+        float m_PostedBeaconVolume = 1.0f;
+        float m_PostedSpeechVolume = 1.0f;
+        bool m_PostedUseHrtf = true;
+        int m_PostedAmbisonicsOrder = 0;
+        ListenerPoseHistory m_PostedPoses;
+
+        // Published with a seqlock rather than the command queue: only the latest value matters
+        SeqLock<ListenerPoseHistory> m_ListenerPoses;
+
+        // Effects and removed sources the audio thread has stopped using, handed back for
+        // destruction. Sized so that a full command queue applied between one emptying and the
+        // next can't fill them.
+        SpscQueue<Spatializer::EffectHandle, COMMAND_QUEUE_SIZE * 2> m_RetiredEffects;
+        SpscQueue<AudioSourceBase *, COMMAND_QUEUE_SIZE * 2> m_RetiredSources;
+        int m_RetiringSources = 0;      // removed and not yet deleted
+        std::atomic<uint64_t> m_AppliedSequence{0};
+
+        // Held by whoever is currently allowed to touch the audio-owned state. The callback only
+        // ever tries to take it; non-real-time threads take it when the stream isn't running.
+        std::atomic<bool> m_MixStateBusy{false};
+        std::atomic<bool> m_StreamRunning{false};
+        std::atomic<uint64_t> m_CallbackContention{0};
+
+        // Written by the audio thread, reported from any
+        CallbackProfiler m_Profiler;
+
+        // Audio-owned state
         std::vector<MixerSource> m_Sources;
+        float m_BeaconVolume = 1.0f;
+        float m_SpeechVolume = 1.0f;
+        bool m_UseHrtf = true;
+        int m_AmbisonicsOrder = 0;
+        HeadingPredictor m_HeadingPredictor;
+
+        // Effect pool maintenance, woken with m_ControlMutex held
+        std::condition_variable m_PoolCondition;
+        bool m_PoolThreadQuit = false;
+        std::thread m_PoolThread;
 
-        std::atomic<float> m_BeaconVolume{1.0f};
-        std::atomic<float> m_SpeechVolume{1.0f};
-        std::atomic<bool> m_UseHrtf{true};
         std::atomic<bool> m_SuppressRestart{false};
         std::atomic<bool> m_RestartPending{false};
         std::atomic<int> m_WarmupFrames{0};
 
-        // Scratch buffers (allocated once, reused per callback)
+        // Scratch buffers (allocated once, reused per callback). The stereo ones are planar: a
+        // block of left followed by a block of right.
         std::vector<float> m_MonoBuf;
-        std::vector<float> m_StereoBuf;
+        std::vector<float> m_SpatialBuf;   // one source's binaural output
+        std::vector<float> m_Bus;          // the mix
+
+        // Processed block not yet handed to the output, when callbacks don't line up with blocks.
+        // Audio-owned.
+        std::vector<float> m_FifoBuf;
+        int m_FifoRead = 0;
+        int m_FifoFrames = 0;
     };
 
 } // soundscape
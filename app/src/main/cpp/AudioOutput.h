@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+namespace soundscape {
+
+    // The device the mixer plays through: an Oboe stream on Android. Offline rendering drives the
+    // mixer directly and doesn't need one.
+    class AudioOutput {
+    public:
+        class Callback {
+        public:
+            virtual ~Callback() = default;
+
+            // Called on the audio thread to fill numFrames of interleaved stereo float.
+            // presentationTimeNs is the monotonic time at which the middle of the block will be
+            // heard.
+            virtual void render(float *output, int numFrames, int64_t presentationTimeNs) = 0;
+
+            // The output has closed itself after an error. If the device was disconnected, opening
+            // it again picks up whichever device is now current. Not called on the audio thread.
+            virtual void onOutputClosed(bool disconnected) = 0;
+        };
+
+        virtual ~AudioOutput() = default;
+
+        // Open the device; the sample rate and block size are known once this succeeds
+        virtual bool open(Callback *callback) = 0;
+
+        virtual bool start() = 0;
+
+        // Stop and close. Safe to call if the output has already closed itself.
+        virtual void close() = 0;
+
+        virtual int getSampleRate() const = 0;
+
+        // Block size render() will usually be asked for: the callback size, or the burst size
+        // for a low latency stream. Larger callbacks are rendered in blocks of this size.
+        virtual int getFramesPerBlock() const = 0;
+    };
+
+} // soundscape
@@ -9,6 +9,14 @@ namespace soundscape {
         SPEECH
     };
 
+    // How the mixer derives a source's azimuth from the listener pose on the audio thread
+    enum class AzimuthMode {
+        FIXED,      // use azimuth as set by the game thread
+        RELATIVE,   // positionHeading relative to the listener's heading
+        COMPASS,    // positionHeading is a compass bearing
+        LOCALIZED   // towards positionLatitude/positionLongitude
+    };
+
     class AudioSourceBase {
     public:
         virtual ~AudioSourceBase() = default;
@@ -25,6 +33,14 @@ namespace soundscape {
         std::atomic<float> elevation{0.0f};     // radians
         std::atomic<bool> muted{false};
 
+        // Positioning used by the mixer to track the listener's head at audio rate. Set before
+        // the source is added to the mixer and not changed afterwards. azimuth above is used
+        // whenever the mixer has no valid listener heading.
+        AzimuthMode azimuthMode = AzimuthMode::FIXED;
+        double positionHeading = 0.0;      // degrees
+        double positionLatitude = 0.0;
+        double positionLongitude = 0.0;
+
         // Whether this source needs HRTF spatialization (false for STANDARD/2D audio)
         bool needsSpatialize = true;
 
@@ -0,0 +1,139 @@
+#include "CallbackProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace soundscape {
+
+    void CallbackProfiler::beginCallback(int numFrames, int sampleRate) {
+        m_CallbackStartNs = nowNs();
+        m_CallbackFrames = numFrames;
+        m_SampleRate = sampleRate;
+        std::fill(std::begin(m_StageNs), std::end(m_StageNs), 0);
+        std::fill(std::begin(m_CategoryNs), std::end(m_CategoryNs), 0);
+        m_Voices = -1;
+        m_SpatializedVoices = 0;
+    }
+
+    void CallbackProfiler::endCallback() {
+        int64_t elapsedNs = nowNs() - m_CallbackStartNs;
+        int64_t budgetNs = static_cast<int64_t>(m_CallbackFrames) * 1000000000LL / m_SampleRate;
+
+        // Start a new window once the active bank has WINDOW_SECONDS in it, dropping the oldest
+        m_WindowFrames += m_CallbackFrames;
+        if (m_WindowFrames >= static_cast<int64_t>(m_SampleRate) * WINDOW_SECONDS) {
+            int next = 1 - m_ActiveBank.load(std::memory_order_relaxed);
+            clearBank(m_Banks[next]);
+            m_ActiveBank.store(next, std::memory_order_relaxed);
+            m_WindowFrames = 0;
+        }
+
+        record(0, elapsedNs);
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+            record(1 + stage, m_StageNs[stage]);
+        for (int category = 0; category < CATEGORY_COUNT; category++) {
+            if (m_CategoryNs[category] > 0)
+                record(1 + STAGE_COUNT + category, m_CategoryNs[category]);
+        }
+
+        // Callbacks served entirely from already processed audio leave the voice count as it was
+        if (m_Voices >= 0) {
+            auto &peak = m_Banks[m_ActiveBank.load(std::memory_order_relaxed)].peakVoices;
+            if (m_Voices > peak.load(std::memory_order_relaxed))
+                peak.store(m_Voices, std::memory_order_relaxed);
+            m_LastVoices.store(m_Voices, std::memory_order_relaxed);
+            m_LastSpatializedVoices.store(m_SpatializedVoices, std::memory_order_relaxed);
+        }
+
+        m_BudgetNs.store(budgetNs, std::memory_order_relaxed);
+        m_Callbacks.fetch_add(1, std::memory_order_relaxed);
+        if (elapsedNs > budgetNs)
+            m_DeadlineMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int CallbackProfiler::bucketFor(int64_t ns) {
+        if (ns <= 0)
+            return 0;
+        auto bucket = static_cast<int>(std::log2(static_cast<double>(ns)) * BUCKETS_PER_OCTAVE) -
+                      MIN_OCTAVE * BUCKETS_PER_OCTAVE;
+        return std::clamp(bucket, 0, BUCKETS - 1);
+    }
+
+    double CallbackProfiler::bucketUs(int bucket) {
+        // Geometric middle of the bucket
+        double octave = MIN_OCTAVE + (bucket + 0.5) / BUCKETS_PER_OCTAVE;
+        return std::exp2(octave) / 1000.0;
+    }
+
+    void CallbackProfiler::record(int histogram, int64_t ns) {
+        auto &h = m_Banks[m_ActiveBank.load(std::memory_order_relaxed)].histograms[histogram];
+        h.counts[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+        if (ns > h.maxNs.load(std::memory_order_relaxed))
+            h.maxNs.store(ns, std::memory_order_relaxed);
+    }
+
+    void CallbackProfiler::clearBank(Bank &bank) {
+        for (auto &h: bank.histograms) {
+            for (auto &count: h.counts)
+                count.store(0, std::memory_order_relaxed);
+            h.maxNs.store(0, std::memory_order_relaxed);
+        }
+        bank.peakVoices.store(0, std::memory_order_relaxed);
+    }
+
+    CallbackProfiler::Summary CallbackProfiler::summarise(int histogram) const {
+        uint64_t counts[BUCKETS];
+        uint64_t total = 0;
+        int64_t maxNs = 0;
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            counts[bucket] = 0;
+            for (const auto &bank: m_Banks)
+                counts[bucket] += bank.histograms[histogram].counts[bucket].load(
+                        std::memory_order_relaxed);
+            total += counts[bucket];
+        }
+        for (const auto &bank: m_Banks)
+            maxNs = std::max(maxNs, bank.histograms[histogram].maxNs.load(
+                    std::memory_order_relaxed));
+
+        Summary summary;
+        if (total == 0)
+            return summary;
+
+        summary.maxUs = static_cast<double>(maxNs) / 1000.0;
+        auto percentile = [&](double p) {
+            auto rank = static_cast<uint64_t>(std::ceil(p * static_cast<double>(total)));
+            uint64_t seen = 0;
+            for (int bucket = 0; bucket < BUCKETS; bucket++) {
+                seen += counts[bucket];
+                if (seen >= rank)
+                    return std::min(bucketUs(bucket), summary.maxUs);
+            }
+            return summary.maxUs;
+        };
+        summary.p50Us = percentile(0.50);
+        summary.p99Us = percentile(0.99);
+        return summary;
+    }
+
+    CallbackProfiler::Report CallbackProfiler::report() const {
+        Report report;
+        report.callback = summarise(0);
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+            report.stages[stage] = summarise(1 + stage);
+        for (int category = 0; category < CATEGORY_COUNT; category++)
+            report.categories[category] = summarise(1 + STAGE_COUNT + category);
+
+        report.budgetUs = static_cast<double>(m_BudgetNs.load(std::memory_order_relaxed)) / 1000.0;
+        report.callbacks = m_Callbacks.load(std::memory_order_relaxed);
+        report.deadlineMisses = m_DeadlineMisses.load(std::memory_order_relaxed);
+        report.voices = m_LastVoices.load(std::memory_order_relaxed);
+        report.spatializedVoices = m_LastSpatializedVoices.load(std::memory_order_relaxed);
+        for (const auto &bank: m_Banks)
+            report.peakVoices = std::max(report.peakVoices,
+                                         bank.peakVoices.load(std::memory_order_relaxed));
+        return report;
+    }
+
+} // soundscape
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace soundscape {
+
+    // Always-on timing of the mixer's audio callback. The audio thread adds up how long each
+    // stage and each source category took over a callback and files the totals in log spaced
+    // histograms, which any thread can summarise. Histograms are kept in two banks which swap
+    // every WINDOW_SECONDS of audio, so a report covers the last 5-10 seconds rather than the
+    // whole session. Recording costs a clock read per stage plus a few relaxed atomic increments
+    // per callback.
+    class CallbackProfiler {
+    public:
+        enum Stage {
+            READ,           // AudioSourceBase::readPcm
+            SPATIALIZE,     // HRTF, ambisonics encode and decode
+            PAN,            // stereo panning when HRTF is off
+            MIX,            // accumulating into the output
+            CLAMP,          // interleaving and clamping into the output
+            STAGE_COUNT
+        };
+
+        // Indexed by AudioCategory
+        static constexpr int CATEGORY_COUNT = 2;
+
+        struct Summary {
+            double p50Us = 0.0;
+            double p99Us = 0.0;
+            double maxUs = 0.0;
+        };
+
+        struct Report {
+            Summary callback;
+            Summary stages[STAGE_COUNT];
+            Summary categories[CATEGORY_COUNT];
+            double budgetUs = 0.0;          // duration of the most recent callback
+            uint64_t callbacks = 0;         // since the mixer started
+            uint64_t deadlineMisses = 0;    // callbacks which took longer than their duration
+            int voices = 0;                 // sources producing audio in the last callback
+            int spatializedVoices = 0;
+            int peakVoices = 0;             // over the report window
+        };
+
+        static int64_t nowNs() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Audio thread only
+        void beginCallback(int numFrames, int sampleRate);
+
+        void addStage(Stage stage, int64_t ns) { m_StageNs[stage] += ns; }
+
+        void addCategory(int category, int64_t ns) { m_CategoryNs[category] += ns; }
+
+        // Once per processed block. A callback reports the most voices seen in any of its blocks.
+        void setVoices(int voices, int spatializedVoices) {
+            m_Voices = std::max(m_Voices, voices);
+            m_SpatializedVoices = std::max(m_SpatializedVoices, spatializedVoices);
+        }
+
+        void endCallback();
+
+        // Any thread. Values can be torn across a bank swap, which is fine for statistics.
+        Report report() const;
+
+    private:
+        static constexpr int WINDOW_SECONDS = 5;
+
+        // Quarter octave buckets from 64 ns up to about 1 s
+        static constexpr int BUCKETS_PER_OCTAVE = 4;
+        static constexpr int MIN_OCTAVE = 6;
+        static constexpr int BUCKETS = 24 * BUCKETS_PER_OCTAVE;
+
+        // Callback total, then stages, then categories
+        static constexpr int HISTOGRAMS = 1 + STAGE_COUNT + CATEGORY_COUNT;
+
+        struct Histogram {
+            std::atomic<uint32_t> counts[BUCKETS];
+            std::atomic<int64_t> maxNs;
+        };
+
+        struct Bank {
+            Histogram histograms[HISTOGRAMS];
+            std::atomic<int> peakVoices;
+        };
+
+        static int bucketFor(int64_t ns);
+
+        static double bucketUs(int bucket);
+
+        void record(int histogram, int64_t ns);
+
+        void clearBank(Bank &bank);
+
+        Summary summarise(int histogram) const;
+
+        Bank m_Banks[2]{};
+        std::atomic<int> m_ActiveBank{0};
+        std::atomic<uint64_t> m_Callbacks{0};
+        std::atomic<uint64_t> m_DeadlineMisses{0};
+        std::atomic<int64_t> m_BudgetNs{0};
+        std::atomic<int> m_LastVoices{0};
+        std::atomic<int> m_LastSpatializedVoices{0};
+
+        // Audio thread only
+        int64_t m_CallbackStartNs = 0;
+        int m_CallbackFrames = 0;
+        int64_t m_StageNs[STAGE_COUNT] = {};
+        int64_t m_CategoryNs[CATEGORY_COUNT] = {};
+        int m_Voices = -1;      // -1 until a block is processed
+        int m_SpatializedVoices = 0;
+        int64_t m_WindowFrames = 0;
+        int m_SampleRate = 48000;
+    };
+
+} // soundscape
@@ -0,0 +1,347 @@
+#include "ConvolutionSpatializer.h"
+#include "MixKernels.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace soundscape {
+
+    ConvolutionSpatializer::ConvolutionSpatializer(int sampleRate, int frameSize)
+            : m_Hrirs(sampleRate),
+              m_FrameSize(frameSize),
+              m_PartitionSize(partitionSizeFor(frameSize, m_Hrirs.getLength())),
+              m_FftSize(2 * m_PartitionSize),
+              m_Fft(std::max(m_FftSize, 4)) {
+        if (m_PartitionSize < MIN_PARTITION_SIZE) {
+            TRACE("Convolution: frame size %d can't be partitioned", frameSize);
+            return;
+        }
+        m_Partitions = (m_Hrirs.getLength() + m_PartitionSize - 1) / m_PartitionSize;
+
+        m_Directions.resize(HrirSet::AZIMUTHS);
+        for (int direction = 0; direction < HrirSet::AZIMUTHS; direction++) {
+            buildFilter(m_Hrirs.getLeft(direction), m_Hrirs.getRight(direction),
+                        m_Directions[direction]);
+        }
+
+        m_AccRe.resize(m_FftSize);
+        m_AccIm.resize(m_FftSize);
+        m_FadeRe.resize(m_FftSize);
+        m_FadeIm.resize(m_FftSize);
+
+        m_AmbisonicsBus.resize(HORIZONTAL_CHANNELS * frameSize);
+        for (auto &convolver: m_DecodeConvolvers)
+            initConvolver(convolver);
+        buildDecodeFilters();
+
+        TRACE("Convolution: initialized (rate=%d, frameSize=%d, partition=%d x %d)",
+              sampleRate, frameSize, m_PartitionSize, m_Partitions);
+    }
+
+    ConvolutionSpatializer::~ConvolutionSpatializer() {
+        m_Effects.clear(releaseEffect);
+    }
+
+    int ConvolutionSpatializer::partitionSizeFor(int frameSize, int responseLength) {
+        if (frameSize <= 0)
+            return 0;
+        return std::min(frameSize & -frameSize, responseLength);
+    }
+
+    void ConvolutionSpatializer::initFilter(Filter &filter) const {
+        filter.re.assign(m_Partitions * m_FftSize, 0.0f);
+        filter.im.assign(m_Partitions * m_FftSize, 0.0f);
+    }
+
+    void ConvolutionSpatializer::initConvolver(Convolver &convolver) const {
+        convolver.history.assign(m_PartitionSize, 0.0f);
+        convolver.spectraRe.assign(m_Partitions * m_FftSize, 0.0f);
+        convolver.spectraIm.assign(m_Partitions * m_FftSize, 0.0f);
+        convolver.newest = 0;
+    }
+
+    void ConvolutionSpatializer::resetConvolver(Convolver &convolver) {
+        std::fill(convolver.history.begin(), convolver.history.end(), 0.0f);
+        std::fill(convolver.spectraRe.begin(), convolver.spectraRe.end(), 0.0f);
+        std::fill(convolver.spectraIm.begin(), convolver.spectraIm.end(), 0.0f);
+        convolver.newest = 0;
+    }
+
+    void ConvolutionSpatializer::buildFilter(const float *left, const float *right,
+                                             Filter &filter) {
+        initFilter(filter);
+        const int length = m_Hrirs.getLength();
+        const float scale = 1.0f / static_cast<float>(m_FftSize);
+        for (int partition = 0; partition < m_Partitions; partition++) {
+            float *re = &filter.re[partition * m_FftSize];
+            float *im = &filter.im[partition * m_FftSize];
+            // Zero padded to the transform size, for overlap-save
+            for (int i = 0; i < m_PartitionSize; i++) {
+                int tap = partition * m_PartitionSize + i;
+                if (tap < length) {
+                    re[i] = left[tap] * scale;
+                    im[i] = right[tap] * scale;
+                }
+            }
+            m_Fft.forward(re, im);
+        }
+    }
+
+    int ConvolutionSpatializer::directionFor(float azimuth) {
+        float steps = azimuth * static_cast<float>(180.0 / M_PI) / HrirSet::AZIMUTH_STEP;
+        int direction = static_cast<int>(std::lround(steps)) % HrirSet::AZIMUTHS;
+        return direction < 0 ? direction + HrirSet::AZIMUTHS : direction;
+    }
+
+    void ConvolutionSpatializer::interpolateFilter(float azimuth, Filter &filter) const {
+        float steps = azimuth * static_cast<float>(180.0 / M_PI) / HrirSet::AZIMUTH_STEP;
+        float below = std::floor(steps);
+        float t = steps - below;
+        int first = static_cast<int>(below) % HrirSet::AZIMUTHS;
+        if (first < 0)
+            first += HrirSet::AZIMUTHS;
+        int second = (first + 1) % HrirSet::AZIMUTHS;
+
+        const Filter &a = m_Directions[first];
+        const Filter &b = m_Directions[second];
+        const size_t size = a.re.size();
+        for (size_t i = 0; i < size; i++) {
+            filter.re[i] = a.re[i] + t * (b.re[i] - a.re[i]);
+            filter.im[i] = a.im[i] + t * (b.im[i] - a.im[i]);
+        }
+    }
+
+    void ConvolutionSpatializer::buildDecodeFilters() {
+        // Basic decode of the horizontal components to a ring of 2 * order + 2 virtual
+        // loudspeakers. Ambisonics angles run anticlockwise, the opposite of azimuth. The second
+        // order components are SN3D scaled by sqrt(3) / 2 relative to circular harmonics.
+        const float secondOrderScale = 2.0f / std::sqrt(3.0f);
+        std::vector<float> left(m_Hrirs.getLength());
+        std::vector<float> right(m_Hrirs.getLength());
+
+        for (int order = 1; order <= MAX_AMBISONICS_ORDER; order++) {
+            const int speakers = 2 * order + 2;
+            for (int channel = 0; channel < 2 * order + 1; channel++) {
+                std::fill(left.begin(), left.end(), 0.0f);
+                std::fill(right.begin(), right.end(), 0.0f);
+                for (int speaker = 0; speaker < speakers; speaker++) {
+                    float angle = static_cast<float>(2.0 * M_PI * speaker / speakers);
+                    float weight;
+                    switch (channel) {
+                        case 0: weight = 1.0f; break;
+                        case 1: weight = 2.0f * std::sin(angle); break;
+                        case 2: weight = 2.0f * std::cos(angle); break;
+                        case 3: weight = 2.0f * secondOrderScale * std::sin(2.0f * angle); break;
+                        default: weight = 2.0f * secondOrderScale * std::cos(2.0f * angle); break;
+                    }
+                    weight /= static_cast<float>(speakers);
+
+                    int direction = directionFor(-angle);
+                    const float *l = m_Hrirs.getLeft(direction);
+                    const float *r = m_Hrirs.getRight(direction);
+                    for (size_t i = 0; i < left.size(); i++) {
+                        left[i] += weight * l[i];
+                        right[i] += weight * r[i];
+                    }
+                }
+                buildFilter(left.data(), right.data(), m_DecodeFilters[order - 1][channel]);
+            }
+        }
+    }
+
+    void ConvolutionSpatializer::transformInput(Convolver &convolver, const float *input) {
+        // The delay line is a ring: the newest spectrum goes in the slot before the last one
+        convolver.newest = (convolver.newest + m_Partitions - 1) % m_Partitions;
+        float *re = &convolver.spectraRe[convolver.newest * m_FftSize];
+        float *im = &convolver.spectraIm[convolver.newest * m_FftSize];
+
+        // Overlap-save: the previous sub-block followed by this one
+        memcpy(re, convolver.history.data(), m_PartitionSize * sizeof(float));
+        memcpy(re + m_PartitionSize, input, m_PartitionSize * sizeof(float));
+        memset(im, 0, m_FftSize * sizeof(float));
+        memcpy(convolver.history.data(), input, m_PartitionSize * sizeof(float));
+        m_Fft.forward(re, im);
+    }
+
+    void ConvolutionSpatializer::accumulate(const Convolver &convolver, const Filter &filter,
+                                            float *accRe, float *accIm) const {
+        for (int partition = 0; partition < m_Partitions; partition++) {
+            int slot = (convolver.newest + partition) % m_Partitions;
+            kernels::complexMultiplyAccumulate(
+                    accRe, accIm,
+                    &convolver.spectraRe[slot * m_FftSize], &convolver.spectraIm[slot * m_FftSize],
+                    &filter.re[partition * m_FftSize], &filter.im[partition * m_FftSize],
+                    m_FftSize);
+        }
+    }
+
+    bool ConvolutionSpatializer::newEffect(SourceState *&state) {
+        if (!isInitialized())
+            return false;
+        state = new SourceState;
+        initConvolver(state->convolver);
+        initFilter(state->filters[0]);
+        initFilter(state->filters[1]);
+        return true;
+    }
+
+    void ConvolutionSpatializer::resetEffect(SourceState *&state) {
+        resetConvolver(state->convolver);
+        state->hasFilter = false;
+    }
+
+    void ConvolutionSpatializer::releaseEffect(SourceState *&state) {
+        delete state;
+        state = nullptr;
+    }
+
+    ConvolutionSpatializer::EffectHandle ConvolutionSpatializer::createSourceEffect() {
+        EffectHandle handle = m_Effects.acquire(
+                [this](SourceState *&state) { return newEffect(state); });
+        if (!handle.isValid())
+            TRACE("Convolution: no effect available (%d in use)", m_Effects.stats().inUse);
+        return handle;
+    }
+
+    void ConvolutionSpatializer::removeSourceEffect(EffectHandle handle) {
+        m_Effects.release(handle, resetEffect, releaseEffect);
+    }
+
+    void ConvolutionSpatializer::reservePool(int effects) {
+        m_Effects.reserve(effects, [this](SourceState *&state) { return newEffect(state); });
+    }
+
+    bool ConvolutionSpatializer::growPool() {
+        return m_Effects.grow([this](SourceState *&state) { return newEffect(state); });
+    }
+
+    void ConvolutionSpatializer::spatialize(EffectHandle handle, const float *monoIn,
+                                            float *leftOut, float *rightOut, int frames,
+                                            float azimuth, float /*elevation*/) {
+        SourceState *const *found = m_Effects.get(handle);
+        if (!found || frames > m_FrameSize || frames % m_PartitionSize != 0) {
+            memset(leftOut, 0, frames * sizeof(float));
+            memset(rightOut, 0, frames * sizeof(float));
+            return;
+        }
+        SourceState &state = **found;
+
+        // Only rebuild the filter when the direction has moved, fading from the old one
+        bool crossfade = false;
+        float moved = std::remainder(azimuth - state.azimuth, static_cast<float>(2.0 * M_PI));
+        if (!state.hasFilter || std::fabs(moved) > AZIMUTH_TOLERANCE) {
+            crossfade = state.hasFilter;
+            state.current = 1 - state.current;
+            interpolateFilter(azimuth, state.filters[state.current]);
+            state.azimuth = azimuth;
+            state.hasFilter = true;
+        }
+        const Filter &filter = state.filters[state.current];
+        const Filter &previous = state.filters[1 - state.current];
+
+        const int half = m_PartitionSize;
+        const float fadeStep = 1.0f / static_cast<float>(frames);
+        for (int offset = 0; offset < frames; offset += half) {
+            transformInput(state.convolver, monoIn + offset);
+
+            std::fill(m_AccRe.begin(), m_AccRe.end(), 0.0f);
+            std::fill(m_AccIm.begin(), m_AccIm.end(), 0.0f);
+            accumulate(state.convolver, filter, m_AccRe.data(), m_AccIm.data());
+            m_Fft.inverse(m_AccRe.data(), m_AccIm.data());
+
+            // The second half of each transform is the valid output
+            if (!crossfade) {
+                memcpy(leftOut + offset, m_AccRe.data() + half, half * sizeof(float));
+                memcpy(rightOut + offset, m_AccIm.data() + half, half * sizeof(float));
+                continue;
+            }
+
+            std::fill(m_FadeRe.begin(), m_FadeRe.end(), 0.0f);
+            std::fill(m_FadeIm.begin(), m_FadeIm.end(), 0.0f);
+            accumulate(state.convolver, previous, m_FadeRe.data(), m_FadeIm.data());
+            m_Fft.inverse(m_FadeRe.data(), m_FadeIm.data());
+            for (int i = 0; i < half; i++) {
+                float t = static_cast<float>(offset + i + 1) * fadeStep;
+                float oldLeft = m_FadeRe[half + i];
+                float oldRight = m_FadeIm[half + i];
+                leftOut[offset + i] = oldLeft + t * (m_AccRe[half + i] - oldLeft);
+                rightOut[offset + i] = oldRight + t * (m_AccIm[half + i] - oldRight);
+            }
+        }
+    }
+
+    void ConvolutionSpatializer::beginAmbisonicsBlock(int order) {
+        order = std::clamp(order, 1, MAX_AMBISONICS_ORDER);
+        if (order != m_AmbisonicsOrder) {
+            // Components which weren't being decoded hold stale history
+            for (auto &convolver: m_DecodeConvolvers)
+                resetConvolver(convolver);
+            m_AmbisonicsOrder = order;
+        }
+        m_AmbisonicsBusActive = false;
+    }
+
+    void ConvolutionSpatializer::encodeToAmbisonics(EffectHandle handle, const float *monoIn,
+                                                    int frames, float azimuth, float elevation,
+                                                    float gain) {
+        if (!m_Effects.get(handle) || frames > m_FrameSize)
+            return;
+
+        // SN3D horizontal components, with angles anticlockwise
+        const float angle = -azimuth;
+        const float level = std::cos(elevation);
+        const float secondOrder = 0.5f * std::sqrt(3.0f) * level * level;
+        const float coefficients[HORIZONTAL_CHANNELS] = {
+                1.0f,
+                std::sin(angle) * level,
+                std::cos(angle) * level,
+                std::sin(2.0f * angle) * secondOrder,
+                std::cos(2.0f * angle) * secondOrder,
+        };
+
+        // The first source overwrites the bus, later ones accumulate into it
+        const int channels = 2 * m_AmbisonicsOrder + 1;
+        for (int ch = 0; ch < channels; ch++) {
+            float *bus = m_AmbisonicsBus.data() + ch * m_FrameSize;
+            if (!m_AmbisonicsBusActive)
+                memset(bus, 0, frames * sizeof(float));
+            kernels::accumulateWithGain(bus, monoIn, gain * coefficients[ch], frames);
+        }
+        m_AmbisonicsBusActive = true;
+    }
+
+    void ConvolutionSpatializer::decodeAmbisonics(float *leftOut, float *rightOut, int frames) {
+        const int channels = 2 * m_AmbisonicsOrder + 1;
+        if (m_AmbisonicsBusActive) {
+            m_AmbisonicsTailFrames = m_Partitions * m_PartitionSize;
+        } else {
+            if (m_AmbisonicsTailFrames <= 0)
+                return;
+            // Nothing was encoded this block, but the filters still ring with earlier ones. Decode
+            // silence until they've played out, which also leaves the convolvers' history clear.
+            for (int ch = 0; ch < channels; ch++)
+                memset(m_AmbisonicsBus.data() + ch * m_FrameSize, 0, frames * sizeof(float));
+            m_AmbisonicsTailFrames -= frames;
+        }
+        m_AmbisonicsBusActive = false;
+        if (frames % m_PartitionSize != 0)
+            return;
+
+        const int half = m_PartitionSize;
+        for (int offset = 0; offset < frames; offset += half) {
+            std::fill(m_AccRe.begin(), m_AccRe.end(), 0.0f);
+            std::fill(m_AccIm.begin(), m_AccIm.end(), 0.0f);
+            for (int ch = 0; ch < channels; ch++) {
+                transformInput(m_DecodeConvolvers[ch],
+                               m_AmbisonicsBus.data() + ch * m_FrameSize + offset);
+                accumulate(m_DecodeConvolvers[ch], m_DecodeFilters[m_AmbisonicsOrder - 1][ch],
+                           m_AccRe.data(), m_AccIm.data());
+            }
+            m_Fft.inverse(m_AccRe.data(), m_AccIm.data());
+            kernels::accumulateWithGain(leftOut + offset, m_AccRe.data() + half, 1.0f, half);
+            kernels::accumulateWithGain(rightOut + offset, m_AccIm.data() + half, 1.0f, half);
+        }
+    }
+
+} // soundscape
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "EffectPool.h"
+#include "Fft.h"
+#include "HrirSet.h"
+#include "Spatializer.h"
+#include <vector>
+
+namespace soundscape {
+
+    // Built in binaural renderer, needing nothing beyond this library. Each source is convolved
+    // with an HRIR pair from HrirSet using uniformly partitioned overlap-save convolution: the
+    // responses are split into partitions the size of a sub-block, and a frequency domain delay
+    // line of the source's recent input spectra is multiplied against them, so the work per
+    // sample stays the same whatever the block size.
+    //
+    // The left and right responses of each direction are packed into a single complex filter
+    // (left + i * right). Since the input is real, one inverse transform then yields the left
+    // ear in its real part and the right ear in its imaginary part, halving the transforms.
+    //
+    // Directions between those in the set are interpolated linearly from the two nearest, and
+    // when a source moves the outputs of its old and new filters are crossfaded over the block.
+    // Elevation is ignored, the set being ear level only. In ambisonics mode the horizontal
+    // components of the bus are decoded to a ring of virtual loudspeakers; as decoding is linear
+    // this folds into one filter per bus channel.
+    class ConvolutionSpatializer : public Spatializer {
+    public:
+        ConvolutionSpatializer(int sampleRate, int frameSize);
+
+        ~ConvolutionSpatializer() override;
+
+        const char *getName() const override { return "convolution"; }
+
+        bool isInitialized() const override { return m_Partitions > 0; }
+
+        int getFrameSize() const override { return m_FrameSize; }
+
+        EffectHandle createSourceEffect() override;
+
+        void removeSourceEffect(EffectHandle handle) override;
+
+        void reservePool(int effects) override;
+
+        bool poolNeedsGrowth() const override { return m_Effects.needsGrowth(); }
+
+        bool growPool() override;
+
+        PoolStats getPoolStats() const override { return m_Effects.stats(); }
+
+        void spatialize(EffectHandle handle, const float *monoIn, float *leftOut,
+                        float *rightOut, int frames, float azimuth, float elevation) override;
+
+        void beginAmbisonicsBlock(int order) override;
+
+        void encodeToAmbisonics(EffectHandle handle, const float *monoIn,
+                                int frames, float azimuth, float elevation, float gain) override;
+
+        void decodeAmbisonics(float *leftOut, float *rightOut, int frames) override;
+
+    private:
+        // Partitions smaller than this cost more in transforms than they save
+        static constexpr int MIN_PARTITION_SIZE = 8;
+
+        // Changes smaller than this (about 0.1 degrees) keep the current filter
+        static constexpr float AZIMUTH_TOLERANCE = 0.002f;
+
+        // W, Y, X of first order then V, U of second (ACN 0, 1, 3, 4 and 8), the only components
+        // an ear level decode uses
+        static constexpr int HORIZONTAL_CHANNELS = 2 * MAX_AMBISONICS_ORDER + 1;
+
+        // One spectrum of fft size per partition, left + i * right, with the inverse transform's
+        // scaling folded in
+        struct Filter {
+            std::vector<float> re;
+            std::vector<float> im;
+        };
+
+        // A stream's last sub-block of input and the spectra of its recent sub-blocks
+        struct Convolver {
+            std::vector<float> history;
+            std::vector<float> spectraRe;
+            std::vector<float> spectraIm;
+            int newest = 0;
+        };
+
+        struct SourceState {
+            Convolver convolver;
+            Filter filters[2];      // current one, and the one being faded out
+            int current = 0;
+            float azimuth = 0.0f;
+            bool hasFilter = false;
+        };
+
+        void initFilter(Filter &filter) const;
+
+        void initConvolver(Convolver &convolver) const;
+
+        static void resetConvolver(Convolver &convolver);
+
+        // Combine both ears of an HRIR pair into a partitioned filter
+        void buildFilter(const float *left, const float *right, Filter &filter);
+
+        void interpolateFilter(float azimuth, Filter &filter) const;
+
+        static int directionFor(float azimuth);
+
+        void buildDecodeFilters();
+
+        // Transform one sub-block of input into the convolver's newest spectrum
+        void transformInput(Convolver &convolver, const float *input);
+
+        // Add the convolver's delay line multiplied against filter to accumulator
+        void accumulate(const Convolver &convolver, const Filter &filter,
+                        float *accRe, float *accIm) const;
+
+        bool newEffect(SourceState *&state);
+
+        static void resetEffect(SourceState *&state);
+
+        static void releaseEffect(SourceState *&state);
+
+        // Largest power of two dividing frameSize, up to the response length
+        static int partitionSizeFor(int frameSize, int responseLength);
+
+        HrirSet m_Hrirs;
+        int m_FrameSize = 0;
+        int m_PartitionSize = 0;
+        int m_FftSize = 0;
+        int m_Partitions = 0;     // 0 if the frame size can't be partitioned
+        Fft m_Fft;
+        std::vector<Filter> m_Directions;   // one per HrirSet direction
+
+        EffectPool<SourceState *, MAX_EFFECTS> m_Effects;
+
+        // Audio thread scratch, one transform's worth each
+        std::vector<float> m_AccRe, m_AccIm;
+        std::vector<float> m_FadeRe, m_FadeIm;
+
+        // Shared ambisonics bus, horizontal components only, and its decoder
+        int m_AmbisonicsOrder = 1;
+        bool m_AmbisonicsBusActive = false;
+        int m_AmbisonicsTailFrames = 0;         // left to decode once the bus is idle
+        std::vector<float> m_AmbisonicsBus;     // channel-major, frameSize samples per channel
+        Convolver m_DecodeConvolvers[HORIZONTAL_CHANNELS];
+        Filter m_DecodeFilters[MAX_AMBISONICS_ORDER][HORIZONTAL_CHANNELS];
+    };
+
+} // soundscape
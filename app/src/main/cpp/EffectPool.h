@@ -0,0 +1,112 @@
+#pragma once
+
+#include "SlotMap.h"
+#include "Spatializer.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace soundscape {
+
+    // The effects a Spatializer has handed out to sources, plus a pool of idle ones so that a
+    // source can usually be given one without creating it. Effect is whatever a spatializer
+    // keeps per source, and is created, reset and destroyed through the callables passed in:
+    //
+    //   create(Effect &) -> bool     make a new effect, false on failure
+    //   reset(Effect &)              clear an effect's history before it's reused
+    //   destroy(Effect &)            free an effect
+    //
+    // Threading is as for Spatializer: everything but get() is serialised by the caller, and
+    // get() is safe on the audio thread.
+    template<typename Effect, int Capacity>
+    class EffectPool {
+    public:
+        using Handle = SlotHandle;
+
+        // Hand out an idle effect, or create one on a miss and have the pool hold more from
+        // then on. Returns an invalid handle on failure.
+        template<typename Create>
+        Handle acquire(Create create) {
+            Effect effect{};
+            if (!m_Idle.empty()) {
+                ++m_Hits;
+                effect = m_Idle.back();
+                m_Idle.pop_back();
+            } else {
+                ++m_Misses;
+                m_Target = std::min(m_Target + GROWTH, MAX_IDLE);
+                if (!create(effect))
+                    return {};
+            }
+
+            Handle handle = m_Live.insert(effect);
+            if (!handle.isValid())
+                m_Idle.push_back(effect);
+            return handle;
+        }
+
+        template<typename Reset, typename Destroy>
+        void release(Handle handle, Reset reset, Destroy destroy) {
+            Effect effect;
+            if (!m_Live.erase(handle, &effect))
+                return;
+
+            if (static_cast<int>(m_Idle.size()) >= MAX_IDLE) {
+                destroy(effect);
+                return;
+            }
+            reset(effect);
+            m_Idle.push_back(effect);
+        }
+
+        template<typename Create>
+        void reserve(int effects, Create create) {
+            m_Target = std::clamp(effects, m_Target, MAX_IDLE);
+            while (needsGrowth() && grow(create)) {
+            }
+        }
+
+        bool needsGrowth() const { return static_cast<int>(m_Idle.size()) < m_Target; }
+
+        template<typename Create>
+        bool grow(Create create) {
+            Effect effect{};
+            if (!create(effect))
+                return false;
+            m_Idle.push_back(effect);
+            return true;
+        }
+
+        Spatializer::PoolStats stats() const {
+            Spatializer::PoolStats stats;
+            stats.hits = m_Hits;
+            stats.misses = m_Misses;
+            stats.idle = static_cast<int>(m_Idle.size());
+            stats.inUse = m_Live.size();
+            return stats;
+        }
+
+        // Any thread. nullptr for stale or invalid handles.
+        const Effect *get(Handle handle) const { return m_Live.get(handle); }
+
+        // Destroy every effect, live or idle
+        template<typename Destroy>
+        void clear(Destroy destroy) {
+            m_Live.forEach([&](Effect &effect) { destroy(effect); });
+            for (auto &effect: m_Idle)
+                destroy(effect);
+            m_Idle.clear();
+        }
+
+    private:
+        static constexpr int GROWTH = 4;
+        static constexpr int MAX_IDLE = 64;
+
+        SlotMap<Effect, Capacity> m_Live;
+        std::vector<Effect> m_Idle;
+        int m_Target = 0;
+        uint64_t m_Hits = 0;
+        uint64_t m_Misses = 0;
+    };
+
+} // soundscape
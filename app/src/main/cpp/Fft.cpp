@@ -0,0 +1,77 @@
+#include "Fft.h"
+#include "MixKernels.h"
+
+#include <cmath>
+#include <utility>
+
+namespace soundscape {
+
+    Fft::Fft(int size) : m_Size(size) {
+        int bits = 0;
+        while ((1 << bits) < size)
+            bits++;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(size); i++) {
+            uint32_t reversed = 0;
+            for (int bit = 0; bit < bits; bit++)
+                reversed |= ((i >> bit) & 1u) << (bits - 1 - bit);
+            if (i < reversed) {
+                m_Swaps.push_back(i);
+                m_Swaps.push_back(reversed);
+            }
+        }
+
+        // Stage with half-length h keeps its twiddles at [h - 1, 2h - 1)
+        m_TwiddleRe.resize(size - 1);
+        m_TwiddleIm.resize(size - 1);
+        for (int half = 1; half < size; half <<= 1) {
+            for (int j = 0; j < half; j++) {
+                double angle = -M_PI * j / half;
+                m_TwiddleRe[half - 1 + j] = static_cast<float>(std::cos(angle));
+                m_TwiddleIm[half - 1 + j] = static_cast<float>(std::sin(angle));
+            }
+        }
+    }
+
+    void Fft::forward(float *re, float *im) const {
+        const int n = m_Size;
+        for (size_t i = 0; i < m_Swaps.size(); i += 2) {
+            std::swap(re[m_Swaps[i]], re[m_Swaps[i + 1]]);
+            std::swap(im[m_Swaps[i]], im[m_Swaps[i + 1]]);
+        }
+
+        // The first two stages have trivial twiddles (1, and 1 and -i) and too few butterflies
+        // per group to be worth a kernel call
+        for (int i = 0; i < n; i += 2) {
+            float r = re[i + 1], m = im[i + 1];
+            re[i + 1] = re[i] - r;
+            im[i + 1] = im[i] - m;
+            re[i] += r;
+            im[i] += m;
+        }
+        for (int i = 0; i < n; i += 4) {
+            float r = re[i + 2], m = im[i + 2];
+            re[i + 2] = re[i] - r;
+            im[i + 2] = im[i] - m;
+            re[i] += r;
+            im[i] += m;
+
+            // Multiplying by -i swaps the parts and negates the new imaginary one
+            r = im[i + 3];
+            m = -re[i + 3];
+            re[i + 3] = re[i + 1] - r;
+            im[i + 3] = im[i + 1] - m;
+            re[i + 1] += r;
+            im[i + 1] += m;
+        }
+
+        for (int half = 4; half < n; half <<= 1) {
+            const float *wRe = m_TwiddleRe.data() + half - 1;
+            const float *wIm = m_TwiddleIm.data() + half - 1;
+            for (int start = 0; start < n; start += 2 * half) {
+                kernels::fftButterflies(re + start, im + start, re + start + half,
+                                        im + start + half, wRe, wIm, half);
+            }
+        }
+    }
+
+} // soundscape
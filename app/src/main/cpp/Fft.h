@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace soundscape {
+
+    // In place radix-2 complex FFT over separate real and imaginary arrays. Twiddles are stored
+    // per stage so that every butterfly pass runs over contiguous memory and can use the SIMD
+    // kernels. Neither direction scales its output. Transforms don't allocate and a single Fft
+    // can be shared by any number of callers on the same thread.
+    class Fft {
+    public:
+        // size must be a power of two, at least 4
+        explicit Fft(int size);
+
+        int size() const { return m_Size; }
+
+        void forward(float *re, float *im) const;
+
+        // Unscaled, so forward followed by inverse multiplies by size()
+        void inverse(float *re, float *im) const { forward(im, re); }
+
+    private:
+        int m_Size;
+        std::vector<uint32_t> m_Swaps;     // pairs of indices to exchange for bit reversal
+        std::vector<float> m_TwiddleRe;    // size - 1: one per butterfly of each stage
+        std::vector<float> m_TwiddleIm;
+    };
+
+} // soundscape
@@ -0,0 +1,131 @@
+#include "AssetSource.h"
+#include "Trace.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+
+namespace soundscape {
+
+    namespace {
+
+        class FileAssetData : public AssetData {
+        public:
+            explicit FileAssetData(std::vector<unsigned char> data) : m_Data(std::move(data)) {}
+
+            const unsigned char *data() const override { return m_Data.data(); }
+
+            size_t size() const override { return m_Data.size(); }
+
+        private:
+            std::vector<unsigned char> m_Data;
+        };
+
+        class MappedAssetData : public AssetData {
+        public:
+            MappedAssetData(void *base, size_t mappedLength, size_t offset, size_t size)
+                    : m_pBase(base), m_MappedLength(mappedLength), m_Offset(offset), m_Size(size) {
+            }
+
+            ~MappedAssetData() override { munmap(m_pBase, m_MappedLength); }
+
+            const unsigned char *data() const override {
+                return static_cast<const unsigned char *>(m_pBase) + m_Offset;
+            }
+
+            size_t size() const override { return m_Size; }
+
+            bool isMapped() const override { return true; }
+
+            void populate() const override {
+                if (madvise(m_pBase, m_MappedLength, MADV_POPULATE_READ) == 0)
+                    return;
+
+                // Kernels before 5.14 don't have MADV_POPULATE_READ, so read a byte of each page
+                auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                const volatile unsigned char *bytes = static_cast<unsigned char *>(m_pBase);
+                for (size_t offset = 0; offset < m_MappedLength; offset += pageSize)
+                    (void) bytes[offset];
+            }
+
+        private:
+            void *m_pBase;
+            size_t m_MappedLength;
+            size_t m_Offset;
+            size_t m_Size;
+        };
+
+    } // namespace
+
+    std::unique_ptr<AssetData> mapAssetData(int fd, int64_t offset, size_t length) {
+        if (fd < 0 || offset < 0 || length == 0)
+            return nullptr;
+
+        // mmap needs a page aligned offset, so map from the start of the page holding offset
+        auto pageSize = static_cast<int64_t>(sysconf(_SC_PAGESIZE));
+        int64_t alignedOffset = offset - offset % pageSize;
+        auto lead = static_cast<size_t>(offset - alignedOffset);
+
+        void *base = mmap(nullptr, lead + length, PROT_READ, MAP_PRIVATE, fd,
+                          static_cast<off_t>(alignedOffset));
+        if (base == MAP_FAILED) {
+            TRACE("mapAssetData: mmap of %zu bytes failed", length);
+            return nullptr;
+        }
+
+        // Start reading the pages in now. This is only a hint, so anything about to play the asset
+        // calls populate() as well.
+        madvise(base, lead + length, MADV_WILLNEED);
+        return std::make_unique<MappedAssetData>(base, lead + length, lead, length);
+    }
+
+    FileAssetSource::FileAssetSource(std::string root) : m_Root(std::move(root)) {
+        if (!m_Root.empty() && m_Root.back() != '/')
+            m_Root += '/';
+    }
+
+    std::unique_ptr<AssetData> FileAssetSource::open(const std::string &path) {
+        std::string fullPath = m_Root + path;
+        FILE *file = fopen(fullPath.c_str(), "rb");
+        if (!file) {
+            TRACE("FileAssetSource: failed to open %s", fullPath.c_str());
+            return nullptr;
+        }
+
+        std::vector<unsigned char> data;
+        if (fseek(file, 0, SEEK_END) == 0) {
+            long length = ftell(file);
+            if (length > 0) {
+                data.resize(static_cast<size_t>(length));
+                fseek(file, 0, SEEK_SET);
+                data.resize(fread(data.data(), 1, data.size(), file));
+            }
+        }
+        fclose(file);
+        return std::make_unique<FileAssetData>(std::move(data));
+    }
+
+    std::unique_ptr<AssetData> FileAssetSource::openMapped(const std::string &path) {
+        std::string fullPath = m_Root + path;
+        int fd = ::open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            TRACE("FileAssetSource: failed to open %s", fullPath.c_str());
+            return nullptr;
+        }
+
+        std::unique_ptr<AssetData> data;
+        struct stat info{};
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+            data = mapAssetData(fd, 0, static_cast<size_t>(info.st_size));
+        close(fd);
+        return data ? std::move(data) : open(path);
+    }
+
+} // soundscape
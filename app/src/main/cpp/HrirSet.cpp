@@ -0,0 +1,129 @@
+#include "HrirSet.h"
+#include "Fft.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+namespace soundscape {
+
+    namespace {
+        // Average adult head
+        constexpr double HEAD_RADIUS = 0.0875;      // metres
+        constexpr double SPEED_OF_SOUND = 343.0;    // metres per second
+
+        // Long enough for the interaural delay plus the pinna reflections
+        constexpr double RESPONSE_SECONDS = 0.0025;
+
+        // Head shadow: strongest a little off the far side rather than directly opposite
+        constexpr double SHADOW_MIN_ALPHA = 0.1;
+        constexpr double SHADOW_MIN_ANGLE = 150.0 * M_PI / 180.0;
+
+        // Pinna reflections at ear level, from Brown and Duda, scaled down to keep the notches
+        // gentle. Delays are in samples at 44.1 kHz. The coefficients sum to zero so the
+        // low-frequency gain is unchanged.
+        constexpr int PINNA_REFLECTIONS = 5;
+        constexpr double PINNA_SCALE = 0.5;
+        constexpr double PINNA_RHO[PINNA_REFLECTIONS] = {0.5, -1.0, 0.5, -0.25, 0.25};
+        constexpr double PINNA_A[PINNA_REFLECTIONS] = {1.0, 5.0, 5.0, 5.0, 5.0};
+        constexpr double PINNA_B[PINNA_REFLECTIONS] = {2.0, 4.0, 7.0, 11.0, 13.0};
+        constexpr double PINNA_D[PINNA_REFLECTIONS] = {1.0, 0.5, 0.5, 0.5, 0.5};
+
+        // Sources directly behind lose this much above REAR_SHELF_HZ
+        constexpr double REAR_SHELF_GAIN = 0.5;
+        constexpr double REAR_SHELF_HZ = 3000.0;
+
+        double wrapAngle(double angle) {
+            return std::remainder(angle, 2.0 * M_PI);
+        }
+    }
+
+    HrirSet::HrirSet(int sampleRate) {
+        m_Length = 1;
+        while (m_Length < RESPONSE_SECONDS * sampleRate)
+            m_Length <<= 1;
+
+        m_Left.resize(AZIMUTHS * m_Length);
+        m_Right.resize(AZIMUTHS * m_Length);
+        for (int direction = 0; direction < AZIMUTHS; direction++) {
+            float azimuth = azimuthOf(direction);
+            synthesise(sampleRate, azimuth, static_cast<float>(-M_PI / 2),
+                       &m_Left[direction * m_Length]);
+            synthesise(sampleRate, azimuth, static_cast<float>(M_PI / 2),
+                       &m_Right[direction * m_Length]);
+        }
+    }
+
+    float HrirSet::azimuthOf(int direction) {
+        return static_cast<float>(direction * AZIMUTH_STEP * M_PI / 180.0);
+    }
+
+    void HrirSet::synthesise(int sampleRate, float azimuth, float earAzimuth, float *out) const {
+        // Built in the frequency domain at a higher resolution than the response, then truncated
+        const int size = m_Length * 4;
+        std::vector<float> re(size), im(size);
+
+        // Angle between the source and the ear's axis, 0 when the source faces the ear
+        const double incidence = std::fabs(wrapAngle(azimuth - earAzimuth));
+        const double headDelay = HEAD_RADIUS / SPEED_OF_SOUND;
+        const double alpha = (1.0 + SHADOW_MIN_ALPHA / 2.0) +
+                             (1.0 - SHADOW_MIN_ALPHA / 2.0) *
+                             std::cos(incidence / SHADOW_MIN_ANGLE * M_PI);
+
+        // Path difference round the head, plus a fixed delay so that the nearer ear's response
+        // still starts a few samples in
+        double delay = incidence < M_PI / 2 ? -headDelay * std::cos(incidence)
+                                            : headDelay * (incidence - M_PI / 2);
+        delay += headDelay + 4.0 / sampleRate;
+
+        // Pinna reflections depend on how far round the source is from facing the ear
+        double pinnaDelays[PINNA_REFLECTIONS];
+        const double towardsEar = incidence - M_PI / 2;
+        for (int n = 0; n < PINNA_REFLECTIONS; n++) {
+            double samples = PINNA_A[n] * std::cos(towardsEar / 2.0) *
+                             std::sin(PINNA_D[n] * M_PI / 2.0) + PINNA_B[n];
+            pinnaDelays[n] = samples / 44100.0;
+        }
+
+        const double rear = std::max(0.0, -std::cos(static_cast<double>(azimuth)));
+        const double rearGain = 1.0 - (1.0 - REAR_SHELF_GAIN) * rear;
+        const double shadowCorner = 2.0 * SPEED_OF_SOUND / HEAD_RADIUS;
+        const double rearCorner = 2.0 * M_PI * REAR_SHELF_HZ;
+        const std::complex<double> j(0.0, 1.0);
+
+        for (int k = 0; k <= size / 2; k++) {
+            double omega = 2.0 * M_PI * k * sampleRate / size;
+            std::complex<double> response =
+                    (1.0 + j * alpha * omega / shadowCorner) / (1.0 + j * omega / shadowCorner);
+            std::complex<double> pinna = 1.0;
+            for (int n = 0; n < PINNA_REFLECTIONS; n++)
+                pinna += PINNA_SCALE * PINNA_RHO[n] * std::exp(-j * omega * pinnaDelays[n]);
+            response *= pinna;
+            response *= (1.0 + j * rearGain * omega / rearCorner) / (1.0 + j * omega / rearCorner);
+            response *= std::exp(-j * omega * delay);
+
+            // Real impulse response, so the spectrum is conjugate symmetric
+            if (k == 0 || k == size / 2)
+                response = response.real();
+            re[k] = static_cast<float>(response.real());
+            im[k] = static_cast<float>(response.imag());
+            if (k > 0 && k < size / 2) {
+                re[size - k] = re[k];
+                im[size - k] = -im[k];
+            }
+        }
+
+        Fft(size).inverse(re.data(), im.data());
+
+        // Keep the start and fade out the last quarter
+        const int fade = m_Length / 4;
+        for (int i = 0; i < m_Length; i++) {
+            float gain = 1.0f / static_cast<float>(size);
+            int fromEnd = m_Length - i;
+            if (fromEnd <= fade)
+                gain *= 0.5f - 0.5f * std::cos(static_cast<float>(M_PI) * fromEnd / fade);
+            out[i] = re[i] * gain;
+        }
+    }
+
+} // soundscape
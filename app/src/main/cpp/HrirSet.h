@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+namespace soundscape {
+
+    // Head related impulse responses for a ring of directions at ear level, AZIMUTH_STEP degrees
+    // apart, starting straight ahead and going round to the right.
+    //
+    // The responses are synthesised for the requested sample rate from a spherical head model
+    // (Brown and Duda's structural model: a head shadow filter and Woodworth style interaural
+    // delay per ear, a few pinna reflections, and a high shelf cut for sources behind) rather
+    // than stored as measurements, so they're small, rate independent and free of licensing
+    // questions. A measured set at the same directions could be dropped in without changing
+    // the renderer.
+    class HrirSet {
+    public:
+        static constexpr int AZIMUTH_STEP = 5;
+        static constexpr int AZIMUTHS = 360 / AZIMUTH_STEP;
+
+        explicit HrirSet(int sampleRate);
+
+        // Taps per response, a power of two
+        int getLength() const { return m_Length; }
+
+        // direction is 0 to AZIMUTHS - 1
+        const float *getLeft(int direction) const { return &m_Left[direction * m_Length]; }
+
+        const float *getRight(int direction) const { return &m_Right[direction * m_Length]; }
+
+        // Radians, positive to the right
+        static float azimuthOf(int direction);
+
+    private:
+        void synthesise(int sampleRate, float azimuth, float earAzimuth, float *out) const;
+
+        int m_Length = 0;
+        std::vector<float> m_Left;
+        std::vector<float> m_Right;
+    };
+
+} // soundscape
@@ -0,0 +1,62 @@
+#include "ListenerPose.h"
+#include "GeoUtils.h"
+
+#include <algorithm>
+
+namespace soundscape {
+
+    double HeadingPredictor::predict(const ListenerPoseHistory &poses, int64_t presentationTimeNs,
+                                     double blockSeconds) {
+        const ListenerPose &current = poses.current;
+        if (std::isnan(current.heading)) {
+            m_HaveEstimate = false;
+            return NAN;
+        }
+
+        // Turn rate from the last two updates, taking the short way round
+        double rate = 0.0;
+        const ListenerPose &previous = poses.previous;
+        if (!std::isnan(previous.heading) && current.timeNs > previous.timeNs) {
+            double dt = static_cast<double>(current.timeNs - previous.timeNs) * 1e-9;
+            rate = wrapDegrees(current.heading - previous.heading) / dt;
+        }
+
+        double ahead = static_cast<double>(presentationTimeNs - current.timeNs) * 1e-9;
+        ahead = std::clamp(ahead, 0.0, MAX_PREDICTION_SECONDS);
+        double target = wrapDegrees(current.heading + rate * ahead);
+
+        if (!m_HaveEstimate) {
+            m_Estimate = target;
+            m_HaveEstimate = true;
+        } else {
+            double alpha = 1.0 - exp(-blockSeconds / SMOOTHING_SECONDS);
+            m_Estimate = wrapDegrees(m_Estimate + wrapDegrees(target - m_Estimate) * alpha);
+        }
+        return m_Estimate;
+    }
+
+    float azimuthForSource(const AudioSourceBase &source, double heading,
+                           double latitude, double longitude) {
+        switch (source.azimuthMode) {
+            case AzimuthMode::RELATIVE:
+                return static_cast<float>(toRadians(source.positionHeading));
+
+            case AzimuthMode::COMPASS:
+                return static_cast<float>(toRadians(source.positionHeading - heading));
+
+            case AzimuthMode::LOCALIZED: {
+                if (std::isnan(source.positionLatitude) || std::isnan(source.positionLongitude))
+                    return NAN;
+                auto bearing = bearingFromTwoPoints(source.positionLatitude,
+                                                    source.positionLongitude,
+                                                    latitude, longitude);
+                return static_cast<float>(toRadians(bearing - heading));
+            }
+
+            case AzimuthMode::FIXED:
+            default:
+                return NAN;
+        }
+    }
+
+} // soundscape
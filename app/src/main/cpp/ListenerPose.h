@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "AudioSourceBase.h"
+
+namespace soundscape {
+
+    // Listener position and heading as reported by the app, timestamped on the monotonic clock
+    struct ListenerPose {
+        int64_t timeNs = 0;
+        double heading = NAN;       // degrees, NaN when there's no heading
+        double latitude = 0.0;
+        double longitude = 0.0;
+    };
+
+    // The two most recent poses, published together so that the audio thread can estimate how
+    // fast the listener is turning.
+    struct ListenerPoseHistory {
+        ListenerPose previous;
+        ListenerPose current;
+    };
+
+    // Audio thread estimate of the listener's heading at the time a block will actually be heard.
+    // Heading updates only arrive every ~100 ms, so each block extrapolates the latest turn rate
+    // to its presentation time and then eases towards that estimate, which hides the correction
+    // when the next update arrives.
+    class HeadingPredictor {
+    public:
+        // Returns NaN if there's no valid heading
+        double predict(const ListenerPoseHistory &poses, int64_t presentationTimeNs,
+                       double blockSeconds);
+
+        void reset() { m_HaveEstimate = false; }
+
+    private:
+        // Don't extrapolate further than this past the last update; beyond it the listener has
+        // most likely stopped turning and overshoot is worse than lag.
+        static constexpr double MAX_PREDICTION_SECONDS = 0.15;
+        // Time constant for easing between successive estimates
+        static constexpr double SMOOTHING_SECONDS = 0.03;
+
+        bool m_HaveEstimate = false;
+        double m_Estimate = 0.0;
+    };
+
+    // Wrap an angle in degrees into [-180, 180)
+    inline double wrapDegrees(double degrees) {
+        degrees = fmod(degrees + 180.0, 360.0);
+        if (degrees < 0.0)
+            degrees += 360.0;
+        return degrees - 180.0;
+    }
+
+    // Azimuth in radians for the source given the listener's heading and location, matching what
+    // PositionedAudio::UpdateAzimuth computes on the game thread. Returns NaN for FIXED sources
+    // or sources without a location.
+    float azimuthForSource(const AudioSourceBase &source, double heading,
+                           double latitude, double longitude);
+
+} // soundscape
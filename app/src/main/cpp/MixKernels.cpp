@@ -0,0 +1,393 @@
+#include "MixKernels.h"
+
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SOUNDSCAPE_KERNELS_NEON 1
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define SOUNDSCAPE_KERNELS_AVX 1
+#define SOUNDSCAPE_KERNELS_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOUNDSCAPE_KERNELS_SSE 1
+#endif
+
+namespace soundscape::kernels {
+
+    const char *implementationName() {
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        return "NEON";
+#elif defined(SOUNDSCAPE_KERNELS_AVX)
+        return "AVX";
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+    void accumulateWithGain(float *out, const float *in, float gain, int numSamples) {
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        float32x4_t g = vdupq_n_f32(gain);
+        for (; i + 8 <= numSamples; i += 8) {
+            float32x4_t o0 = vld1q_f32(out + i);
+            float32x4_t o1 = vld1q_f32(out + i + 4);
+            o0 = vmlaq_f32(o0, vld1q_f32(in + i), g);
+            o1 = vmlaq_f32(o1, vld1q_f32(in + i + 4), g);
+            vst1q_f32(out + i, o0);
+            vst1q_f32(out + i + 4, o1);
+        }
+#elif defined(SOUNDSCAPE_KERNELS_AVX)
+        __m256 g = _mm256_set1_ps(gain);
+        for (; i + 8 <= numSamples; i += 8) {
+            __m256 o = _mm256_loadu_ps(out + i);
+            o = _mm256_add_ps(o, _mm256_mul_ps(_mm256_loadu_ps(in + i), g));
+            _mm256_storeu_ps(out + i, o);
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        __m128 g = _mm_set1_ps(gain);
+        for (; i + 8 <= numSamples; i += 8) {
+            __m128 o0 = _mm_loadu_ps(out + i);
+            __m128 o1 = _mm_loadu_ps(out + i + 4);
+            o0 = _mm_add_ps(o0, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+            o1 = _mm_add_ps(o1, _mm_mul_ps(_mm_loadu_ps(in + i + 4), g));
+            _mm_storeu_ps(out + i, o0);
+            _mm_storeu_ps(out + i + 4, o1);
+        }
+#endif
+        for (; i < numSamples; i++) {
+            out[i] += in[i] * gain;
+        }
+    }
+
+    void accumulateMonoPlanar(float *left, float *right, const float *mono,
+                              float leftGain, float rightGain, int numFrames) {
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        float32x4_t gl = vdupq_n_f32(leftGain);
+        float32x4_t gr = vdupq_n_f32(rightGain);
+        for (; i + 4 <= numFrames; i += 4) {
+            float32x4_t m = vld1q_f32(mono + i);
+            vst1q_f32(left + i, vmlaq_f32(vld1q_f32(left + i), m, gl));
+            vst1q_f32(right + i, vmlaq_f32(vld1q_f32(right + i), m, gr));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_AVX)
+        __m256 gl = _mm256_set1_ps(leftGain);
+        __m256 gr = _mm256_set1_ps(rightGain);
+        for (; i + 8 <= numFrames; i += 8) {
+            __m256 m = _mm256_loadu_ps(mono + i);
+            _mm256_storeu_ps(left + i, _mm256_add_ps(_mm256_loadu_ps(left + i),
+                                                     _mm256_mul_ps(m, gl)));
+            _mm256_storeu_ps(right + i, _mm256_add_ps(_mm256_loadu_ps(right + i),
+                                                      _mm256_mul_ps(m, gr)));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        __m128 gl = _mm_set1_ps(leftGain);
+        __m128 gr = _mm_set1_ps(rightGain);
+        for (; i + 4 <= numFrames; i += 4) {
+            __m128 m = _mm_loadu_ps(mono + i);
+            _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(m, gl)));
+            _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(m, gr)));
+        }
+#endif
+        for (; i < numFrames; i++) {
+            left[i] += mono[i] * leftGain;
+            right[i] += mono[i] * rightGain;
+        }
+    }
+
+    void interleaveClamped(float *outStereo, const float *left, const float *right,
+                           int numFrames) {
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        float32x4_t lo = vdupq_n_f32(-1.0f);
+        float32x4_t hi = vdupq_n_f32(1.0f);
+        for (; i + 4 <= numFrames; i += 4) {
+            float32x4x2_t o;
+            o.val[0] = vminq_f32(vmaxq_f32(vld1q_f32(left + i), lo), hi);
+            o.val[1] = vminq_f32(vmaxq_f32(vld1q_f32(right + i), lo), hi);
+            vst2q_f32(outStereo + i * 2, o);
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        __m128 lo = _mm_set1_ps(-1.0f);
+        __m128 hi = _mm_set1_ps(1.0f);
+        for (; i + 4 <= numFrames; i += 4) {
+            __m128 l = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(left + i), lo), hi);
+            __m128 r = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(right + i), lo), hi);
+            _mm_storeu_ps(outStereo + i * 2, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(outStereo + i * 2 + 4, _mm_unpackhi_ps(l, r));
+        }
+#endif
+        for (; i < numFrames; i++) {
+            outStereo[i * 2] = std::clamp(left[i], -1.0f, 1.0f);
+            outStereo[i * 2 + 1] = std::clamp(right[i], -1.0f, 1.0f);
+        }
+    }
+
+    void complexMultiplyAccumulate(float *accRe, float *accIm, const float *aRe,
+                                   const float *aIm, const float *bRe, const float *bIm,
+                                   int n) {
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        for (; i + 4 <= n; i += 4) {
+            float32x4_t ar = vld1q_f32(aRe + i);
+            float32x4_t ai = vld1q_f32(aIm + i);
+            float32x4_t br = vld1q_f32(bRe + i);
+            float32x4_t bi = vld1q_f32(bIm + i);
+            float32x4_t re = vmlaq_f32(vld1q_f32(accRe + i), ar, br);
+            float32x4_t im = vmlaq_f32(vld1q_f32(accIm + i), ar, bi);
+            vst1q_f32(accRe + i, vmlsq_f32(re, ai, bi));
+            vst1q_f32(accIm + i, vmlaq_f32(im, ai, br));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_AVX)
+        for (; i + 8 <= n; i += 8) {
+            __m256 ar = _mm256_loadu_ps(aRe + i);
+            __m256 ai = _mm256_loadu_ps(aIm + i);
+            __m256 br = _mm256_loadu_ps(bRe + i);
+            __m256 bi = _mm256_loadu_ps(bIm + i);
+            __m256 re = _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi));
+            __m256 im = _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br));
+            _mm256_storeu_ps(accRe + i, _mm256_add_ps(_mm256_loadu_ps(accRe + i), re));
+            _mm256_storeu_ps(accIm + i, _mm256_add_ps(_mm256_loadu_ps(accIm + i), im));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        for (; i + 4 <= n; i += 4) {
+            __m128 ar = _mm_loadu_ps(aRe + i);
+            __m128 ai = _mm_loadu_ps(aIm + i);
+            __m128 br = _mm_loadu_ps(bRe + i);
+            __m128 bi = _mm_loadu_ps(bIm + i);
+            __m128 re = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+            __m128 im = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+            _mm_storeu_ps(accRe + i, _mm_add_ps(_mm_loadu_ps(accRe + i), re));
+            _mm_storeu_ps(accIm + i, _mm_add_ps(_mm_loadu_ps(accIm + i), im));
+        }
+#endif
+        for (; i < n; i++) {
+            accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+            accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+        }
+    }
+
+    void fftButterflies(float *aRe, float *aIm, float *bRe, float *bIm, const float *wRe,
+                        const float *wIm, int n) {
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        for (; i + 4 <= n; i += 4) {
+            float32x4_t br = vld1q_f32(bRe + i);
+            float32x4_t bi = vld1q_f32(bIm + i);
+            float32x4_t wr = vld1q_f32(wRe + i);
+            float32x4_t wi = vld1q_f32(wIm + i);
+            float32x4_t tr = vmlsq_f32(vmulq_f32(br, wr), bi, wi);
+            float32x4_t ti = vmlaq_f32(vmulq_f32(br, wi), bi, wr);
+            float32x4_t ar = vld1q_f32(aRe + i);
+            float32x4_t ai = vld1q_f32(aIm + i);
+            vst1q_f32(bRe + i, vsubq_f32(ar, tr));
+            vst1q_f32(bIm + i, vsubq_f32(ai, ti));
+            vst1q_f32(aRe + i, vaddq_f32(ar, tr));
+            vst1q_f32(aIm + i, vaddq_f32(ai, ti));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_AVX)
+        for (; i + 8 <= n; i += 8) {
+            __m256 br = _mm256_loadu_ps(bRe + i);
+            __m256 bi = _mm256_loadu_ps(bIm + i);
+            __m256 wr = _mm256_loadu_ps(wRe + i);
+            __m256 wi = _mm256_loadu_ps(wIm + i);
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(br, wr), _mm256_mul_ps(bi, wi));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(br, wi), _mm256_mul_ps(bi, wr));
+            __m256 ar = _mm256_loadu_ps(aRe + i);
+            __m256 ai = _mm256_loadu_ps(aIm + i);
+            _mm256_storeu_ps(bRe + i, _mm256_sub_ps(ar, tr));
+            _mm256_storeu_ps(bIm + i, _mm256_sub_ps(ai, ti));
+            _mm256_storeu_ps(aRe + i, _mm256_add_ps(ar, tr));
+            _mm256_storeu_ps(aIm + i, _mm256_add_ps(ai, ti));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        for (; i + 4 <= n; i += 4) {
+            __m128 br = _mm_loadu_ps(bRe + i);
+            __m128 bi = _mm_loadu_ps(bIm + i);
+            __m128 wr = _mm_loadu_ps(wRe + i);
+            __m128 wi = _mm_loadu_ps(wIm + i);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+            __m128 ar = _mm_loadu_ps(aRe + i);
+            __m128 ai = _mm_loadu_ps(aIm + i);
+            _mm_storeu_ps(bRe + i, _mm_sub_ps(ar, tr));
+            _mm_storeu_ps(bIm + i, _mm_sub_ps(ai, ti));
+            _mm_storeu_ps(aRe + i, _mm_add_ps(ar, tr));
+            _mm_storeu_ps(aIm + i, _mm_add_ps(ai, ti));
+        }
+#endif
+        for (; i < n; i++) {
+            float tr = bRe[i] * wRe[i] - bIm[i] * wIm[i];
+            float ti = bRe[i] * wIm[i] + bIm[i] * wRe[i];
+            bRe[i] = aRe[i] - tr;
+            bIm[i] = aIm[i] - ti;
+            aRe[i] += tr;
+            aIm[i] += ti;
+        }
+    }
+
+    void convertPcm8(float *out, const uint8_t *in, int numSamples) {
+        const float scale = 1.0f / 128.0f;
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        int16x8_t bias = vdupq_n_s16(128);
+        for (; i + 8 <= numSamples; i += 8) {
+            int16x8_t s = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(in + i))), bias);
+            // Converting with 7 fractional bits divides by 128 exactly
+            vst1q_f32(out + i, vcvtq_n_f32_s32(vmovl_s16(vget_low_s16(s)), 7));
+            vst1q_f32(out + i + 4, vcvtq_n_f32_s32(vmovl_s16(vget_high_s16(s)), 7));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        __m128 g = _mm_set1_ps(scale);
+        __m128i zero = _mm_setzero_si128();
+        __m128i bias = _mm_set1_epi16(128);
+        for (; i + 8 <= numSamples; i += 8) {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i));
+            __m128i s = _mm_sub_epi16(_mm_unpacklo_epi8(bytes, zero), bias);
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+        }
+#endif
+        for (; i < numSamples; i++) {
+            out[i] = (static_cast<float>(in[i]) - 128.0f) * scale;
+        }
+    }
+
+    void convertPcm16(float *out, const int16_t *in, int numSamples) {
+        const float scale = 1.0f / 32768.0f;
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        for (; i + 8 <= numSamples; i += 8) {
+            int16x8_t s = vld1q_s16(in + i);
+            // Converting with 15 fractional bits divides by 32768 exactly
+            vst1q_f32(out + i, vcvtq_n_f32_s32(vmovl_s16(vget_low_s16(s)), 15));
+            vst1q_f32(out + i + 4, vcvtq_n_f32_s32(vmovl_s16(vget_high_s16(s)), 15));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        __m128 g = _mm_set1_ps(scale);
+        for (; i + 8 <= numSamples; i += 8) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            // Sign extend by unpacking each sample into the top half of a 32 bit lane
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+        }
+#endif
+        for (; i < numSamples; i++) {
+            out[i] = static_cast<float>(in[i]) * scale;
+        }
+    }
+
+    void downmixPcm16Stereo(float *out, const int16_t *inStereo, int numFrames) {
+        // Half of 1 / 32768
+        const float scale = 1.0f / 65536.0f;
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        for (; i + 8 <= numFrames; i += 8) {
+            int16x8x2_t s = vld2q_s16(inStereo + i * 2);
+            int32x4_t lo = vaddl_s16(vget_low_s16(s.val[0]), vget_low_s16(s.val[1]));
+            int32x4_t hi = vaddl_s16(vget_high_s16(s.val[0]), vget_high_s16(s.val[1]));
+            vst1q_f32(out + i, vcvtq_n_f32_s32(lo, 16));
+            vst1q_f32(out + i + 4, vcvtq_n_f32_s32(hi, 16));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        __m128 g = _mm_set1_ps(scale);
+        __m128i ones = _mm_set1_epi16(1);
+        for (; i + 4 <= numFrames; i += 4) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inStereo + i * 2));
+            // Multiply-add against ones sums each left and right pair into a 32 bit lane
+            __m128i sum = _mm_madd_epi16(s, ones);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(sum), g));
+        }
+#endif
+        for (; i < numFrames; i++) {
+            int sum = inStereo[i * 2] + inStereo[i * 2 + 1];
+            out[i] = static_cast<float>(sum) * scale;
+        }
+    }
+
+    void downmixStereo(float *out, const float *inStereo, int numFrames) {
+        int i = 0;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+        float32x4_t half = vdupq_n_f32(0.5f);
+        for (; i + 4 <= numFrames; i += 4) {
+            float32x4x2_t s = vld2q_f32(inStereo + i * 2);
+            vst1q_f32(out + i, vmulq_f32(vaddq_f32(s.val[0], s.val[1]), half));
+        }
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+        __m128 half = _mm_set1_ps(0.5f);
+        for (; i + 4 <= numFrames; i += 4) {
+            __m128 a = _mm_loadu_ps(inStereo + i * 2);
+            __m128 b = _mm_loadu_ps(inStereo + i * 2 + 4);
+            __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+        }
+#endif
+        for (; i < numFrames; i++) {
+            out[i] = (inStereo[i * 2] + inStereo[i * 2 + 1]) * 0.5f;
+        }
+    }
+
+    namespace {
+        // Sum of a[i] * b[i] for n values, a multiple of 4. Two accumulators, so that each add
+        // doesn't wait on the one before.
+        inline float dotProduct(const float *a, const float *b, int n) {
+            int i = 0;
+            float sum = 0.0f;
+#if defined(SOUNDSCAPE_KERNELS_NEON)
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+            for (; i + 8 <= n; i += 8) {
+                acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+                acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+            }
+            if (i + 4 <= n) {
+                acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+                i += 4;
+            }
+            float32x4_t acc = vaddq_f32(acc0, acc1);
+            float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+            sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#elif defined(SOUNDSCAPE_KERNELS_SSE)
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+            for (; i + 8 <= n; i += 8) {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+                acc1 = _mm_add_ps(acc1,
+                                  _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+            }
+            if (i + 4 <= n) {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+                i += 4;
+            }
+            __m128 acc = _mm_add_ps(acc0, acc1);
+            acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+            acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 1, 1, 1)));
+            sum = _mm_cvtss_f32(acc);
+#endif
+            for (; i < n; i++) {
+                sum += a[i] * b[i];
+            }
+            return sum;
+        }
+    } // namespace
+
+    void polyphaseFir(float *out, const float *in, const float *coefficients, int taps,
+                      int phases, int step, int phase, int numFrames) {
+        for (int i = 0; i < numFrames; i++) {
+            out[i] = dotProduct(in, coefficients + static_cast<size_t>(phase) * taps, taps);
+            phase += step;
+            in += phase / phases;
+            phase %= phases;
+        }
+    }
+
+} // soundscape::kernels
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+namespace soundscape {
+
+    // Inner loops of the mixer, vectorised with NEON on ARM and SSE/AVX on x86. The
+    // implementation is chosen at compile time from the target's instruction set, with a scalar
+    // fallback for anything else. None of these allocate, so all are safe on the audio thread.
+    namespace kernels {
+
+        // Name of the implementation compiled in ("NEON", "AVX", "SSE2" or "scalar")
+        const char *implementationName();
+
+        // out[i] += in[i] * gain, for numSamples samples
+        void accumulateWithGain(float *out, const float *in, float gain, int numSamples);
+
+        // Planar (separate left and right) forms, which the mixer's bus uses
+
+        // Add mono input to separate left and right channels with separate gains
+        void accumulateMonoPlanar(float *left, float *right, const float *mono,
+                                  float leftGain, float rightGain, int numFrames);
+
+        // Interleave left and right channels into a stereo buffer, clamping to [-1, 1]
+        void interleaveClamped(float *outStereo, const float *left, const float *right,
+                               int numFrames);
+
+        // Complex forms on separate real and imaginary arrays, which ConvolutionSpatializer uses
+
+        // acc[i] += a[i] * b[i], for n complex values
+        void complexMultiplyAccumulate(float *accRe, float *accIm, const float *aRe,
+                                       const float *aIm, const float *bRe, const float *bIm,
+                                       int n);
+
+        // n radix-2 FFT butterflies: t = b[i] * w[i], then b[i] = a[i] - t and a[i] = a[i] + t
+        void fftButterflies(float *aRe, float *aIm, float *bRe, float *bIm, const float *wRe,
+                            const float *wIm, int n);
+
+        // Sample conversion and resampling, which WavDecoder uses to expand its compact samples
+
+        // out[i] = (in[i] - 128) / 128, for numSamples unsigned 8 bit samples
+        void convertPcm8(float *out, const uint8_t *in, int numSamples);
+
+        // out[i] = in[i] / 32768, for numSamples 16 bit samples
+        void convertPcm16(float *out, const int16_t *in, int numSamples);
+
+        // Downmix interleaved 16 bit stereo to float mono
+        void downmixPcm16Stereo(float *out, const int16_t *inStereo, int numFrames);
+
+        // Downmix interleaved float stereo to mono
+        void downmixStereo(float *out, const float *inStereo, int numFrames);
+
+        // Polyphase FIR, as PolyphaseFilter uses. Each output is the dot product of taps inputs
+        // from in with the taps coefficients for its phase (coefficients holds phases sets of
+        // them), after which phase moves on by step and in by the whole inputs that carries
+        // over. taps must be a multiple of 4, and in must hold every input the outputs reach.
+        void polyphaseFir(float *out, const float *in, const float *coefficients, int taps,
+                          int phases, int step, int phase, int numFrames);
+
+    } // kernels
+
+} // soundscape
@@ -0,0 +1,202 @@
+#include "OboeAudioOutput.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+namespace soundscape {
+
+    OboeAudioOutput::~OboeAudioOutput() {
+        close();
+    }
+
+    bool OboeAudioOutput::open(Callback *callback) {
+        m_pCallback = callback;
+        m_ClosedByOboe.store(false);
+        m_LowLatency.store(false);
+
+        if (m_LowLatencyRequested.load()) {
+            if (openLowLatency())
+                return true;
+            TRACE("AudioMixer: low latency unavailable on this route, using normal stream");
+        }
+        return openStandard();
+    }
+
+    bool OboeAudioOutput::openLowLatency() {
+        // No sample rate or callback size, so that the stream can use the device's own and skip
+        // resampling and re-buffering
+        oboe::AudioStreamBuilder builder;
+        builder.setDirection(oboe::Direction::Output)
+                ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
+                ->setSharingMode(oboe::SharingMode::Exclusive)
+                ->setFormat(oboe::AudioFormat::Float)
+                ->setChannelCount(oboe::ChannelCount::Stereo)
+                ->setUsage(oboe::Usage::Media)
+                ->setContentType(oboe::ContentType::Music)
+                ->setDataCallback(this)
+                ->setErrorCallback(this);
+
+        auto result = builder.openStream(m_Stream);
+        if (result != oboe::Result::OK) {
+            TRACE("AudioMixer: failed to open low latency stream: %s",
+                  oboe::convertToText(result));
+            m_Stream.reset();
+            return false;
+        }
+
+        // Routes such as A2DP don't have a fast path and quietly give us a normal stream, in
+        // which case the fixed callback size of the normal stream is the better choice.
+        if (m_Stream->getPerformanceMode() != oboe::PerformanceMode::LowLatency) {
+            m_Stream->close();
+            m_Stream.reset();
+            return false;
+        }
+
+        int burst = m_Stream->getFramesPerBurst();
+        m_SampleRate = m_Stream->getSampleRate();
+        m_FramesPerBlock = burst;
+        m_Stream->setBufferSizeInFrames(burst * MIN_BUFFER_BURSTS);
+
+        m_FramesSinceCheck = 0;
+        m_StableFrames = 0;
+        m_LastXRunCount = 0;
+        m_BufferSizeInFrames.store(m_Stream->getBufferSizeInFrames());
+        m_XRunCount.store(0);
+        m_LowLatency.store(true);
+
+        TRACE("AudioMixer: low latency stream opened (rate=%d, burst=%d, buffer=%d, "
+              "capacity=%d, %s, %s)",
+              m_SampleRate, burst, m_Stream->getBufferSizeInFrames(),
+              m_Stream->getBufferCapacityInFrames(),
+              m_Stream->getSharingMode() == oboe::SharingMode::Exclusive ? "exclusive" : "shared",
+              m_Stream->usesAAudio() ? "AAudio" : "OpenSL ES");
+        return true;
+    }
+
+    bool OboeAudioOutput::openStandard() {
+        oboe::AudioStreamBuilder builder;
+        builder.setDirection(oboe::Direction::Output)
+                ->setPerformanceMode(oboe::PerformanceMode::None)
+                ->setSharingMode(oboe::SharingMode::Shared)
+                ->setFormat(oboe::AudioFormat::Float)
+                ->setChannelCount(oboe::ChannelCount::Stereo)
+                ->setSampleRate(48000)
+                ->setFramesPerDataCallback(m_FramesPerCallback)
+                ->setUsage(oboe::Usage::Media)
+                ->setContentType(oboe::ContentType::Music)
+                ->setDataCallback(this)
+                ->setErrorCallback(this);
+
+        auto result = builder.openStream(m_Stream);
+        if (result != oboe::Result::OK) {
+            TRACE("AudioMixer: failed to open stream: %s", oboe::convertToText(result));
+            return false;
+        }
+
+        m_SampleRate = m_Stream->getSampleRate();
+        m_FramesPerBlock = m_FramesPerCallback;
+        m_BufferSizeInFrames.store(m_Stream->getBufferSizeInFrames());
+        TRACE("AudioMixer: stream opened (rate=%d, framesPerCallback=%d, bufferCapacity=%d)",
+              m_SampleRate, m_Stream->getFramesPerCallback(),
+              m_Stream->getBufferCapacityInFrames());
+        return true;
+    }
+
+    bool OboeAudioOutput::start() {
+        if (!m_Stream)
+            return false;
+
+        auto result = m_Stream->requestStart();
+        if (result != oboe::Result::OK) {
+            TRACE("AudioMixer: failed to start stream: %s", oboe::convertToText(result));
+            return false;
+        }
+        return true;
+    }
+
+    void OboeAudioOutput::close() {
+        if (!m_Stream)
+            return;
+
+        // Oboe closes the stream before onErrorAfterClose fires, in which case just drop the
+        // handle
+        if (!m_ClosedByOboe.load()) {
+            m_Stream->requestStop();
+            m_Stream->close();
+        }
+        m_Stream.reset();
+    }
+
+    int64_t OboeAudioOutput::presentationTimeNs(oboe::AudioStream *stream, int numFrames) const {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t halfBlockNs = static_cast<int64_t>(numFrames) * 500000000LL / m_SampleRate;
+
+        // The stream timestamp tells us when a recent frame was presented, from which we can work
+        // out when the first frame of this block will be.
+        auto timestamp = stream->getTimestamp(CLOCK_MONOTONIC);
+        if (timestamp) {
+            int64_t framesAhead = stream->getFramesWritten() - timestamp.value().position;
+            int64_t presentation = timestamp.value().timestamp +
+                                   framesAhead * 1000000000LL / m_SampleRate;
+            // Discard anything implausible, e.g. a stale timestamp just after a restart
+            if (presentation >= now && presentation < now + 1000000000LL)
+                return presentation + halfBlockNs;
+        }
+
+        // No timestamp yet: assume the whole buffer is queued ahead of us
+        int64_t buffered = stream->getBufferSizeInFrames();
+        return now + buffered * 1000000000LL / m_SampleRate + halfBlockNs;
+    }
+
+    void OboeAudioOutput::tuneBufferSize(oboe::AudioStream *stream, int numFrames) {
+        m_FramesSinceCheck += numFrames;
+        int checkFrames = m_SampleRate / TUNE_CHECKS_PER_SECOND;
+        if (m_FramesSinceCheck < checkFrames)
+            return;
+        m_StableFrames += m_FramesSinceCheck;
+        m_FramesSinceCheck = 0;
+
+        auto xRuns = stream->getXRunCount();
+        if (!xRuns)
+            return;
+
+        int burst = stream->getFramesPerBurst();
+        int size = stream->getBufferSizeInFrames();
+        int newSize = size;
+        if (xRuns.value() > m_LastXRunCount) {
+            newSize = std::min(size + burst, stream->getBufferCapacityInFrames());
+            m_StableFrames = 0;
+        } else if (m_StableFrames >= m_SampleRate * STABLE_SECONDS) {
+            newSize = std::max(size - burst, burst * MIN_BUFFER_BURSTS);
+            m_StableFrames = 0;
+        }
+        if (newSize != size) {
+            auto result = stream->setBufferSizeInFrames(newSize);
+            if (result)
+                size = result.value();
+        }
+
+        m_LastXRunCount = xRuns.value();
+        m_XRunCount.store(m_LastXRunCount, std::memory_order_relaxed);
+        m_BufferSizeInFrames.store(size, std::memory_order_relaxed);
+    }
+
+    oboe::DataCallbackResult OboeAudioOutput::onAudioReady(
+            oboe::AudioStream *stream, void *audioData, int32_t numFrames) {
+        m_pCallback->render(static_cast<float *>(audioData), numFrames,
+                            presentationTimeNs(stream, numFrames));
+        if (m_LowLatency.load(std::memory_order_relaxed))
+            tuneBufferSize(stream, numFrames);
+        return oboe::DataCallbackResult::Continue;
+    }
+
+    void OboeAudioOutput::onErrorAfterClose(oboe::AudioStream * /*stream*/, oboe::Result result) {
+        TRACE("AudioMixer: onErrorAfterClose: %s", oboe::convertToText(result));
+        m_ClosedByOboe.store(true);
+        m_pCallback->onOutputClosed(result == oboe::Result::ErrorDisconnected);
+    }
+
+} // soundscape
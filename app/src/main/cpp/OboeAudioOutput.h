@@ -0,0 +1,89 @@
+#pragma once
+
+#include <oboe/Oboe.h>
+#include <atomic>
+#include <memory>
+
+#include "AudioOutput.h"
+
+namespace soundscape {
+
+    class OboeAudioOutput : public AudioOutput,
+                            public oboe::AudioStreamDataCallback,
+                            public oboe::AudioStreamErrorCallback {
+    public:
+        explicit OboeAudioOutput(int framesPerCallback) : m_FramesPerCallback(framesPerCallback) {}
+
+        ~OboeAudioOutput() override;
+
+        // Opt in to a low latency stream: exclusive (MMAP where available) at the device's native
+        // rate, called back once per burst, with the buffer size tuned from the underrun count.
+        // Routes without a low latency path, e.g. Bluetooth A2DP, fall back to the normal
+        // stream. Takes effect the next time the output is opened.
+        void setLowLatencyRequested(bool enable) { m_LowLatencyRequested.store(enable); }
+
+        bool isLowLatencyRequested() const { return m_LowLatencyRequested.load(); }
+
+        // Whether the currently open stream is low latency
+        bool isLowLatency() const { return m_LowLatency.load(); }
+
+        int getBufferSizeInFrames() const { return m_BufferSizeInFrames.load(); }
+
+        int getXRunCount() const { return m_XRunCount.load(); }
+
+        // AudioOutput interface
+        bool open(Callback *callback) override;
+
+        bool start() override;
+
+        void close() override;
+
+        int getSampleRate() const override { return m_SampleRate; }
+
+        int getFramesPerBlock() const override { return m_FramesPerBlock; }
+
+        // Oboe callbacks
+        oboe::DataCallbackResult onAudioReady(
+                oboe::AudioStream *stream, void *audioData, int32_t numFrames) override;
+
+        void onErrorAfterClose(oboe::AudioStream *stream, oboe::Result result) override;
+
+    private:
+        bool openLowLatency();
+
+        bool openStandard();
+
+        // Monotonic time at which the middle of the block about to be rendered will be heard
+        int64_t presentationTimeNs(oboe::AudioStream *stream, int numFrames) const;
+
+        // Called from the callback of a low latency stream. Grows the buffer by a burst whenever
+        // the underrun count goes up, and shrinks it by a burst after a period without any.
+        void tuneBufferSize(oboe::AudioStream *stream, int numFrames);
+
+        // How often the underrun count is checked, how long the stream must run cleanly before
+        // the buffer is shrunk, and the smallest buffer it's shrunk to.
+        static constexpr int TUNE_CHECKS_PER_SECOND = 10;
+        static constexpr int STABLE_SECONDS = 10;
+        static constexpr int MIN_BUFFER_BURSTS = 2;
+
+        int m_FramesPerCallback;
+        int m_SampleRate = 48000;
+        int m_FramesPerBlock = 0;
+        Callback *m_pCallback = nullptr;
+        std::shared_ptr<oboe::AudioStream> m_Stream;
+
+        std::atomic<bool> m_LowLatencyRequested{false};
+        std::atomic<bool> m_LowLatency{false};
+
+        // Buffer tuning, audio thread only apart from the atomics which are there to be read
+        int m_FramesSinceCheck = 0;
+        int m_StableFrames = 0;
+        int m_LastXRunCount = 0;
+        std::atomic<int> m_BufferSizeInFrames{0};
+        std::atomic<int> m_XRunCount{0};
+
+        // Set once Oboe has closed the stream itself, after which it mustn't be closed again
+        std::atomic<bool> m_ClosedByOboe{false};
+    };
+
+} // soundscape
@@ -0,0 +1,196 @@
+#include "OfflineRenderer.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+
+namespace soundscape {
+
+    namespace {
+
+        // 32-bit float stereo WAV header. The sizes are filled in when the file is closed.
+        struct WavHeader {
+            char riff[4] = {'R', 'I', 'F', 'F'};
+            uint32_t riffSize = 0;
+            char wave[4] = {'W', 'A', 'V', 'E'};
+            char fmt[4] = {'f', 'm', 't', ' '};
+            uint32_t fmtSize = 16;
+            uint16_t format = 3;        // WAVE_FORMAT_IEEE_FLOAT
+            uint16_t channels = 2;
+            uint32_t sampleRate = 0;
+            uint32_t byteRate = 0;
+            uint16_t blockAlign = 2 * sizeof(float);
+            uint16_t bitsPerSample = 32;
+            char data[4] = {'d', 'a', 't', 'a'};
+            uint32_t dataSize = 0;
+        };
+        static_assert(sizeof(WavHeader) == 44, "WAV header must be packed");
+
+        // Page faults taken by the calling thread so far
+        long threadFaults() {
+            rusage usage{};
+            if (getrusage(RUSAGE_THREAD, &usage) != 0)
+                return 0;
+            return usage.ru_minflt + usage.ru_majflt;
+        }
+
+        double percentile(const std::vector<double> &sorted, double p) {
+            if (sorted.empty())
+                return 0.0;
+            auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+            return sorted[std::min(index, sorted.size() - 1)];
+        }
+
+        // A "Name:   1234 kB" line of /proc/self/status, or 0
+        long readStatusKb(const char *name) {
+            FILE *status = fopen("/proc/self/status", "r");
+            if (!status)
+                return 0;
+            long kb = 0;
+            char line[128];
+            size_t length = strlen(name);
+            while (fgets(line, sizeof(line), status)) {
+                if (strncmp(line, name, length) == 0 && line[length] == ':') {
+                    kb = strtol(line + length + 1, nullptr, 10);
+                    break;
+                }
+            }
+            fclose(status);
+            return kb;
+        }
+
+    } // namespace
+
+    OfflineRenderer::OfflineRenderer(AudioMixer &mixer, int framesPerBlock)
+            : m_Mixer(mixer),
+              m_FramesPerBlock(framesPerBlock) {
+    }
+
+    OfflineRenderer::~OfflineRenderer() {
+        closeWav();
+    }
+
+    bool OfflineRenderer::openWav(const std::string &path) {
+        closeWav();
+        m_Wav = fopen(path.c_str(), "wb");
+        if (!m_Wav) {
+            TRACE("OfflineRenderer: failed to open %s", path.c_str());
+            return false;
+        }
+        WavHeader header;
+        fwrite(&header, sizeof(header), 1, m_Wav);
+        m_WavFrames = 0;
+        return true;
+    }
+
+    void OfflineRenderer::closeWav() {
+        if (!m_Wav)
+            return;
+
+        WavHeader header;
+        header.sampleRate = static_cast<uint32_t>(m_Mixer.getSampleRate());
+        header.byteRate = header.sampleRate * header.blockAlign;
+        header.dataSize = static_cast<uint32_t>(m_WavFrames * header.blockAlign);
+        header.riffSize = header.dataSize + sizeof(header) - 8;
+        fseek(m_Wav, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, m_Wav);
+        fclose(m_Wav);
+        m_Wav = nullptr;
+    }
+
+    OfflineRenderer::Stats OfflineRenderer::render(double seconds) {
+        Stats stats;
+        int sampleRate = m_Mixer.getSampleRate();
+        auto totalFrames = static_cast<int64_t>(seconds * sampleRate);
+        auto blocks = static_cast<size_t>((totalFrames + m_FramesPerBlock - 1) / m_FramesPerBlock);
+
+        // Everything is allocated up front so that the loop itself only measures the mixer
+        std::vector<float> block(m_FramesPerBlock * 2);
+        std::vector<double> blockUs;
+        blockUs.reserve(blocks);
+        if (m_Memory)
+            m_Memory->reserve(m_Memory->size() + totalFrames * 2);
+
+        // Offline time runs from the moment rendering starts, at audio rate rather than wall
+        // clock rate, so poses posted by the block callback must be timestamped the same way.
+        int64_t startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t halfBlockNs = static_cast<int64_t>(m_FramesPerBlock) * 500000000LL / sampleRate;
+
+        auto wallStart = std::chrono::steady_clock::now();
+        int64_t frame = 0;
+        while (frame < totalFrames) {
+            int frames = static_cast<int>(std::min<int64_t>(m_FramesPerBlock, totalFrames - frame));
+            int64_t timeNs = startNs + frame * 1000000000LL / sampleRate;
+            if (m_BlockCallback)
+                m_BlockCallback(frame, timeNs);
+
+            long faults = threadFaults();
+            auto blockStart = std::chrono::steady_clock::now();
+            m_Mixer.render(block.data(), frames, timeNs + halfBlockNs);
+            auto blockEnd = std::chrono::steady_clock::now();
+            faults = threadFaults() - faults;
+
+            double us = std::chrono::duration<double, std::micro>(blockEnd - blockStart).count();
+            blockUs.push_back(us);
+            if (faults > 0) {
+                stats.faultedCallbacks++;
+                stats.pageFaults += faults;
+                stats.faultedMaxUs = std::max(stats.faultedMaxUs, us);
+            } else {
+                stats.unfaultedMaxUs = std::max(stats.unfaultedMaxUs, us);
+            }
+
+            if (m_Wav) {
+                fwrite(block.data(), sizeof(float) * 2, frames, m_Wav);
+                m_WavFrames += frames;
+            }
+            if (m_Memory)
+                m_Memory->insert(m_Memory->end(), block.begin(), block.begin() + frames * 2);
+            frame += frames;
+        }
+        auto wallEnd = std::chrono::steady_clock::now();
+
+        stats.frames = frame;
+        stats.callbacks = static_cast<int>(blockUs.size());
+        stats.audioSeconds = static_cast<double>(frame) / sampleRate;
+        stats.wallSeconds = std::chrono::duration<double>(wallEnd - wallStart).count();
+        stats.realTimeFactor = stats.audioSeconds > 0.0 ? stats.wallSeconds / stats.audioSeconds
+                                                        : 0.0;
+        std::sort(blockUs.begin(), blockUs.end());
+        stats.p50Us = percentile(blockUs, 0.50);
+        stats.p90Us = percentile(blockUs, 0.90);
+        stats.p99Us = percentile(blockUs, 0.99);
+        stats.maxUs = blockUs.empty() ? 0.0 : blockUs.back();
+        stats.budgetUs = 1e6 * m_FramesPerBlock / sampleRate;
+
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+            stats.peakRssKb = usage.ru_maxrss;     // kilobytes on Linux and Android
+        stats.rssAnonKb = readStatusKb("RssAnon");
+        stats.rssFileKb = readStatusKb("RssFile");
+
+        if (m_Wav)
+            fflush(m_Wav);
+        return stats;
+    }
+
+    void OfflineRenderer::printStats(const Stats &stats, FILE *out) {
+        fprintf(out, "Rendered %.2f s (%lld frames, %d callbacks) in %.3f s\n",
+                stats.audioSeconds, static_cast<long long>(stats.frames), stats.callbacks,
+                stats.wallSeconds);
+        fprintf(out, "Real-time factor %.4f (%.1fx faster than real time)\n",
+                stats.realTimeFactor,
+                stats.realTimeFactor > 0.0 ? 1.0 / stats.realTimeFactor : 0.0);
+        fprintf(out, "Per callback us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f  (budget %.0f)\n",
+                stats.p50Us, stats.p90Us, stats.p99Us, stats.maxUs, stats.budgetUs);
+        fprintf(out, "First touch: %d callbacks took %ld page faults, max %.1f us (%.1f without)\n",
+                stats.faultedCallbacks, stats.pageFaults, stats.faultedMaxUs, stats.unfaultedMaxUs);
+        fprintf(out, "Peak RSS %ld KiB, at end %ld KiB anonymous + %ld KiB file backed\n",
+                stats.peakRssKb, stats.rssAnonKb, stats.rssFileKb);
+    }
+
+} // soundscape
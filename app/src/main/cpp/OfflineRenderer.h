@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "AudioMixer.h"
+
+namespace soundscape {
+
+    // Drives AudioMixer::render from a plain loop instead of an Oboe stream, as fast as the CPU
+    // allows. The mix is exactly what the callback would produce, so this is used to measure
+    // throughput and to compare output between builds without a device.
+    class OfflineRenderer {
+    public:
+        struct Stats {
+            int64_t frames = 0;
+            int callbacks = 0;
+            double audioSeconds = 0.0;
+            double wallSeconds = 0.0;
+            // Wall clock time divided by audio time, so 0.1 is ten times faster than real time
+            double realTimeFactor = 0.0;
+            // Time spent in each render call
+            double p50Us = 0.0;
+            double p90Us = 0.0;
+            double p99Us = 0.0;
+            double maxUs = 0.0;
+            // Calls which took page faults, usually the first touch of a mapped asset's pages, and
+            // the slowest of them and of the rest. The times above include both.
+            int faultedCallbacks = 0;
+            long pageFaults = 0;
+            double faultedMaxUs = 0.0;
+            double unfaultedMaxUs = 0.0;
+            // Deadline for each callback at the render block size
+            double budgetUs = 0.0;
+            // Peak resident set size of the whole process
+            long peakRssKb = 0;
+            // Resident set once the render finishes: anonymous memory such as the heap, and file
+            // backed pages such as mapped assets, which the kernel can drop under pressure. 0 if
+            // /proc/self/status isn't readable.
+            long rssAnonKb = 0;
+            long rssFileKb = 0;
+        };
+
+        // The mixer must already have been started with startOffline(sampleRate, framesPerBlock)
+        OfflineRenderer(AudioMixer &mixer, int framesPerBlock);
+
+        ~OfflineRenderer();
+
+        // Called before each block is rendered with the number of frames rendered so far and the
+        // block's presentation time. Use it to move the listener or add and remove sources.
+        void setBlockCallback(std::function<void(int64_t frame, int64_t timeNs)> callback) {
+            m_BlockCallback = std::move(callback);
+        }
+
+        // Output destinations; either, both or neither can be used
+        bool openWav(const std::string &path);
+        void captureToMemory(std::vector<float> *interleaved) { m_Memory = interleaved; }
+
+        Stats render(double seconds);
+
+        static void printStats(const Stats &stats, FILE *out);
+
+    private:
+        void closeWav();
+
+        AudioMixer &m_Mixer;
+        int m_FramesPerBlock;
+        std::function<void(int64_t, int64_t)> m_BlockCallback;
+
+        FILE *m_Wav = nullptr;
+        int64_t m_WavFrames = 0;
+        std::vector<float> *m_Memory = nullptr;
+    };
+
+} // soundscape
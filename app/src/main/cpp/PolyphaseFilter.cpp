@@ -0,0 +1,136 @@
+#include "PolyphaseFilter.h"
+#include "MixKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+
+namespace soundscape {
+
+    namespace {
+        struct Design {
+            int taps;           // when upsampling
+            double beta;        // Kaiser window shape
+            double rolloff;     // cutoff as a fraction of the lower Nyquist frequency
+        };
+
+        Design designFor(ResampleQuality quality) {
+            switch (quality) {
+                case ResampleQuality::LOW:
+                    return {8, 5.0, 0.80};
+                case ResampleQuality::HIGH:
+                    return {48, 9.0, 0.95};
+                case ResampleQuality::MEDIUM:
+                default:
+                    return {24, 7.0, 0.91};
+            }
+        }
+
+        // Zeroth order modified Bessel function of the first kind
+        double besselI0(double x) {
+            double sum = 1.0;
+            double term = 1.0;
+            for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+                double half = x / (2.0 * k);
+                term *= half * half;
+                sum += term;
+            }
+            return sum;
+        }
+    } // namespace
+
+    std::shared_ptr<const PolyphaseFilter> PolyphaseFilter::get(int inRate, int outRate,
+                                                               ResampleQuality quality) {
+        static std::mutex s_Mutex;
+        static std::map<std::tuple<int, int, ResampleQuality>,
+                std::shared_ptr<const PolyphaseFilter>> s_Filters;
+
+        std::lock_guard<std::mutex> guard(s_Mutex);
+        auto &filter = s_Filters[{inRate, outRate, quality}];
+        if (!filter)
+            filter = std::make_shared<PolyphaseFilter>(inRate, outRate, quality);
+        return filter;
+    }
+
+    PolyphaseFilter::PolyphaseFilter(int inRate, int outRate, ResampleQuality quality) {
+        int divisor = std::gcd(inRate, outRate);
+        m_Phases = outRate / divisor;
+        m_Step = inRate / divisor;
+        if (m_Phases > MAX_PHASES) {
+            m_Step = static_cast<int>(std::lround(static_cast<double>(inRate) * MAX_PHASES /
+                                                  outRate));
+            m_Phases = MAX_PHASES;
+        }
+
+        Design design = designFor(quality);
+        double scale = std::min(1.0, static_cast<double>(outRate) / inRate);
+        int widen = static_cast<int>(std::ceil(1.0 / scale));
+        m_Taps = std::min(design.taps * widen, MAX_TAPS);
+
+        // Cutoff in cycles per input frame
+        double cutoff = 0.5 * scale * design.rolloff;
+        double half = m_Taps / 2.0;
+        double window0 = besselI0(design.beta);
+
+        m_Coefficients.resize(static_cast<size_t>(m_Taps) * m_Phases);
+        for (int phase = 0; phase < m_Phases; phase++) {
+            float *coefficients = &m_Coefficients[static_cast<size_t>(phase) * m_Taps];
+            double offset = static_cast<double>(phase) / m_Phases;
+            double sum = 0.0;
+            for (int tap = 0; tap < m_Taps; tap++) {
+                // Distance from the output's position to this tap's input
+                double distance = tap - leftTaps() - offset;
+                double x = 2.0 * cutoff * distance;
+                double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+                double r = distance / half;
+                double window = r * r < 1.0 ?
+                                besselI0(design.beta * std::sqrt(1.0 - r * r)) / window0 : 0.0;
+                double value = sinc * window;
+                coefficients[tap] = static_cast<float>(value);
+                sum += value;
+            }
+            // Unity gain at DC for every phase, so that there's no ripple at the phase rate
+            for (int tap = 0; tap < m_Taps; tap++)
+                coefficients[tap] = static_cast<float>(coefficients[tap] / sum);
+        }
+    }
+
+    void PolyphaseFilter::process(const float *in, int64_t inStart, int inFrames, float *out,
+                                  int64_t firstOut, int count) const {
+        // Outputs up to this one have all their taps within in
+        int64_t lastIndex = inStart + inFrames - m_Taps + leftTaps();
+        int64_t lastInside = lastIndex < 0 ? -1 : ((lastIndex + 1) * m_Phases - 1) / m_Step;
+
+        float padded[MAX_TAPS];
+        int done = 0;
+        while (done < count) {
+            int64_t outFrame = firstOut + done;
+            int64_t index;
+            int phase;
+            positionOf(outFrame, index, phase);
+            int64_t first = index - leftTaps() - inStart;
+
+            if (first >= 0 && outFrame <= lastInside) {
+                int frames = static_cast<int>(std::min<int64_t>(count - done,
+                                                                lastInside - outFrame + 1));
+                kernels::polyphaseFir(out + done, in + first, m_Coefficients.data(), m_Taps,
+                                      m_Phases, m_Step, phase, frames);
+                done += frames;
+                continue;
+            }
+
+            // At the ends, with silence beyond them
+            for (int tap = 0; tap < m_Taps; tap++) {
+                int64_t at = first + tap;
+                padded[tap] = at >= 0 && at < inFrames ? in[at] : 0.0f;
+            }
+            kernels::polyphaseFir(out + done, padded, m_Coefficients.data(), m_Taps, m_Phases,
+                                  m_Step, phase, 1);
+            done++;
+        }
+    }
+
+} // soundscape
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace soundscape {
+
+    enum class ResampleQuality {
+        LOW,        // 8 taps, for when CPU matters more than aliasing
+        MEDIUM,     // 24 taps, the default
+        HIGH        // 48 taps
+    };
+
+    // Windowed-sinc FIR for converting from one sample rate to another. The rates' ratio is
+    // reduced to L / M, and the filter is tabulated at the L phases an output sample can fall
+    // between two input samples, so each output is a single dot product against the inputs
+    // around it, with no interpolation between coefficients. Positions are kept as whole input
+    // frames plus phase in exact integers, so they never drift however long the input.
+    //
+    // The cutoff is just below the lower of the two Nyquist frequencies, and when downsampling
+    // the filter is widened in proportion so that it rejects as much as it does upsampling.
+    class PolyphaseFilter {
+    public:
+        // Filters are built once per rates and quality and then shared
+        static std::shared_ptr<const PolyphaseFilter> get(int inRate, int outRate,
+                                                          ResampleQuality quality);
+
+        PolyphaseFilter(int inRate, int outRate, ResampleQuality quality);
+
+        int taps() const { return m_Taps; }
+
+        // L: output positions per input frame
+        int phases() const { return m_Phases; }
+
+        // M: how far in phases each output moves on
+        int step() const { return m_Step; }
+
+        // taps() coefficients per phase, phase by phase
+        const float *coefficients() const { return m_Coefficients.data(); }
+
+        // Inputs before an output's position which its taps cover. The rest, taps() - this, are
+        // at or after it.
+        int leftTaps() const { return m_Taps / 2 - 1; }
+
+        // Output frame's position, in input frames and phases
+        void positionOf(int64_t outFrame, int64_t &inFrame, int &phase) const {
+            int64_t position = outFrame * m_Step;
+            inFrame = position / m_Phases;
+            phase = static_cast<int>(position % m_Phases);
+        }
+
+        // Compute count output frames from firstOut onwards. in holds input frames inStart to
+        // inStart + inFrames; those outside it are taken as silence. Doesn't allocate.
+        void process(const float *in, int64_t inStart, int inFrames, float *out,
+                     int64_t firstOut, int count) const;
+
+        // Most taps any filter has
+        static constexpr int MAX_TAPS = 256;
+
+    private:
+        // Ratios needing more phases than this are rounded to the nearest with this many, which
+        // shifts pitch very slightly
+        static constexpr int MAX_PHASES = 1024;
+
+        int m_Taps = 0;
+        int m_Phases = 1;
+        int m_Step = 1;
+        std::vector<float> m_Coefficients;      // m_Taps per phase
+    };
+
+} // soundscape
@@ -0,0 +1,140 @@
+#include "PolyphaseResampler.h"
+#include "MixKernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace soundscape {
+
+    PolyphaseResampler::PolyphaseResampler(ResampleQuality quality)
+            : m_Quality(quality),
+              m_Buffer(PolyphaseFilter::MAX_TAPS + BLOCK_FRAMES) {
+    }
+
+    void PolyphaseResampler::setRates(int sourceRate, int targetRate) {
+        if (sourceRate == m_SourceRate && targetRate == m_TargetRate)
+            return;
+
+        m_SourceRate = sourceRate;
+        m_TargetRate = targetRate;
+        if (sourceRate > 0 && targetRate > 0 && sourceRate != targetRate)
+            m_Filter = PolyphaseFilter::get(sourceRate, targetRate, m_Quality);
+        else
+            m_Filter.reset();
+        reset();
+    }
+
+    void PolyphaseResampler::reset() {
+        // The stream starts from silence, so that the first output lines up with the first input
+        m_Buffered = m_Filter ? m_Filter->leftTaps() : 0;
+        std::fill(m_Buffer.begin(), m_Buffer.begin() + m_Buffered, 0.0f);
+        m_Phase = 0;
+        m_Skip = 0;
+        m_Flushing = -1;
+    }
+
+    int PolyphaseResampler::inputFramesNeeded(int outputFrames) const {
+        if (!m_Filter)
+            return outputFrames;
+        if (outputFrames <= 0)
+            return 0;
+
+        // The last output's first tap, then all of its taps
+        const PolyphaseFilter &filter = *m_Filter;
+        int64_t lastFirst = (m_Phase + static_cast<int64_t>(outputFrames - 1) * filter.step()) /
+                            filter.phases();
+        int64_t needed = lastFirst + filter.taps() - m_Buffered;
+        return m_Skip + static_cast<int>(std::max<int64_t>(needed, 0));
+    }
+
+    int PolyphaseResampler::process(const float *input, int inputFrames,
+                                    float *output, int maxOutputFrames,
+                                    int &inputFramesConsumed) {
+        if (!m_Filter) {
+            int toCopy = std::min(inputFrames, maxOutputFrames);
+            memcpy(output, input, toCopy * sizeof(float));
+            inputFramesConsumed = toCopy;
+            return toCopy;
+        }
+
+        const PolyphaseFilter &filter = *m_Filter;
+        int taps = filter.taps();
+        int phases = filter.phases();
+        int step = filter.step();
+        int capacity = static_cast<int>(m_Buffer.size());
+
+        int consumed = 0;
+        int written = 0;
+        while (written < maxOutputFrames) {
+            int skip = std::min(m_Skip, inputFrames - consumed);
+            consumed += skip;
+            m_Skip -= skip;
+
+            // Top up with only as much input as the outputs still to write need
+            int wanted = m_Skip > 0 ? 0 : inputFramesNeeded(maxOutputFrames - written);
+            int take = std::min({inputFrames - consumed, wanted, capacity - m_Buffered});
+            memcpy(m_Buffer.data() + m_Buffered, input + consumed, take * sizeof(float));
+            consumed += take;
+            m_Buffered += take;
+
+            // Outputs whose taps are all buffered
+            int ready = 0;
+            if (m_Buffered >= taps) {
+                int64_t last = (static_cast<int64_t>(m_Buffered - taps + 1) * phases - 1 -
+                                m_Phase) / step;
+                ready = static_cast<int>(std::min<int64_t>(last + 1, maxOutputFrames - written));
+            }
+            if (ready <= 0) {
+                if (take == 0)
+                    break;
+                continue;
+            }
+
+            kernels::polyphaseFir(output + written, m_Buffer.data(), filter.coefficients(), taps,
+                                  phases, step, m_Phase, ready);
+            written += ready;
+
+            // Drop the inputs before the next output's first tap
+            int64_t position = m_Phase + static_cast<int64_t>(ready) * step;
+            auto advance = static_cast<int>(position / phases);
+            m_Phase = static_cast<int>(position % phases);
+            if (advance >= m_Buffered) {
+                m_Skip += advance - m_Buffered;
+                m_Buffered = 0;
+            } else {
+                m_Buffered -= advance;
+                memmove(m_Buffer.data(), m_Buffer.data() + advance, m_Buffered * sizeof(float));
+            }
+        }
+
+        inputFramesConsumed = consumed;
+        return written;
+    }
+
+    int PolyphaseResampler::flush(float *output, int maxOutputFrames) {
+        if (!m_Filter)
+            return 0;
+
+        const PolyphaseFilter &filter = *m_Filter;
+        if (m_Flushing < 0) {
+            // The outputs positioned before the end of the input, the next one being leftTaps
+            // and a phase into the buffer
+            int64_t span = static_cast<int64_t>(m_Buffered - filter.leftTaps()) *
+                           filter.phases() - m_Phase;
+            m_Flushing = (m_Skip > 0 || span <= 0)
+                         ? 0 : static_cast<int>((span + filter.step() - 1) / filter.step());
+        }
+
+        static const float silence[BLOCK_FRAMES] = {};
+        int written = 0;
+        int toWrite = std::min(m_Flushing, maxOutputFrames);
+        while (written < toWrite) {
+            int needed = std::min(inputFramesNeeded(toWrite - written), BLOCK_FRAMES);
+            int consumed = 0;
+            written += process(silence, needed, output + written, toWrite - written, consumed);
+        }
+        m_Flushing -= written;
+        return written;
+    }
+
+} // soundscape
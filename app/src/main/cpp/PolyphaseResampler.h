@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "PolyphaseFilter.h"
+
+namespace soundscape {
+
+    // Streaming resampler for audio which arrives a block at a time, such as text to speech.
+    // It filters with a PolyphaseFilter and keeps the inputs the filter still needs from one
+    // call to the next, so block boundaries are seamless. The position is a whole number of
+    // inputs plus an integer phase, so it's exact however long the stream.
+    //
+    // Output is aligned with input, so each output waits for the inputs on both sides of it:
+    // about half the filter's taps of look ahead, under a millisecond.
+    class PolyphaseResampler {
+    public:
+        explicit PolyphaseResampler(ResampleQuality quality = ResampleQuality::MEDIUM);
+
+        // Does nothing if the rates haven't changed, otherwise resets. The first time a pair of
+        // rates is used anywhere the filter has to be built, which isn't real-time safe.
+        void setRates(int sourceRate, int targetRate);
+
+        void reset();
+
+        // Resample from input to output, returning the frames written. inputFramesConsumed is
+        // set to how many input frames were used; the caller keeps the rest for the next call.
+        // Input is only taken as far as the outputs asked for need it. Doesn't allocate.
+        int process(const float *input, int inputFrames,
+                    float *output, int maxOutputFrames,
+                    int &inputFramesConsumed);
+
+        // At the end of the stream, pad it with silence and write the outputs still held back by
+        // the look ahead, returning the frames written. Call until it returns 0, then reset
+        // before the next stream. Doesn't allocate.
+        int flush(float *output, int maxOutputFrames);
+
+        // Exactly how many input frames the next process call needs to produce outputFrames
+        int inputFramesNeeded(int outputFrames) const;
+
+        bool needsResampling() const { return m_Filter != nullptr; }
+
+    private:
+        // Input frames buffered beyond the filter's taps
+        static constexpr int BLOCK_FRAMES = 1024;
+
+        ResampleQuality m_Quality;
+        int m_SourceRate = 0;
+        int m_TargetRate = 0;
+        std::shared_ptr<const PolyphaseFilter> m_Filter;    // null when the rates are the same
+
+        // Inputs from the first tap of the next output on
+        std::vector<float> m_Buffer;
+        int m_Buffered = 0;
+        int m_Phase = 0;
+        int m_Skip = 0;     // inputs still to come which the next output is already past
+        int m_Flushing = -1;    // outputs flush still has to write, or -1 before it's called
+    };
+
+} // soundscape
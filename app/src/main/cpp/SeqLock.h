@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace soundscape {
+
+    // Sequence lock for publishing a small value from one writer thread to any number of readers.
+    // Readers never block the writer and the writer never blocks readers; a reader that races
+    // with a write just retries. The value is held as relaxed atomic words so that concurrent
+    // access is well defined.
+    template<typename T>
+    class SeqLock {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "SeqLock can only hold trivially copyable types");
+
+    public:
+        explicit SeqLock(const T &initial = T()) { store(initial); }
+
+        // Single writer only
+        void store(const T &value) {
+            uint64_t words[WORDS] = {};
+            memcpy(words, &value, sizeof(T));
+
+            uint32_t seq = m_Sequence.load(std::memory_order_relaxed);
+            m_Sequence.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < WORDS; i++)
+                m_Words[i].store(words[i], std::memory_order_relaxed);
+            m_Sequence.store(seq + 2, std::memory_order_release);
+        }
+
+        // Safe from any thread, including the audio thread. Only spins whilst a write is in
+        // progress, which is a handful of stores.
+        T load() const {
+            uint64_t words[WORDS];
+            uint32_t before, after;
+            do {
+                before = m_Sequence.load(std::memory_order_acquire);
+                for (size_t i = 0; i < WORDS; i++)
+                    words[i] = m_Words[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = m_Sequence.load(std::memory_order_relaxed);
+            } while ((before & 1) || before != after);
+
+            T value;
+            memcpy(&value, words, sizeof(T));
+            return value;
+        }
+
+    private:
+        static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint32_t> m_Sequence{0};
+        std::atomic<uint64_t> m_Words[WORDS];
+    };
+
+} // soundscape
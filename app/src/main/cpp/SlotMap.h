@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace soundscape {
+
+    // Refers to a value in a SlotMap: a slot index plus the generation the slot had when the
+    // value was inserted
+    struct SlotHandle {
+        uint32_t index = 0;
+        uint32_t generation = 0;    // odd whilst live, 0 for no value
+
+        bool isValid() const { return generation != 0; }
+
+        bool operator==(const SlotHandle &other) const {
+            return index == other.index && generation == other.generation;
+        }
+    };
+
+    // Fixed capacity, densely stored map from small handles to values. A handle is a slot index
+    // plus the generation the slot had when the value was inserted, so looking one up is an index
+    // and a compare, and a handle whose value has since been erased is detected rather than
+    // resolving to whatever now occupies the slot.
+    //
+    // insert() and erase() must only be called from one thread at a time. get() can be called
+    // from any thread, including the audio thread, without locking: a slot's generation is
+    // published with release ordering after its value is written. A reader must still be done
+    // with a value before the writer erases it and reuses the slot, which the mixer ensures by
+    // only erasing effects once the audio thread has retired them.
+    template<typename T, int Capacity>
+    class SlotMap {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "SlotMap values must be trivially copyable");
+
+    public:
+        using Handle = SlotHandle;
+
+        SlotMap() {
+            for (int i = 0; i < Capacity; i++)
+                m_Free[i] = Capacity - 1 - i;
+            m_FreeCount = Capacity;
+        }
+
+        // Writer only. Returns an invalid handle if the map is full.
+        Handle insert(const T &value) {
+            if (m_FreeCount == 0)
+                return {};
+
+            uint32_t index = m_Free[--m_FreeCount];
+            Slot &slot = m_Slots[index];
+            slot.value = value;
+            uint32_t generation = slot.generation.load(std::memory_order_relaxed) + 1;
+            slot.generation.store(generation, std::memory_order_release);
+            return {index, generation};
+        }
+
+        // Writer only. Returns false, leaving removed untouched, if the handle is stale.
+        bool erase(Handle handle, T *removed = nullptr) {
+            if (!contains(handle))
+                return false;
+
+            Slot &slot = m_Slots[handle.index];
+            if (removed)
+                *removed = slot.value;
+            slot.generation.store(handle.generation + 1, std::memory_order_release);
+            m_Free[m_FreeCount++] = handle.index;
+            return true;
+        }
+
+        // Any thread. nullptr for stale or invalid handles.
+        const T *get(Handle handle) const {
+            if (!contains(handle))
+                return nullptr;
+            return &m_Slots[handle.index].value;
+        }
+
+        bool contains(Handle handle) const {
+            return handle.isValid() && handle.index < static_cast<uint32_t>(Capacity) &&
+                   m_Slots[handle.index].generation.load(std::memory_order_acquire) ==
+                   handle.generation;
+        }
+
+        int size() const { return Capacity - m_FreeCount; }
+
+        // Writer only. Calls f(value) for every live value.
+        template<typename F>
+        void forEach(F f) {
+            for (auto &slot: m_Slots) {
+                if (slot.generation.load(std::memory_order_relaxed) & 1)
+                    f(slot.value);
+            }
+        }
+
+    private:
+        struct Slot {
+            T value{};
+            std::atomic<uint32_t> generation{0};
+        };
+
+        Slot m_Slots[Capacity];
+        uint32_t m_Free[Capacity];
+        int m_FreeCount = 0;
+    };
+
+} // soundscape
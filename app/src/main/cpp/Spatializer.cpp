@@ -0,0 +1,18 @@
+#include "Spatializer.h"
+#include "ConvolutionSpatializer.h"
+#include "SteamAudioSpatializer.h"
+
+namespace soundscape {
+
+    std::unique_ptr<Spatializer> createSpatializer(SpatializerType type, int sampleRate,
+                                                   int frameSize) {
+        switch (type) {
+            case SpatializerType::STEAM_AUDIO:
+                return std::make_unique<SteamAudioSpatializer>(sampleRate, frameSize);
+            case SpatializerType::CONVOLUTION:
+                return std::make_unique<ConvolutionSpatializer>(sampleRate, frameSize);
+        }
+        return nullptr;
+    }
+
+} // soundscape
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "SlotMap.h"
+#include <cstdint>
+#include <memory>
+
+namespace soundscape {
+
+    // HRTF renderer used by AudioMixer. Sources are given an effect handle when they're added,
+    // and the audio thread then renders them one block at a time, either each through its own
+    // binaural effect or all through a shared ambisonics bus with a single binaural decode.
+    //
+    // Effect creation and removal, and the pool calls, aren't thread safe: the caller serialises
+    // them. The rendering calls are audio thread only and only ever touch effects through their
+    // handles, so they can run whilst effects are created and removed elsewhere.
+    class Spatializer {
+    public:
+        // Highest ambisonics order supported by the shared ambisonics bus
+        static constexpr int MAX_AMBISONICS_ORDER = 2;
+
+        // Most effects handed out at once
+        static constexpr int MAX_EFFECTS = 128;
+
+        // Identifies a source's effects. The audio thread resolves it in O(1) without locking,
+        // and one whose effects have been removed resolves to nothing.
+        using EffectHandle = SlotHandle;
+
+        struct PoolStats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            int idle = 0;
+            int inUse = 0;
+        };
+
+        virtual ~Spatializer() = default;
+
+        virtual const char *getName() const = 0;
+
+        virtual bool isInitialized() const = 0;
+
+        virtual int getFrameSize() const = 0;
+
+        // Get a per-source effect, including whatever is needed in ambisonics mode, so that the
+        // mode can be switched without creating effects on the audio thread. Effects come from a
+        // pool of idle ones when possible and are only created on a miss. Returns an invalid
+        // handle on failure. Not real-time safe.
+        virtual EffectHandle createSourceEffect() = 0;
+
+        // Reset a per-source effect and return it to the pool, or destroy it if the pool is
+        // full. Not real-time safe - call once the audio thread has stopped using it.
+        virtual void removeSourceEffect(EffectHandle handle) = 0;
+
+        // Effect pool. The pool is filled to its target size up front, and a miss raises the
+        // target so that growPool, called from a background thread, can top it up before the
+        // next burst of sources.
+        virtual void reservePool(int effects) = 0;
+
+        virtual bool poolNeedsGrowth() const = 0;
+
+        // Create one idle effect, returns false if that failed
+        virtual bool growPool() = 0;
+
+        virtual PoolStats getPoolStats() const = 0;
+
+        // Spatialize mono input into separate left and right outputs, overwriting them, or with
+        // silence if the handle is stale.
+        // azimuth: 0 = ahead, positive = right (radians)
+        // elevation: 0 = level, positive = up (radians)
+        virtual void spatialize(EffectHandle handle, const float *monoIn, float *leftOut,
+                                float *rightOut, int frames, float azimuth,
+                                float elevation) = 0;
+
+        // Ambisonics rendering: each source is encoded into a shared bus which is decoded once
+        // per block, so the HRTF cost doesn't grow with the number of sources. order is 1 or 2
+        // and must be the same for every call within a block.
+        virtual void beginAmbisonicsBlock(int order) = 0;
+
+        virtual void encodeToAmbisonics(EffectHandle handle, const float *monoIn, int frames,
+                                        float azimuth, float elevation, float gain) = 0;
+
+        // Decode the bus and add it to separate left and right outputs. Does nothing if no
+        // source was encoded since beginAmbisonicsBlock.
+        virtual void decodeAmbisonics(float *leftOut, float *rightOut, int frames) = 0;
+    };
+
+    enum class SpatializerType {
+        STEAM_AUDIO,    // libphonon
+        CONVOLUTION     // ConvolutionSpatializer, built in
+    };
+
+    // nullptr for an unknown type. The result still has to be checked with isInitialized().
+    std::unique_ptr<Spatializer> createSpatializer(SpatializerType type, int sampleRate,
+                                                   int frameSize);
+
+} // soundscape
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace soundscape {
+
+    // Bounded, wait-free single-producer/single-consumer ring buffer. push() must only ever be
+    // called from one thread and pop() from one (other) thread. Neither call blocks or allocates,
+    // so either end can be the real-time audio thread.
+    template<typename T, size_t Capacity>
+    class SpscQueue {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                      "SpscQueue capacity must be a power of two");
+
+    public:
+        // Returns false if the queue is full
+        bool push(const T &item) {
+            size_t tail = m_Tail.load(std::memory_order_relaxed);
+            if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+                return false;
+
+            m_Items[tail & (Capacity - 1)] = item;
+            m_Tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Returns false if the queue is empty
+        bool pop(T &item) {
+            size_t head = m_Head.load(std::memory_order_relaxed);
+            if (head == m_Tail.load(std::memory_order_acquire))
+                return false;
+
+            item = m_Items[head & (Capacity - 1)];
+            m_Head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const {
+            return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        // Keep the two indices on separate cache lines so that producer and consumer don't
+        // invalidate each other's line on every operation.
+        alignas(64) std::atomic<size_t> m_Head{0};
+        alignas(64) std::atomic<size_t> m_Tail{0};
+        alignas(64) T m_Items[Capacity];
+    };
+
+    // As SpscQueue, but for streams of samples: write() and read() copy as many items as there
+    // are room for or are available in one go. The buffer is allocated when the ring is
+    // constructed, with the capacity rounded up to a power of two, and never again.
+    template<typename T>
+    class SpscRing {
+    public:
+        explicit SpscRing(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+            m_Items.resize(size);
+            m_Mask = size - 1;
+        }
+
+        // Producer only. Returns how many of count were written.
+        size_t write(const T *items, size_t count) {
+            size_t tail = m_Tail.load(std::memory_order_relaxed);
+            size_t head = m_Head.load(std::memory_order_acquire);
+            count = std::min(count, capacity() - (tail - head));
+
+            size_t start = tail & m_Mask;
+            size_t first = std::min(count, capacity() - start);
+            std::copy_n(items, first, m_Items.data() + start);
+            std::copy_n(items + first, count - first, m_Items.data());
+            m_Tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        // Consumer only. Returns how many items were read, up to count.
+        size_t read(T *items, size_t count) {
+            size_t head = m_Head.load(std::memory_order_relaxed);
+            size_t tail = m_Tail.load(std::memory_order_acquire);
+            count = std::min(count, tail - head);
+
+            size_t start = head & m_Mask;
+            size_t first = std::min(count, capacity() - start);
+            std::copy_n(m_Items.data() + start, first, items);
+            std::copy_n(m_Items.data(), count - first, items + first);
+            m_Head.store(head + count, std::memory_order_release);
+            return count;
+        }
+
+        // Items waiting to be read
+        size_t available() const {
+            return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire);
+        }
+
+        // Room left for writing
+        size_t space() const { return capacity() - available(); }
+
+        size_t capacity() const { return m_Mask + 1; }
+
+    private:
+        alignas(64) std::atomic<size_t> m_Head{0};
+        alignas(64) std::atomic<size_t> m_Tail{0};
+        std::vector<T> m_Items;
+        size_t m_Mask = 0;
+    };
+
+} // soundscape
@@ -1,8 +1,9 @@
 #include "SteamAudioSpatializer.h"
+#include "MixKernels.h"
 #include "Trace.h"
+#include <algorithm>
 #include <cstring>
 #include <cmath>
-#include <vector>
 
 namespace soundscape {
 
@@ -33,17 +34,33 @@ namespace soundscape {
             return;
         }
 
+        // Create the decoder for the shared ambisonics bus. Failure isn't fatal, it just leaves
+        // ambisonics mode unavailable.
+        IPLAmbisonicsBinauralEffectSettings decoderSettings{};
+        decoderSettings.hrtf = m_Hrtf;
+        decoderSettings.maxOrder = MAX_AMBISONICS_ORDER;
+        err = iplAmbisonicsBinauralEffectCreate(m_Context, &m_AudioSettings, &decoderSettings,
+                                                &m_AmbisonicsDecoder);
+        if (err != IPL_STATUS_SUCCESS) {
+            TRACE("SteamAudio: iplAmbisonicsBinauralEffectCreate failed: %d", err);
+            m_AmbisonicsDecoder = nullptr;
+        } else {
+            int maxChannels = (MAX_AMBISONICS_ORDER + 1) * (MAX_AMBISONICS_ORDER + 1);
+            m_AmbisonicsBus.resize(maxChannels * frameSize);
+            m_AmbisonicsScratch.resize(maxChannels * frameSize);
+            m_DecodeBuf.resize(2 * frameSize);
+        }
+
         TRACE("SteamAudio: initialized (rate=%d, frameSize=%d)", sampleRate, frameSize);
     }
 
     SteamAudioSpatializer::~SteamAudioSpatializer() {
         // Destroy all remaining effects
-        for (auto &pair: m_Effects) {
-            if (pair.second.effect) {
-                iplBinauralEffectRelease(&pair.second.effect);
-            }
+        m_Effects.clear(releaseEffect);
+
+        if (m_AmbisonicsDecoder) {
+            iplAmbisonicsBinauralEffectRelease(&m_AmbisonicsDecoder);
         }
-        m_Effects.clear();
 
         if (m_Hrtf) {
             iplHRTFRelease(&m_Hrtf);
@@ -54,8 +71,16 @@ namespace soundscape {
         TRACE("SteamAudio: destroyed");
     }
 
-    int SteamAudioSpatializer::createSourceEffect() {
-        if (!m_Context || !m_Hrtf) return -1;
+    SteamAudioSpatializer::EffectHandle SteamAudioSpatializer::createSourceEffect() {
+        EffectHandle handle = m_Effects.acquire(
+                [this](SourceEffect &effect) { return newEffect(effect); });
+        if (!handle.isValid())
+            TRACE("SteamAudio: no effect available (%d in use)", m_Effects.stats().inUse);
+        return handle;
+    }
+
+    bool SteamAudioSpatializer::newEffect(SourceEffect &sourceEffect) {
+        if (!m_Context || !m_Hrtf) return false;
 
         IPLBinauralEffectSettings effectSettings{};
         effectSettings.hrtf = m_Hrtf;
@@ -64,39 +89,75 @@ namespace soundscape {
         auto err = iplBinauralEffectCreate(m_Context, &m_AudioSettings, &effectSettings, &effect);
         if (err != IPL_STATUS_SUCCESS) {
             TRACE("SteamAudio: iplBinauralEffectCreate failed: %d", err);
-            return -1;
+            return false;
         }
 
-        int id = m_NextId++;
-        m_Effects[id] = {effect};
-        return id;
-    }
-
-    void SteamAudioSpatializer::removeSourceEffect(int id) {
-        auto it = m_Effects.find(id);
-        if (it != m_Effects.end()) {
-            if (it->second.effect) {
-                iplBinauralEffectRelease(&it->second.effect);
+        // The encoder is optional: without it the source simply isn't heard in ambisonics mode
+        IPLAmbisonicsEncodeEffect encoder = nullptr;
+        if (m_AmbisonicsDecoder) {
+            IPLAmbisonicsEncodeEffectSettings encoderSettings{};
+            encoderSettings.maxOrder = MAX_AMBISONICS_ORDER;
+            err = iplAmbisonicsEncodeEffectCreate(m_Context, &m_AudioSettings, &encoderSettings,
+                                                  &encoder);
+            if (err != IPL_STATUS_SUCCESS) {
+                TRACE("SteamAudio: iplAmbisonicsEncodeEffectCreate failed: %d", err);
+                encoder = nullptr;
             }
-            m_Effects.erase(it);
         }
+
+        sourceEffect = SourceEffect{effect, encoder};
+        return true;
     }
 
-    void SteamAudioSpatializer::spatialize(int effectId, const float *monoIn, float *stereoOut,
-                                           int frames, float azimuth, float elevation) {
-        auto it = m_Effects.find(effectId);
-        if (it == m_Effects.end() || !it->second.effect) {
-            // No effect - output silence
-            memset(stereoOut, 0, frames * 2 * sizeof(float));
-            return;
-        }
+    void SteamAudioSpatializer::resetEffect(SourceEffect &effect) {
+        // Clear the HRTF history and delay lines so that the next source starts from silence
+        iplBinauralEffectReset(effect.effect);
+        if (effect.encoder)
+            iplAmbisonicsEncodeEffectReset(effect.encoder);
+    }
+
+    void SteamAudioSpatializer::releaseEffect(SourceEffect &effect) {
+        if (effect.effect)
+            iplBinauralEffectRelease(&effect.effect);
+        if (effect.encoder)
+            iplAmbisonicsEncodeEffectRelease(&effect.encoder);
+    }
+
+    void SteamAudioSpatializer::removeSourceEffect(EffectHandle handle) {
+        m_Effects.release(handle, resetEffect, releaseEffect);
+    }
 
+    void SteamAudioSpatializer::reservePool(int effects) {
+        m_Effects.reserve(effects, [this](SourceEffect &effect) { return newEffect(effect); });
+    }
+
+    bool SteamAudioSpatializer::growPool() {
+        return m_Effects.grow([this](SourceEffect &effect) { return newEffect(effect); });
+    }
+
+    IPLVector3 SteamAudioSpatializer::directionFromAngles(float azimuth, float elevation) {
         // Steam Audio uses right-handed: +x=right, +y=up, -z=forward
         // direction = unit vector from listener toward source
         IPLVector3 direction;
         direction.x = sinf(azimuth) * cosf(elevation);
         direction.y = sinf(elevation);
         direction.z = -cosf(azimuth) * cosf(elevation);
+        return direction;
+    }
+
+    void SteamAudioSpatializer::spatialize(EffectHandle handle, const float *monoIn,
+                                           float *leftOut, float *rightOut, int frames,
+                                           float azimuth, float elevation) {
+        const SourceEffect *sourceEffect = m_Effects.get(handle);
+        IPLBinauralEffect effect = sourceEffect ? sourceEffect->effect : nullptr;
+        if (!effect) {
+            // No effect - output silence
+            memset(leftOut, 0, frames * sizeof(float));
+            memset(rightOut, 0, frames * sizeof(float));
+            return;
+        }
+
+        IPLVector3 direction = directionFromAngles(azimuth, elevation);
 
         // Set up deinterleaved input buffer (mono)
         float *inChannels[1] = {const_cast<float *>(monoIn)};
@@ -105,11 +166,8 @@ namespace soundscape {
         inBuffer.numSamples = frames;
         inBuffer.data = inChannels;
 
-        // Set up deinterleaved output buffer (stereo)
-        // We need separate L/R buffers then interleave
-        std::vector<float> leftBuf(frames);
-        std::vector<float> rightBuf(frames);
-        float *outChannels[2] = {leftBuf.data(), rightBuf.data()};
+        // Steam Audio works deinterleaved, so it writes straight into the caller's channels
+        float *outChannels[2] = {leftOut, rightOut};
         IPLAudioBuffer outBuffer{};
         outBuffer.numChannels = 2;
         outBuffer.numSamples = frames;
@@ -123,13 +181,81 @@ namespace soundscape {
         params.hrtf = m_Hrtf;
         params.peakDelays = nullptr;
 
-        iplBinauralEffectApply(it->second.effect, &params, &inBuffer, &outBuffer);
+        iplBinauralEffectApply(effect, &params, &inBuffer, &outBuffer);
+    }
+
+    void SteamAudioSpatializer::beginAmbisonicsBlock(int order) {
+        m_AmbisonicsOrder = std::clamp(order, 1, MAX_AMBISONICS_ORDER);
+        m_AmbisonicsBusActive = false;
+    }
+
+    void SteamAudioSpatializer::encodeToAmbisonics(EffectHandle handle,
+                                                   const float *monoIn, int frames,
+                                                   float azimuth, float elevation, float gain) {
+        const SourceEffect *sourceEffect = m_Effects.get(handle);
+        IPLAmbisonicsEncodeEffect encoder = sourceEffect ? sourceEffect->encoder : nullptr;
+        if (!encoder || !m_AmbisonicsDecoder || frames > m_AudioSettings.frameSize)
+            return;
+
+        const int frameSize = m_AudioSettings.frameSize;
+        const int channels = (m_AmbisonicsOrder + 1) * (m_AmbisonicsOrder + 1);
 
-        // Interleave to output
-        for (int i = 0; i < frames; i++) {
-            stereoOut[i * 2] = leftBuf[i];
-            stereoOut[i * 2 + 1] = rightBuf[i];
+        float *inChannels[1] = {const_cast<float *>(monoIn)};
+        IPLAudioBuffer inBuffer{1, frames, inChannels};
+
+        float *outChannels[(MAX_AMBISONICS_ORDER + 1) * (MAX_AMBISONICS_ORDER + 1)];
+        for (int ch = 0; ch < channels; ch++)
+            outChannels[ch] = m_AmbisonicsScratch.data() + ch * frameSize;
+        IPLAudioBuffer outBuffer{channels, frames, outChannels};
+
+        IPLAmbisonicsEncodeEffectParams params{};
+        params.direction = directionFromAngles(azimuth, elevation);
+        params.order = m_AmbisonicsOrder;
+        iplAmbisonicsEncodeEffectApply(encoder, &params, &inBuffer, &outBuffer);
+
+        // The first source overwrites the bus, later ones accumulate into it
+        for (int ch = 0; ch < channels; ch++) {
+            float *bus = m_AmbisonicsBus.data() + ch * frameSize;
+            if (!m_AmbisonicsBusActive)
+                memset(bus, 0, frames * sizeof(float));
+            kernels::accumulateWithGain(bus, outChannels[ch], gain, frames);
+        }
+        m_AmbisonicsBusActive = true;
+    }
+
+    void SteamAudioSpatializer::decodeAmbisonics(float *leftOut, float *rightOut, int frames) {
+        const int frameSize = m_AudioSettings.frameSize;
+        const int channels = (m_AmbisonicsOrder + 1) * (m_AmbisonicsOrder + 1);
+        if (!m_AmbisonicsBusActive) {
+            if (!m_AmbisonicsTail)
+                return;
+            // Nothing was encoded this block, but the decoder's filters still ring with earlier
+            // ones. Decode silence to play that out, rather than cutting it off here and having
+            // the stale history replayed when a source next encodes.
+            for (int ch = 0; ch < channels; ch++)
+                memset(m_AmbisonicsBus.data() + ch * frameSize, 0, frames * sizeof(float));
         }
+
+        float *inChannels[(MAX_AMBISONICS_ORDER + 1) * (MAX_AMBISONICS_ORDER + 1)];
+        for (int ch = 0; ch < channels; ch++)
+            inChannels[ch] = m_AmbisonicsBus.data() + ch * frameSize;
+        IPLAudioBuffer inBuffer{channels, frames, inChannels};
+
+        float *left = m_DecodeBuf.data();
+        float *right = m_DecodeBuf.data() + frameSize;
+        float *outChannels[2] = {left, right};
+        IPLAudioBuffer outBuffer{2, frames, outChannels};
+
+        IPLAmbisonicsBinauralEffectParams params{};
+        params.hrtf = m_Hrtf;
+        params.order = m_AmbisonicsOrder;
+        auto state = iplAmbisonicsBinauralEffectApply(m_AmbisonicsDecoder, &params, &inBuffer,
+                                                      &outBuffer);
+        m_AmbisonicsTail = (state == IPL_AUDIOEFFECTSTATE_TAILREMAINING);
+
+        kernels::accumulateWithGain(leftOut, left, 1.0f, frames);
+        kernels::accumulateWithGain(rightOut, right, 1.0f, frames);
+        m_AmbisonicsBusActive = false;
     }
 
 } // soundscape
@@ -1,32 +1,46 @@
 #pragma once
 
 #include "phonon.h"
-#include <unordered_map>
-#include <mutex>
+#include "EffectPool.h"
+#include "Spatializer.h"
+#include <vector>
 
 namespace soundscape {
 
-    class SteamAudioSpatializer {
+    // Spatializer on top of Steam Audio's binaural and ambisonics effects
+    class SteamAudioSpatializer : public Spatializer {
     public:
         SteamAudioSpatializer(int sampleRate, int frameSize);
 
-        ~SteamAudioSpatializer();
+        ~SteamAudioSpatializer() override;
 
-        bool isInitialized() const { return m_Context != nullptr; }
+        const char *getName() const override { return "Steam Audio"; }
 
-        int getFrameSize() const { return m_AudioSettings.frameSize; }
+        bool isInitialized() const override { return m_Context != nullptr; }
 
-        // Create a per-source binaural effect, returns an ID
-        int createSourceEffect();
+        int getFrameSize() const override { return m_AudioSettings.frameSize; }
 
-        // Destroy a per-source effect
-        void removeSourceEffect(int id);
+        EffectHandle createSourceEffect() override;
 
-        // Spatialize mono input to interleaved stereo output.
-        // azimuth: 0 = ahead, positive = right (radians)
-        // elevation: 0 = level, positive = up (radians)
-        void spatialize(int effectId, const float *monoIn, float *stereoOut,
-                        int frames, float azimuth, float elevation);
+        void removeSourceEffect(EffectHandle handle) override;
+
+        void reservePool(int effects) override;
+
+        bool poolNeedsGrowth() const override { return m_Effects.needsGrowth(); }
+
+        bool growPool() override;
+
+        PoolStats getPoolStats() const override { return m_Effects.stats(); }
+
+        void spatialize(EffectHandle handle, const float *monoIn, float *leftOut,
+                        float *rightOut, int frames, float azimuth, float elevation) override;
+
+        void beginAmbisonicsBlock(int order) override;
+
+        void encodeToAmbisonics(EffectHandle handle, const float *monoIn,
+                                int frames, float azimuth, float elevation, float gain) override;
+
+        void decodeAmbisonics(float *leftOut, float *rightOut, int frames) override;
 
         // Get the IPLContext (for iplAudioBufferInterleave etc.)
         IPLContext getContext() const { return m_Context; }
@@ -36,11 +50,32 @@ namespace soundscape {
         IPLHRTF m_Hrtf = nullptr;
         IPLAudioSettings m_AudioSettings{};
 
+        // A binaural effect along with the ambisonics encoder used instead of it in ambisonics
+        // mode, which is optional: without it the source simply isn't heard in that mode
         struct SourceEffect {
             IPLBinauralEffect effect = nullptr;
+            IPLAmbisonicsEncodeEffect encoder = nullptr;
         };
-        std::unordered_map<int, SourceEffect> m_Effects;
-        int m_NextId = 0;
+
+        EffectPool<SourceEffect, MAX_EFFECTS> m_Effects;
+
+        bool newEffect(SourceEffect &effect);
+
+        static void resetEffect(SourceEffect &effect);
+
+        static void releaseEffect(SourceEffect &effect);
+
+        static IPLVector3 directionFromAngles(float azimuth, float elevation);
+
+        // Shared ambisonics bus and its binaural decoder
+        IPLAmbisonicsBinauralEffect m_AmbisonicsDecoder = nullptr;
+        int m_AmbisonicsOrder = 1;
+        bool m_AmbisonicsBusActive = false;
+        bool m_AmbisonicsTail = false;             // the decoder still has output to play
+        std::vector<float> m_AmbisonicsBus;        // channel-major, frameSize samples per channel
+        std::vector<float> m_AmbisonicsScratch;    // one source's encoded output
+        std::vector<float> m_DecodeBuf;            // decoded left then right
+
     };
 
 } // soundscape
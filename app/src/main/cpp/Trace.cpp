@@ -0,0 +1,40 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+namespace soundscape {
+
+    namespace {
+        std::atomic<Logger *> s_Logger{nullptr};
+    }
+
+    void setLogger(Logger *logger) {
+        s_Logger.store(logger);
+    }
+
+    void trace(const char *format, ...) {
+        char message[512];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+
+        Logger *logger = s_Logger.load();
+        if (logger) {
+            logger->log(message);
+            return;
+        }
+#ifdef __ANDROID__
+        __android_log_write(ANDROID_LOG_DEBUG, "AudioEngine", message);
+#else
+        fprintf(stderr, "AudioEngine: %s\n", message);
+#endif
+    }
+
+} // soundscape
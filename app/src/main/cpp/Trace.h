@@ -1,8 +1,24 @@
 #pragma once
 
-#include <android/log.h>
-
 #define MAYBE_UNUSED __attribute__((unused))
 
-#define TRACE(args...) \
-__android_log_print(android_LogPriority::ANDROID_LOG_DEBUG, "AudioEngine", args)
+namespace soundscape {
+
+    // Destination for TRACE output. Without one, messages go to logcat on Android and to stderr
+    // elsewhere.
+    class Logger {
+    public:
+        virtual ~Logger() = default;
+
+        virtual void log(const char *message) = 0;
+    };
+
+    // Pass nullptr to go back to the default. The logger must outlive any TRACE calls made
+    // whilst it's set.
+    void setLogger(Logger *logger);
+
+    void trace(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+} // soundscape
+
+#define TRACE(args...) soundscape::trace(args)
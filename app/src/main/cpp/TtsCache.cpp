@@ -0,0 +1,88 @@
+#include "TtsCache.h"
+
+namespace soundscape {
+
+    std::string TtsCache::entryKey(const std::string &key, int sampleRate) {
+        return std::to_string(sampleRate) + ":" + key;
+    }
+
+    std::shared_ptr<const TtsCache::Clip> TtsCache::find(const std::string &key, int sampleRate) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = m_Entries.find(entryKey(key, sampleRate));
+        if (it == m_Entries.end()) {
+            ++m_Misses;
+            return nullptr;
+        }
+        ++m_Hits;
+        m_Order.splice(m_Order.begin(), m_Order, it->second.position);
+        return it->second.clip;
+    }
+
+    void TtsCache::insert(const std::string &key, std::shared_ptr<const Clip> clip) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (!clip || clip->samples.empty() || clip->bytes() > m_Budget / MAX_CLIP_SHARE)
+            return;
+
+        std::string entry = entryKey(key, clip->sampleRate);
+        auto existing = m_Entries.find(entry);
+        if (existing != m_Entries.end())
+            erase(existing);
+
+        m_Order.push_front(entry);
+        m_Bytes += clip->bytes();
+        m_Entries.emplace(entry, Entry{std::move(clip), m_Order.begin()});
+        ++m_Insertions;
+        evict(m_Budget);
+    }
+
+    size_t TtsCache::maxClipBytes() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Budget / MAX_CLIP_SHARE;
+    }
+
+    void TtsCache::setBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Budget = bytes;
+        evict(m_Budget);
+    }
+
+    void TtsCache::trim(size_t maxBytes) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        evict(maxBytes);
+    }
+
+    TtsCache::Stats TtsCache::getStats() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Stats stats;
+        stats.bytes = m_Bytes;
+        stats.budget = m_Budget;
+        stats.entries = static_cast<int>(m_Entries.size());
+        stats.hits = m_Hits;
+        stats.misses = m_Misses;
+        stats.insertions = m_Insertions;
+        stats.evictions = m_Evictions;
+        return stats;
+    }
+
+    void TtsCache::erase(std::unordered_map<std::string, Entry>::iterator entry) {
+        m_Bytes -= entry->second.clip->bytes();
+        m_Order.erase(entry->second.position);
+        m_Entries.erase(entry);
+    }
+
+    void TtsCache::evict(size_t maxBytes) {
+        // Clips still playing hold a reference of their own, and are passed over
+        auto it = m_Order.end();
+        while (it != m_Order.begin() && m_Bytes > maxBytes) {
+            --it;
+            auto entry = m_Entries.find(*it);
+            if (entry->second.clip.use_count() > 1)
+                continue;
+            m_Bytes -= entry->second.clip->bytes();
+            m_Entries.erase(entry);
+            it = m_Order.erase(it);
+            ++m_Evictions;
+        }
+    }
+
+} // soundscape
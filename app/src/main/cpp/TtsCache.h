@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace soundscape {
+
+    // Synthesized speech kept for reuse. Callouts repeat the same street names and phrases, and
+    // playing one from here starts at once rather than waiting for the synthesizer.
+    //
+    // Each utterance's audio is recorded as it streams in, and kept only if the whole of it
+    // played. The key identifies what was synthesized and how (the text, engine, voice, rate and
+    // so on), and the clip is kept per mixer rate, as that's the rate it was recorded at.
+    //
+    // Like WavDecoder's cache, clips are kept up to a budget in bytes, dropping the least
+    // recently used beyond it, and a clip which is playing is pinned.
+    class TtsCache {
+    public:
+        // Mono 16 bit samples, as synthesizers deliver, at sampleRate
+        struct Clip {
+            std::vector<int16_t> samples;
+            int sampleRate = 0;
+
+            size_t bytes() const { return samples.size() * sizeof(int16_t); }
+        };
+
+        // About a minute of speech at 48 kHz
+        static constexpr size_t DEFAULT_BUDGET = 6 * 1024 * 1024;
+
+        // No one clip may take more than this share of the budget
+        static constexpr size_t MAX_CLIP_SHARE = 4;
+
+        struct Stats {
+            size_t bytes = 0;
+            size_t budget = 0;
+            int entries = 0;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t insertions = 0;
+            uint64_t evictions = 0;
+        };
+
+        // The clip for key at sampleRate, or null
+        std::shared_ptr<const Clip> find(const std::string &key, int sampleRate);
+
+        // Keep clip for key, replacing any already kept
+        void insert(const std::string &key, std::shared_ptr<const Clip> clip);
+
+        // The most a clip can be and still be kept
+        size_t maxClipBytes();
+
+        // Takes effect straight away, dropping clips if the cache is now over budget
+        void setBudget(size_t bytes);
+
+        // Drop unpinned clips, least recently used first, until at most maxBytes are held
+        void trim(size_t maxBytes);
+
+        Stats getStats();
+
+    private:
+        struct Entry {
+            std::shared_ptr<const Clip> clip;
+            std::list<std::string>::iterator position;
+        };
+
+        static std::string entryKey(const std::string &key, int sampleRate);
+
+        void evict(size_t maxBytes);
+
+        void erase(std::unordered_map<std::string, Entry>::iterator entry);
+
+        // Least recently used at the back
+        std::mutex m_Mutex;
+        std::list<std::string> m_Order;
+        std::unordered_map<std::string, Entry> m_Entries;
+        size_t m_Bytes = 0;
+        size_t m_Budget = DEFAULT_BUDGET;
+        uint64_t m_Hits = 0;
+        uint64_t m_Misses = 0;
+        uint64_t m_Insertions = 0;
+        uint64_t m_Evictions = 0;
+    };
+
+} // soundscape
@@ -0,0 +1,357 @@
+#include "TtsIngest.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace soundscape {
+
+    namespace {
+        // Converted frames handed to the resampler at a time, and the most it writes at a time
+        constexpr int SOURCE_FRAMES = 4096;
+        constexpr int OUTPUT_FRAMES = 2048;
+
+        // How often streams whose rings are full are checked for room. A full ring holds far
+        // more than this, so the audio thread never waits for it.
+        constexpr int ROOM_POLL_MS = 10;
+
+        constexpr int MAX_EVENTS = 16;
+
+        int bytesPerSample(int audioFormat) {
+            switch (audioFormat) {
+                case 0:
+                    return 1;
+                default:
+                case 1:
+                    return 2;
+                case 2:
+                    return 4;
+            }
+        }
+
+        // Downmix frames of raw PCM to mono float
+        void convert(const uint8_t *raw, int frames, int audioFormat, int channelCount,
+                     float *out) {
+            int sampleBytes = bytesPerSample(audioFormat);
+            int frameBytes = sampleBytes * channelCount;
+            for (int i = 0; i < frames; i++) {
+                float sample = 0.0f;
+                for (int ch = 0; ch < channelCount; ch++) {
+                    const uint8_t *src = raw + i * frameBytes + ch * sampleBytes;
+                    float chSample = 0.0f;
+                    if (audioFormat == 0) {
+                        chSample = (static_cast<float>(src[0]) - 128.0f) / 128.0f;
+                    } else if (audioFormat == 2) {
+                        memcpy(&chSample, src, 4);
+                    } else {
+                        int16_t s;
+                        memcpy(&s, src, 2);
+                        chSample = static_cast<float>(s) / 32768.0f;
+                    }
+                    sample += chSample;
+                }
+                out[i] = sample / static_cast<float>(channelCount);
+            }
+        }
+    } // namespace
+
+    TtsStream::TtsStream(int socket, int targetSampleRate)
+            : m_Socket(socket),
+              m_TargetRate(targetSampleRate),
+              m_Ring(RING_FRAMES),
+              m_Raw(SOURCE_FRAMES * sizeof(int16_t)),
+              m_Source(SOURCE_FRAMES),
+              m_Output(OUTPUT_FRAMES) {
+        int flags = fcntl(m_Socket, F_GETFL, 0);
+        fcntl(m_Socket, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    TtsStream::~TtsStream() {
+        close(m_Socket);
+
+        // Kept only if the recording is exactly what was heard, so nothing cut short, dropped
+        // or arriving after the end
+        int64_t played = m_FramesPlayed.load(std::memory_order_acquire);
+        if (m_Recording && played > 0 && static_cast<int64_t>(m_Recorded.size()) == played) {
+            auto clip = std::make_shared<TtsCache::Clip>();
+            m_Recorded.shrink_to_fit();
+            clip->samples = std::move(m_Recorded);
+            clip->sampleRate = m_RecordRate;
+            m_pCache->insert(m_CacheKey, std::move(clip));
+        }
+    }
+
+    void TtsStream::recordFor(TtsCache *cache, std::string key) {
+        m_pCache = cache;
+        m_CacheKey = std::move(key);
+        m_Recording = cache != nullptr && !m_CacheKey.empty();
+        m_RecordRate = m_TargetRate.load();
+        if (m_Recording)
+            m_RecordLimit = cache->maxClipBytes() / sizeof(int16_t);
+    }
+
+    void TtsStream::setFormat(int sampleRate, int audioFormat, int channelCount) {
+        m_AudioFormat.store(audioFormat);
+        m_ChannelCount.store(std::max(channelCount, 1));
+        m_SampleRate.store(sampleRate);
+    }
+
+    TtsIngest::TtsIngest(bool threaded) {
+        m_Epoll = epoll_create1(EPOLL_CLOEXEC);
+        m_WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        // The wake up is told apart from the sockets by having no stream
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_WakeFd, &event);
+
+        if (threaded)
+            m_Thread = std::thread(&TtsIngest::run, this);
+    }
+
+    TtsIngest::~TtsIngest() {
+        {
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            m_Quit = true;
+        }
+        wake();
+        if (m_Thread.joinable())
+            m_Thread.join();
+
+        for (auto &stream: m_Streams)
+            watch(*stream, false);
+        close(m_WakeFd);
+        close(m_Epoll);
+    }
+
+    void TtsIngest::add(const std::shared_ptr<TtsStream> &stream) {
+        {
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            m_Added.push_back(stream);
+        }
+        wake();
+    }
+
+    void TtsIngest::remove(TtsStream &stream) {
+        stream.m_Removed = true;
+        wake();
+    }
+
+    void TtsIngest::wake() {
+        uint64_t one = 1;
+        if (write(m_WakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            TRACE("TtsIngest: wake failed %d", errno);
+    }
+
+    void TtsIngest::run() {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> guard(m_Mutex);
+                if (m_Quit)
+                    return;
+            }
+
+            // Only streams waiting for room need waking without a socket event
+            bool waitingForRoom = std::any_of(m_Streams.begin(), m_Streams.end(),
+                                              [](const auto &stream) {
+                                                  return !stream->m_Watching;
+                                              });
+            service(waitingForRoom ? ROOM_POLL_MS : -1);
+        }
+    }
+
+    void TtsIngest::service(int timeoutMs) {
+        epoll_event events[MAX_EVENTS];
+        int count = epoll_wait(m_Epoll, events, MAX_EVENTS, timeoutMs);
+
+        std::vector<std::shared_ptr<TtsStream>> added;
+        {
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            if (m_Quit)
+                return;
+            added.swap(m_Added);
+        }
+        for (auto &stream: added) {
+            m_Streams.push_back(stream);
+            pump(*stream);
+        }
+
+        for (int i = 0; i < count; i++) {
+            auto *stream = static_cast<TtsStream *>(events[i].data.ptr);
+            if (stream) {
+                pump(*stream);
+            } else {
+                uint64_t value;
+                while (read(m_WakeFd, &value, sizeof(value)) > 0) {
+                }
+            }
+        }
+
+        // Let go of streams which have finished or been removed, and top up those which were
+        // waiting for room
+        for (auto it = m_Streams.begin(); it != m_Streams.end();) {
+            TtsStream &stream = **it;
+            if (stream.m_Removed || stream.atEnd()) {
+                watch(stream, false);
+                it = m_Streams.erase(it);
+                continue;
+            }
+            if (!stream.m_Watching)
+                pump(stream);
+            ++it;
+        }
+    }
+
+    void TtsIngest::watch(TtsStream &stream, bool watching) {
+        if (stream.m_Watching == watching)
+            return;
+
+        // Removed rather than modified when not watching, as a hung up socket would otherwise
+        // keep reporting EPOLLHUP
+        if (watching) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.ptr = &stream;
+            epoll_ctl(m_Epoll, EPOLL_CTL_ADD, stream.m_Socket, &event);
+        } else {
+            epoll_ctl(m_Epoll, EPOLL_CTL_DEL, stream.m_Socket, nullptr);
+        }
+        stream.m_Watching = watching;
+    }
+
+    void TtsIngest::socketClosed(TtsStream &stream) {
+        // A partly read frame can never be completed
+        watch(stream, false);
+        stream.m_Closed = true;
+        stream.m_RawHeld = 0;
+    }
+
+    void TtsIngest::end(TtsStream &stream) {
+        watch(stream, false);
+        stream.m_Ended.store(true, std::memory_order_release);
+    }
+
+    void TtsIngest::record(TtsStream &stream, const float *frames, int count) {
+        // A clip must be all at one rate, and within what the cache would keep
+        if (stream.m_TargetRate.load() != stream.m_RecordRate ||
+            stream.m_Recorded.size() + count > stream.m_RecordLimit) {
+            stream.m_Recording = false;
+            std::vector<int16_t>().swap(stream.m_Recorded);
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            float sample = std::clamp(frames[i] * 32768.0f, -32768.0f, 32767.0f);
+            stream.m_Recorded.push_back(static_cast<int16_t>(lrintf(sample)));
+        }
+    }
+
+    void TtsIngest::pump(TtsStream &stream) {
+        if (stream.m_Removed || stream.atEnd())
+            return;
+
+        int format = stream.m_AudioFormat.load();
+        int channels = stream.m_ChannelCount.load();
+        int frameBytes = bytesPerSample(format) * channels;
+        if (frameBytes * SOURCE_FRAMES > static_cast<int>(stream.m_Raw.size()))
+            stream.m_Raw.resize(frameBytes * SOURCE_FRAMES);
+        stream.m_Resampler.setRates(stream.m_SampleRate.load(), stream.m_TargetRate.load());
+
+        while (true) {
+            int room = static_cast<int>(std::min<size_t>(stream.m_Ring.space(), OUTPUT_FRAMES));
+            if (room == 0) {
+                // Wait for the audio thread to make some
+                stream.m_Saturated = true;
+                watch(stream, false);
+                return;
+            }
+
+            // Read only as much as fills the room, so that the rest waits in the socket
+            int wanted = 0;
+            bool drained = false;
+            if (!stream.m_Closed) {
+                wanted = stream.m_Resampler.inputFramesNeeded(room) - stream.m_SourceHeld;
+                wanted = std::clamp(wanted, 0, SOURCE_FRAMES - stream.m_SourceHeld);
+            }
+            if (wanted > 0) {
+                ssize_t bytes = read(stream.m_Socket, stream.m_Raw.data() + stream.m_RawHeld,
+                                     wanted * frameBytes - stream.m_RawHeld);
+                if (bytes == 0) {
+                    socketClosed(stream);
+                    continue;
+                } else if (bytes < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                        // The app closes sockets with an error to cut speech short, so what
+                        // arrived isn't the whole utterance
+                        stream.m_Recording = false;
+                        std::vector<int16_t>().swap(stream.m_Recorded);
+                        socketClosed(stream);
+                        continue;
+                    }
+                    drained = true;
+                } else {
+                    stream.m_RawHeld += static_cast<int>(bytes);
+                    int frames = stream.m_RawHeld / frameBytes;
+                    convert(stream.m_Raw.data(), frames, format, channels,
+                            stream.m_Source.data() + stream.m_SourceHeld);
+                    stream.m_SourceHeld += frames;
+                    stream.m_RawHeld -= frames * frameBytes;
+                    memmove(stream.m_Raw.data(), stream.m_Raw.data() + frames * frameBytes,
+                            stream.m_RawHeld);
+                }
+            }
+
+            int consumed = 0;
+            int written = stream.m_Resampler.process(stream.m_Source.data(), stream.m_SourceHeld,
+                                                     stream.m_Output.data(), room, consumed);
+            stream.m_SourceHeld -= consumed;
+            memmove(stream.m_Source.data(), stream.m_Source.data() + consumed,
+                    stream.m_SourceHeld * sizeof(float));
+
+            // Once the socket has closed and the resampler has taken everything, the outputs
+            // its look ahead held back follow
+            bool finishing = stream.m_Closed && stream.m_SourceHeld == 0;
+            if (finishing && written < room)
+                written += stream.m_Resampler.flush(stream.m_Output.data() + written,
+                                                    room - written);
+            if (written > 0) {
+                stream.m_Ring.write(stream.m_Output.data(), written);
+                if (stream.m_Recording)
+                    record(stream, stream.m_Output.data(), written);
+
+                int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+                int64_t last = stream.m_LastArrivalNs.load();
+                if (last == 0)
+                    stream.m_FirstArrivalNs = now;
+                else if (now - last > stream.m_MaxGapNs.load())
+                    stream.m_MaxGapNs = now - last;
+                stream.m_LastArrivalNs = now;
+                if (!stream.m_Saturated) {
+                    stream.m_MeasuredFrames += written;
+                    stream.m_MeasuredNs = now - stream.m_FirstArrivalNs;
+                }
+            }
+
+            if (finishing && written < room) {
+                end(stream);
+                return;
+            }
+            if (drained || (written == 0 && wanted == 0)) {
+                // Sleep until the synthesizer sends more
+                watch(stream, true);
+                return;
+            }
+        }
+    }
+
+} // soundscape
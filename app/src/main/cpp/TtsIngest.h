@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PolyphaseResampler.h"
+#include "SpscQueue.h"
+#include "TtsCache.h"
+#include "TtsJitterBuffer.h"
+
+namespace soundscape {
+
+    // One utterance's audio on its way from the synthesizer's socket to the mixer. TtsIngest
+    // reads the socket, converts what arrives to mono float at the target rate and writes it to
+    // the ring, so the audio thread only ever copies out of memory.
+    class TtsStream {
+    public:
+        // Takes ownership of socket, which is closed along with the stream
+        TtsStream(int socket, int targetSampleRate);
+
+        ~TtsStream();
+
+        // The synthesizer's format: audioFormat 0=PCM8, 1=PCM16, 2=PCMFLOAT. Any thread.
+        void setFormat(int sampleRate, int audioFormat, int channelCount);
+
+        // The mixer's rate, should it change whilst the stream plays. Any thread.
+        void setTargetSampleRate(int rate) { m_TargetRate.store(rate); }
+
+        // Audio thread: copy out up to frames of audio. Returns the number copied.
+        int read(float *out, int frames) {
+            return static_cast<int>(m_Ring.read(out, static_cast<size_t>(frames)));
+        }
+
+        // Frames waiting to be read
+        int buffered() const { return static_cast<int>(m_Ring.available()); }
+
+        // True once the socket has closed and everything read from it is in the ring. Check
+        // this before reading, so that nothing written before the end is missed.
+        bool atEnd() const { return m_Ended.load(std::memory_order_acquire); }
+
+        int socketForDebug() const { return m_Socket; }
+
+        // When audio last arrived, on the steady clock in nanoseconds, or 0 if none has
+        int64_t lastArrivalNs() const { return m_LastArrivalNs.load(); }
+
+        // Longest time between one arrival and the next
+        int64_t maxGapNs() const { return m_MaxGapNs.load(); }
+
+        // Frames which arrived, and the time from the first arrival to the last, until the ring
+        // first filled. After that arrivals wait on playback, so say nothing of the synthesizer.
+        void arrival(int64_t &frames, int64_t &ns) const {
+            frames = m_MeasuredFrames.load();
+            ns = m_MeasuredNs.load();
+        }
+
+        // Keep a copy of the audio as it arrives, and put it in cache under key if all of it is
+        // played. Call before the stream is added to an ingest.
+        void recordFor(TtsCache *cache, std::string key);
+
+        // Audio thread: the utterance played to its end, having played frames. What was
+        // recorded is kept only if that's all of it.
+        void finished(int64_t frames) { m_FramesPlayed.store(frames, std::memory_order_release); }
+
+        // About 1.4 s at 48 kHz. The rest waits in the socket until there's room.
+        static constexpr size_t RING_FRAMES = 65536;
+
+    private:
+        friend class TtsIngest;
+
+        int m_Socket;
+        std::atomic<int> m_SampleRate{0};
+        std::atomic<int> m_AudioFormat{1};
+        std::atomic<int> m_ChannelCount{1};
+        std::atomic<int> m_TargetRate;
+        std::atomic<bool> m_Ended{false};
+        std::atomic<bool> m_Removed{false};
+        std::atomic<int64_t> m_LastArrivalNs{0};
+        std::atomic<int64_t> m_MaxGapNs{0};
+        std::atomic<int64_t> m_MeasuredFrames{0};
+        std::atomic<int64_t> m_MeasuredNs{0};
+        SpscRing<float> m_Ring;
+
+        // Ingest thread only. Bytes of a partly read frame, and converted frames the resampler
+        // hasn't taken yet, are kept for the next read.
+        PolyphaseResampler m_Resampler;
+        std::vector<uint8_t> m_Raw;
+        int m_RawHeld = 0;
+        std::vector<float> m_Source;
+        int m_SourceHeld = 0;
+        std::vector<float> m_Output;
+        bool m_Watching = false;
+        bool m_Closed = false;      // the socket has closed, and what's held is being drained
+        int64_t m_FirstArrivalNs = 0;
+        bool m_Saturated = false;
+
+        // Recording for the cache. Written by the ingest thread, and read when the stream is
+        // destroyed, after the ingest has let go of it.
+        TtsCache *m_pCache = nullptr;
+        std::string m_CacheKey;
+        bool m_Recording = false;
+        int m_RecordRate = 0;
+        size_t m_RecordLimit = 0;
+        std::vector<int16_t> m_Recorded;
+        std::atomic<int64_t> m_FramesPlayed{-1};
+    };
+
+    // Reads every text to speech socket, playing or queued, on one thread which sleeps in epoll
+    // until any of them has data. Keeping read() and format conversion off the audio thread
+    // means that callback time doesn't depend on how the synthesizer delivers its audio.
+    class TtsIngest {
+    public:
+        // Without a thread, nothing is read until poll() is called. Offline rendering does that
+        // between blocks so that speech arrives the same way on every run.
+        explicit TtsIngest(bool threaded = true);
+
+        // Stops reading. Streams still held elsewhere are left as they are.
+        ~TtsIngest();
+
+        // Start reading stream's socket. The stream's format must already be set. Any thread.
+        void add(const std::shared_ptr<TtsStream> &stream);
+
+        // Stop reading stream's socket. The ingest lets go of it the next time it wakes, so this
+        // doesn't wait. Any thread.
+        void remove(TtsStream &stream);
+
+        // Read whatever has arrived, without waiting. For when there's no thread.
+        void poll() { service(0); }
+
+        // Shared by the sources reading this ingest's streams
+        TtsJitterBuffer &jitterBuffer() { return m_JitterBuffer; }
+
+    private:
+        void run();
+
+        void wake();
+
+        // Wait up to timeoutMs (forever if negative) for sockets, and read from them
+        void service(int timeoutMs);
+
+        // Read, convert and resample as much as the stream has room for
+        void pump(TtsStream &stream);
+
+        // Add frames just written to the stream's recording
+        void record(TtsStream &stream, const float *frames, int count);
+
+        void watch(TtsStream &stream, bool watching);
+
+        // The socket has closed. What's still held is written before the stream ends.
+        void socketClosed(TtsStream &stream);
+
+        void end(TtsStream &stream);
+
+        TtsJitterBuffer m_JitterBuffer;
+
+        int m_Epoll = -1;
+        int m_WakeFd = -1;
+
+        std::mutex m_Mutex;
+        std::vector<std::shared_ptr<TtsStream>> m_Added;
+        bool m_Quit = false;
+
+        // Only touched by whichever thread services the sockets
+        std::vector<std::shared_ptr<TtsStream>> m_Streams;
+
+        std::thread m_Thread;
+    };
+
+} // soundscape
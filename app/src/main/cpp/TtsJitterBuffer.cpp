@@ -0,0 +1,139 @@
+#include "TtsJitterBuffer.h"
+
+#include <algorithm>
+
+namespace soundscape {
+
+    namespace {
+        // Weight of the latest utterance in the running estimates
+        constexpr double SMOOTHING = 0.3;
+
+        // Utterances which arrive quicker than this are too short to time
+        constexpr int64_t MIN_ARRIVAL_NS = 20000000;
+
+        // Fraction of the underrun margin kept after each clean utterance
+        constexpr double MARGIN_DECAY = 0.8;
+
+        // A pause this many times the longest gap between arrivals ends an utterance, but never
+        // one shorter than the minimum
+        constexpr int64_t GAP_FACTOR = 3;
+        constexpr int64_t MIN_STALL_NS = 100000000;
+
+        uint64_t toUs(int frames, int rate) {
+            return rate > 0 ? static_cast<uint64_t>(frames) * 1000000 / rate : 0;
+        }
+    } // namespace
+
+    TtsJitterBuffer::TtsJitterBuffer() {
+        setConfig(TtsBufferConfig());
+        updateTarget();
+    }
+
+    void TtsJitterBuffer::setConfig(const TtsBufferConfig &config) {
+        m_PreRollMs = std::max(config.preRollMs, 0);
+        m_MaxPreRollMs = std::max(config.maxPreRollMs, config.preRollMs);
+        m_StartTimeoutMs = std::max(config.startTimeoutMs, 0);
+        m_StallTimeoutMs = std::max(config.stallTimeoutMs, 0);
+    }
+
+    int64_t TtsJitterBuffer::stallLimitNs(bool arriving, int64_t maxGapNs) const {
+        if (!arriving)
+            return m_StartTimeoutMs.load(std::memory_order_relaxed) * 1000000LL;
+
+        int64_t gapNs = std::max(maxGapNs, m_TypicalGapNs.load(std::memory_order_relaxed));
+        int64_t maxNs = m_StallTimeoutMs.load(std::memory_order_relaxed) * 1000000LL;
+        return std::min(std::max(GAP_FACTOR * gapNs, MIN_STALL_NS), maxNs);
+    }
+
+    double TtsJitterBuffer::targetMs() const {
+        double preRollMs = m_PreRollMs.load(std::memory_order_relaxed);
+        return std::min(preRollMs + m_ExtraMs.load(std::memory_order_relaxed),
+                        static_cast<double>(m_MaxPreRollMs.load(std::memory_order_relaxed)));
+    }
+
+    int TtsJitterBuffer::preRollFrames(int rate) const {
+        return static_cast<int>(targetMs() * rate / 1000.0);
+    }
+
+    void TtsJitterBuffer::started(int delayFrames, int rate) {
+        m_Utterances.fetch_add(1, std::memory_order_relaxed);
+        if (delayFrames <= 0)
+            return;
+
+        // Waiting out the pre-roll is expected, so only longer than that is late
+        uint64_t delayUs = toUs(delayFrames, rate);
+        if (static_cast<double>(delayUs) > targetMs() * 1000.0)
+            m_LateStarts.fetch_add(1, std::memory_order_relaxed);
+        m_StartDelayUs.fetch_add(delayUs, std::memory_order_relaxed);
+        if (delayUs > m_MaxStartDelayUs.load(std::memory_order_relaxed))
+            m_MaxStartDelayUs.store(delayUs, std::memory_order_relaxed);
+    }
+
+    void TtsJitterBuffer::underrun(int silentFrames, int rate) {
+        uint64_t silentUs = toUs(silentFrames, rate);
+        m_Underruns.fetch_add(1, std::memory_order_relaxed);
+        m_UnderrunUs.fetch_add(silentUs, std::memory_order_relaxed);
+
+        // Restart with at least as much more buffered as it went without
+        m_MarginMs = std::min(m_MarginMs + silentUs / 1000.0,
+                              static_cast<double>(m_MaxPreRollMs.load()));
+        updateTarget();
+    }
+
+    void TtsJitterBuffer::finished(int64_t frames, int rate, int64_t arrivedFrames,
+                                   int64_t arrivalNs, int64_t maxGapNs, bool underran,
+                                   bool stalled) {
+        if (stalled)
+            m_Stalls.fetch_add(1, std::memory_order_relaxed);
+        if (frames <= 0 || rate <= 0)
+            return;
+
+        // A stalled utterance's last gap went unmeasured
+        if (!stalled) {
+            auto typical = static_cast<double>(m_TypicalGapNs.load(std::memory_order_relaxed));
+            typical += SMOOTHING * (static_cast<double>(maxGapNs) - typical);
+            m_TypicalGapNs.store(static_cast<int64_t>(typical), std::memory_order_relaxed);
+        }
+
+        // Audio seconds per second. A synthesizer which delivered too quickly to time is at
+        // least as fast as playback.
+        double audioMs = 1000.0 * static_cast<double>(frames) / rate;
+        double arrivalRate = 2.0;
+        if (arrivalNs >= MIN_ARRIVAL_NS) {
+            double arrivedMs = 1000.0 * static_cast<double>(arrivedFrames) / rate;
+            arrivalRate = std::clamp(arrivedMs * 1e6 / static_cast<double>(arrivalNs), 0.1, 2.0);
+        }
+
+        // The first utterance measured replaces the guesses outright
+        double weight = m_Measured ? SMOOTHING : 1.0;
+        m_Measured = true;
+        m_ArrivalRate += weight * (arrivalRate - m_ArrivalRate);
+        m_UtteranceMs += weight * (audioMs - m_UtteranceMs);
+        if (!underran)
+            m_MarginMs *= MARGIN_DECAY;
+        updateTarget();
+    }
+
+    void TtsJitterBuffer::updateTarget() {
+        // Arriving at a fraction r of real time, an utterance lasting T needs (1 - r) T buffered
+        // to play through without running dry
+        double deficitMs = std::max(0.0, 1.0 - m_ArrivalRate) * m_UtteranceMs;
+        m_ExtraMs.store(deficitMs + m_MarginMs, std::memory_order_relaxed);
+        m_ReportedArrivalRate.store(m_ArrivalRate, std::memory_order_relaxed);
+    }
+
+    TtsBufferStats TtsJitterBuffer::getStats() const {
+        TtsBufferStats stats;
+        stats.utterances = m_Utterances.load(std::memory_order_relaxed);
+        stats.lateStarts = m_LateStarts.load(std::memory_order_relaxed);
+        stats.startDelayMs = m_StartDelayUs.load(std::memory_order_relaxed) / 1000.0;
+        stats.maxStartDelayMs = m_MaxStartDelayUs.load(std::memory_order_relaxed) / 1000.0;
+        stats.underruns = m_Underruns.load(std::memory_order_relaxed);
+        stats.underrunMs = m_UnderrunUs.load(std::memory_order_relaxed) / 1000.0;
+        stats.stalls = m_Stalls.load(std::memory_order_relaxed);
+        stats.preRollMs = targetMs();
+        stats.arrivalRate = m_ReportedArrivalRate.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+} // soundscape
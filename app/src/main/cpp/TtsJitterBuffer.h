@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace soundscape {
+
+    // How text to speech is buffered before and whilst it plays
+    struct TtsBufferConfig {
+        // Buffered before an utterance starts, or restarts after running dry, when the
+        // synthesizer keeps up with real time. More is added for one which doesn't.
+        int preRollMs = 40;
+        int maxPreRollMs = 600;
+        // How long to wait for an utterance's first audio before giving up on it
+        int startTimeoutMs = 3000;
+        // Once audio is arriving, a pause of a few times the longest seen between arrivals ends
+        // the utterance, as the app doesn't always close the socket when synthesis finishes.
+        // This is as long as that can be.
+        int stallTimeoutMs = 2000;
+    };
+
+    // Counts since the engine started, other than the last two
+    struct TtsBufferStats {
+        uint64_t utterances = 0;        // started playing
+        uint64_t lateStarts = 0;        // waited longer than the pre-roll
+        double startDelayMs = 0.0;      // total waited, in audio time
+        double maxStartDelayMs = 0.0;
+        uint64_t underruns = 0;         // ran dry part way through
+        double underrunMs = 0.0;        // total silence inserted
+        uint64_t stalls = 0;            // ended by the stall timeout rather than the socket
+        double preRollMs = 0.0;         // what the next utterance will buffer
+        double arrivalRate = 0.0;       // audio seconds delivered per second, recently
+    };
+
+    // Shared by every utterance, so that how deep each is buffered follows how the synthesizer
+    // has been behaving. It measures how fast audio arrives relative to real time, and adds
+    // enough pre-roll for an utterance of typical length to play through at that rate, plus a
+    // margin which grows with each underrun and shrinks with each clean utterance.
+    //
+    // The config may be set from any thread; everything else is called from the audio thread.
+    class TtsJitterBuffer {
+    public:
+        TtsJitterBuffer();
+
+        void setConfig(const TtsBufferConfig &config);
+
+        // How long an utterance can go without new audio before it's taken as over. arriving is
+        // false until its first audio arrives, and maxGapNs is the longest between arrivals since.
+        int64_t stallLimitNs(bool arriving, int64_t maxGapNs) const;
+
+        // Frames to buffer before starting at rate
+        int preRollFrames(int rate) const;
+
+        // An utterance started after waiting delayFrames of silence at rate
+        void started(int delayFrames, int rate);
+
+        // It ran dry and waited silentFrames before it could carry on
+        void underrun(int silentFrames, int rate);
+
+        // It finished, having played frames at rate. arrivedFrames of them arrived over
+        // arrivalNs before anything held them up, and at most maxGapNs apart.
+        void finished(int64_t frames, int rate, int64_t arrivedFrames, int64_t arrivalNs,
+                      int64_t maxGapNs, bool underran, bool stalled);
+
+        TtsBufferStats getStats() const;
+
+    private:
+        void updateTarget();
+
+        double targetMs() const;
+
+        std::atomic<int> m_PreRollMs{0};
+        std::atomic<int> m_MaxPreRollMs{0};
+        std::atomic<int> m_StartTimeoutMs{0};
+        std::atomic<int> m_StallTimeoutMs{0};
+
+        // Audio thread only
+        double m_ArrivalRate = 2.0;
+        double m_UtteranceMs = 2000.0;
+        double m_MarginMs = 0.0;
+        bool m_Measured = false;
+
+        // What the measurements add to the configured pre-roll
+        std::atomic<double> m_ExtraMs{0.0};
+        // Longest gap between arrivals in recent utterances
+        std::atomic<int64_t> m_TypicalGapNs{0};
+        std::atomic<double> m_ReportedArrivalRate{0.0};
+        std::atomic<uint64_t> m_Utterances{0};
+        std::atomic<uint64_t> m_LateStarts{0};
+        std::atomic<uint64_t> m_StartDelayUs{0};
+        std::atomic<uint64_t> m_MaxStartDelayUs{0};
+        std::atomic<uint64_t> m_Underruns{0};
+        std::atomic<uint64_t> m_UnderrunUs{0};
+        std::atomic<uint64_t> m_Stalls{0};
+    };
+
+} // soundscape
@@ -1,8 +1,12 @@
 #include "WavDecoder.h"
+#include "MixKernels.h"
 #include "Trace.h"
+#include <atomic>
 #include <cstring>
 #include <cmath>
 #include <algorithm>
+#include <future>
+#include <list>
 #include <mutex>
 #include <unordered_map>
 
@@ -16,73 +20,322 @@ namespace soundscape {
         return path;
     }
 
-    WavDecoder::WavDecoder(AAssetManager *mgr, const std::string &path, int targetRate) {
-        m_Data = loadCached(mgr, path, targetRate);
+    namespace {
+        std::atomic<bool> s_MappedPlayback{true};
+        std::atomic<int> s_DecodeThreads{-1};
+        std::atomic<ResampleQuality> s_ResampleQuality{ResampleQuality::MEDIUM};
+    } // namespace
+
+    void WavDecoder::setMappedPlayback(bool enabled) {
+        s_MappedPlayback = enabled;
+    }
+
+    void WavDecoder::setResampleQuality(ResampleQuality quality) {
+        s_ResampleQuality = quality;
+    }
+
+    void WavDecoder::setDecodeThreads(int threads) {
+        s_DecodeThreads = threads;
+    }
+
+    WorkStealingPool *WavDecoder::decodePool() {
+        int threads = s_DecodeThreads.load();
+        if (s_MappedPlayback.load() || threads == 0)
+            return nullptr;
+
+        // Shared by every engine, and never destroyed before a load which is using it
+        static WorkStealingPool s_Pool(threads);
+        return &s_Pool;
+    }
+
+    void WavDecoder::forEachChunk(WorkStealingPool *pool, int total,
+                                  const std::function<void(int, int)> &fn) {
+        int chunks = (total + DECODE_CHUNK - 1) / DECODE_CHUNK;
+        WorkStealingPool::parallelFor(pool, chunks, [&](int chunk) {
+            int first = chunk * DECODE_CHUNK;
+            fn(first, std::min(DECODE_CHUNK, total - first));
+        });
+    }
+
+    WavDecoder::WavDecoder(AssetSource *assets, const std::string &path, int targetRate) {
+        m_Data = loadCached(assets, path, targetRate, s_MappedPlayback.load(),
+                            s_ResampleQuality.load());
         if (m_Data) {
+            // The pages may have been dropped since the asset was cached or prefetched
+            if (m_Data->mapping)
+                m_Data->mapping->populate();
             m_SampleRate = m_Data->sampleRate;
             m_OriginalSampleRate = m_Data->originalSampleRate;
         }
     }
 
-    std::shared_ptr<const WavDecoder::DecodedWav> WavDecoder::loadCached(
-            AAssetManager *mgr, const std::string &path, int targetRate) {
-        static std::mutex s_CacheMutex;
-        static std::unordered_map<std::string, std::shared_ptr<const DecodedWav>> s_Cache;
+    int WavDecoder::read(float *out, int startFrame, int numFrames) const {
+        if (!m_Data || startFrame < 0 || startFrame >= m_Data->numFrames || numFrames <= 0)
+            return 0;
+
+        int frames = std::min(numFrames, m_Data->numFrames - startFrame);
+        convertToMono(m_Data->format, startFrame, frames, out);
+        return frames;
+    }
 
-        const std::string key = stripAssetPrefix(path) + "|" + std::to_string(targetRate);
+    // Least recently used first at the back of m_Order. Pinning is judged from the entries'
+    // use counts: only the cache copies them, under its lock, so a count of one can't go up
+    // behind its back.
+    class WavDecoder::Cache {
+    public:
+        // The entry for key, calling decode() to make it on a miss. Decoding happens outside the
+        // lock, so that first-time loads of different assets don't serialise on each other, and
+        // a thread which misses whilst another is already decoding the same key waits for that
+        // result rather than decoding it again.
+        template<typename Decode>
+        std::shared_ptr<const DecodedWav> get(const std::string &key, Decode decode) {
+            std::promise<std::shared_ptr<const DecodedWav>> promise;
+            std::shared_future<std::shared_ptr<const DecodedWav>> inFlight;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                auto it = m_Entries.find(key);
+                if (it != m_Entries.end()) {
+                    ++m_Hits;
+                    m_Order.splice(m_Order.begin(), m_Order, it->second.position);
+                    return it->second.data;
+                }
 
-        {
-            std::lock_guard<std::mutex> lock(s_CacheMutex);
-            auto it = s_Cache.find(key);
-            if (it != s_Cache.end()) {
-                return it->second;
+                auto pending = m_InFlight.find(key);
+                if (pending != m_InFlight.end()) {
+                    ++m_Joined;
+                    inFlight = pending->second;
+                } else {
+                    ++m_Misses;
+                    m_InFlight.emplace(key, promise.get_future().share());
+                }
+            }
+            if (inFlight.valid())
+                return inFlight.get();
+
+            std::shared_ptr<const DecodedWav> data = decode();
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_InFlight.erase(key);
+                m_Order.push_front(key);
+                size_t bytes = data->storage.size();
+                m_Entries.emplace(key, Entry{data, m_Order.begin(), bytes});
+                m_Bytes += bytes;
+                evict(m_Budget);
             }
+            promise.set_value(data);
+            return data;
+        }
+
+        void setBudget(size_t bytes) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Budget = bytes;
+            evict(m_Budget);
         }
 
-        // Decode outside the cache lock: concurrent first-time loads of different assets
-        // shouldn't serialize on each other, only on AAssetManager's own internal lock.
-        std::shared_ptr<DecodedWav> decoded = decode(mgr, path, targetRate);
+        void trim(size_t maxBytes) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            evict(maxBytes);
+        }
 
-        std::lock_guard<std::mutex> lock(s_CacheMutex);
-        return s_Cache.try_emplace(key, decoded).first->second;
+        CacheStats stats() {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            CacheStats stats;
+            stats.bytes = m_Bytes;
+            stats.budget = m_Budget;
+            stats.entries = static_cast<int>(m_Entries.size());
+            stats.hits = m_Hits;
+            stats.misses = m_Misses;
+            stats.joined = m_Joined;
+            stats.evictions = m_Evictions;
+            for (const auto &[key, entry]: m_Entries) {
+                if (entry.data.use_count() > 1) {
+                    ++stats.pinnedEntries;
+                    stats.pinnedBytes += entry.bytes;
+                }
+            }
+            return stats;
+        }
+
+    private:
+        struct Entry {
+            std::shared_ptr<const DecodedWav> data;
+            std::list<std::string>::iterator position;
+            size_t bytes;
+        };
+
+        void evict(size_t maxBytes) {
+            auto it = m_Order.end();
+            while (it != m_Order.begin() && (m_Bytes > maxBytes || maxBytes == 0)) {
+                --it;
+                auto entry = m_Entries.find(*it);
+                if (entry->second.data.use_count() > 1)
+                    continue;
+                m_Bytes -= entry->second.bytes;
+                m_Entries.erase(entry);
+                it = m_Order.erase(it);
+                ++m_Evictions;
+            }
+        }
+
+        std::mutex m_Mutex;
+        std::list<std::string> m_Order;
+        std::unordered_map<std::string, Entry> m_Entries;
+        std::unordered_map<std::string,
+                std::shared_future<std::shared_ptr<const DecodedWav>>> m_InFlight;
+        size_t m_Bytes = 0;
+        size_t m_Budget = DEFAULT_CACHE_BUDGET;
+        uint64_t m_Hits = 0;
+        uint64_t m_Misses = 0;
+        uint64_t m_Joined = 0;
+        uint64_t m_Evictions = 0;
+    };
+
+    WavDecoder::Cache &WavDecoder::cache() {
+        static Cache s_Cache;
+        return s_Cache;
+    }
+
+    void WavDecoder::setCacheBudget(size_t bytes) {
+        cache().setBudget(bytes);
+    }
+
+    void WavDecoder::trimCache(size_t maxBytes) {
+        cache().trim(maxBytes);
+    }
+
+    WavDecoder::CacheStats WavDecoder::getCacheStats() {
+        return cache().stats();
+    }
+
+    std::shared_ptr<const WavDecoder::DecodedWav> WavDecoder::loadCached(
+            AssetSource *assets, const std::string &path, int targetRate, bool mapped,
+            ResampleQuality quality) {
+        std::string key = stripAssetPrefix(path) + "|" + std::to_string(targetRate);
+        if (targetRate > 0)
+            key += "|q" + std::to_string(static_cast<int>(quality));
+        if (mapped)
+            key += "|mapped";
+
+        return cache().get(key, [&]() {
+            return decode(assets, path, targetRate, mapped, quality);
+        });
+    }
+
+    void WavDecoder::prefetch(AssetSource *assets, const std::string &path, int targetRate) {
+        auto wav = loadCached(assets, path, targetRate, s_MappedPlayback.load(),
+                              s_ResampleQuality.load());
+        if (wav && wav->mapping)
+            wav->mapping->populate();
     }
 
     std::shared_ptr<WavDecoder::DecodedWav> WavDecoder::decode(
-            AAssetManager *mgr, const std::string &path, int targetRate) {
+            AssetSource *assets, const std::string &path, int targetRate, bool mapped,
+            ResampleQuality quality) {
         auto result = std::make_shared<DecodedWav>();
 
         std::string assetPath = stripAssetPrefix(path);
 
-        AAsset *asset = AAssetManager_open(mgr, assetPath.c_str(), AASSET_MODE_BUFFER);
+        std::unique_ptr<AssetData> asset;
+        if (assets)
+            asset = mapped ? assets->openMapped(assetPath) : assets->open(assetPath);
         if (!asset) {
             TRACE("WavDecoder: failed to open asset: %s", assetPath.c_str());
             return result;
         }
 
-        auto rawSize = static_cast<size_t>(AAsset_getLength(asset));
-        auto rawData = static_cast<const unsigned char *>(AAsset_getBuffer(asset));
+        size_t rawSize = asset->size();
+        const unsigned char *rawData = asset->data();
 
-        if (rawData && rawSize > 44) {
-            parseWav(*result, rawData, rawSize);
-        } else {
+        if (!rawData || rawSize <= 44) {
             TRACE("WavDecoder: asset too small or null: %s (%zu bytes)", assetPath.c_str(),
                   rawSize);
+            return result;
         }
 
-        AAsset_close(asset);
+        WavFormat format;
+        if (!parseHeader(format, rawData, rawSize))
+            return result;
+
+        result->originalSampleRate = format.sampleRate;
+        result->sampleRate = format.sampleRate;
+
+        if (asset->isMapped() && (targetRate <= 0 || targetRate == format.sampleRate)) {
+            // Nothing to decode: read() converts from the mapping as it goes. An asset at another
+            // rate is resampled here, once, as doing it in read() would put a filter on the audio
+            // thread for every callback.
+            result->format = format;
+            result->mapping = std::move(asset);
+            result->numFrames = format.numFrames;
+            return result;
+        }
 
-        if (targetRate > 0 && result->sampleRate != targetRate && !result->samples.empty()) {
-            resampleTo(*result, targetRate);
+        // Every step works sample by sample, so chunks give the same result as a single pass
+        WorkStealingPool *pool = decodePool();
+        std::vector<float> samples(format.numFrames);
+        forEachChunk(pool, format.numFrames, [&](int first, int count) {
+            convertToMono(format, first, count, samples.data() + first);
+        });
+        asset.reset();
+
+        bool resample = targetRate > 0 && format.sampleRate != targetRate && !samples.empty();
+        if (resample) {
+            auto filter = PolyphaseFilter::get(format.sampleRate, targetRate, quality);
+            resampleTo(samples, format.sampleRate, targetRate, *filter, pool);
+            result->sampleRate = targetRate;
         }
+        storeCompact(*result, samples, format, resample, pool);
+        result->numFrames = static_cast<int>(samples.size());
 
         return result;
     }
 
-    void WavDecoder::parseWav(DecodedWav &out, const unsigned char *rawData, size_t rawSize) {
+    void WavDecoder::storeCompact(DecodedWav &out, const std::vector<float> &samples,
+                                  const WavFormat &source, bool resampled,
+                                  WorkStealingPool *pool) {
+        WavFormat format;
+        format.numChannels = 1;
+        format.sampleRate = out.sampleRate;
+        format.numFrames = static_cast<int>(samples.size());
+
+        if (source.bitsPerSample == 8 && source.numChannels == 1 && !resampled) {
+            format.audioFormat = 1;
+            format.bitsPerSample = 8;
+            out.storage.resize(samples.size());
+            forEachChunk(pool, format.numFrames, [&](int first, int count) {
+                for (int i = first; i < first + count; i++) {
+                    out.storage[i] =
+                            static_cast<unsigned char>(lrintf(samples[i] * 128.0f) + 128);
+                }
+            });
+        } else if (source.bitsPerSample <= 16) {
+            // Loses nothing from 16 bit sources; resampled or downmixed ones are rounded to the
+            // nearest step, which is no coarser than the source's own
+            format.audioFormat = 1;
+            format.bitsPerSample = 16;
+            out.storage.resize(samples.size() * sizeof(int16_t));
+            auto *pcm = reinterpret_cast<int16_t *>(out.storage.data());
+            forEachChunk(pool, format.numFrames, [&](int first, int count) {
+                for (int i = first; i < first + count; i++) {
+                    float scaled = std::clamp(samples[i] * 32768.0f, -32768.0f, 32767.0f);
+                    pcm[i] = static_cast<int16_t>(lrintf(scaled));
+                }
+            });
+        } else {
+            format.audioFormat = 3;
+            format.bitsPerSample = 32;
+            out.storage.resize(samples.size() * sizeof(float));
+            memcpy(out.storage.data(), samples.data(), out.storage.size());
+        }
+        format.samples = out.storage.data();
+        out.format = format;
+    }
+
+    bool WavDecoder::parseHeader(WavFormat &format, const unsigned char *rawData,
+                                 size_t rawSize) {
         // Validate RIFF header
         if (memcmp(rawData, "RIFF", 4) != 0 || memcmp(rawData + 8, "WAVE", 4) != 0) {
             TRACE("WavDecoder: not a valid WAV file");
-            return;
+            return false;
         }
 
         // Find fmt and data chunks
@@ -102,6 +355,7 @@ namespace soundscape {
 
             if (memcmp(chunkId, "fmt ", 4) == 0 && pos + 8 + chunkSize <= rawSize) {
                 memcpy(&audioFormat, rawData + pos + 8, 2);
+                audioFormat &= 0xFFFF;
                 memcpy(&numChannels, rawData + pos + 10, 2);
                 numChannels &= 0xFFFF;
                 memcpy(&sampleRate, rawData + pos + 12, 4);
@@ -120,27 +374,64 @@ namespace soundscape {
             if (chunkSize % 2 != 0) pos++; // pad byte
         }
 
-        if (!dataChunk || sampleRate == 0 || numChannels == 0 || bitsPerSample == 0) {
+        if (!dataChunk || sampleRate == 0 || numChannels == 0 || bitsPerSample < 8) {
             TRACE("WavDecoder: incomplete WAV (sr=%d ch=%d bits=%d data=%p)",
                   sampleRate, numChannels, bitsPerSample, dataChunk);
-            return;
+            return false;
         }
 
-        out.originalSampleRate = sampleRate;
-        out.sampleRate = sampleRate;
+        format.audioFormat = audioFormat;
+        format.numChannels = numChannels;
+        format.bitsPerSample = bitsPerSample;
+        format.sampleRate = sampleRate;
+        format.samples = dataChunk;
 
         // Calculate number of sample frames
+        int bytesPerFrame = (bitsPerSample / 8) * numChannels;
+        format.numFrames = static_cast<int>(dataSize / bytesPerFrame);
+        return true;
+    }
+
+    void WavDecoder::convertToMono(const WavFormat &format, int firstFrame, int numFrames,
+                                   float *out) {
+        int bitsPerSample = format.bitsPerSample;
+        int numChannels = format.numChannels;
         int bytesPerSample = bitsPerSample / 8;
         int bytesPerFrame = bytesPerSample * numChannels;
-        int numFrames = static_cast<int>(dataSize / bytesPerFrame);
-
-        out.samples.resize(numFrames);
+        const unsigned char *data =
+                format.samples + static_cast<size_t>(firstFrame) * bytesPerFrame;
+
+        // The layouts the app's assets use have kernels, which read the samples in place as long
+        // as they're aligned
+        bool aligned = reinterpret_cast<uintptr_t>(data) % bytesPerSample == 0;
+        if (aligned && numChannels <= 2) {
+            if (bitsPerSample == 8 && numChannels == 1) {
+                kernels::convertPcm8(out, data, numFrames);
+                return;
+            }
+            if (bitsPerSample == 16) {
+                const auto *pcm = reinterpret_cast<const int16_t *>(data);
+                if (numChannels == 1)
+                    kernels::convertPcm16(out, pcm, numFrames);
+                else
+                    kernels::downmixPcm16Stereo(out, pcm, numFrames);
+                return;
+            }
+            if (bitsPerSample == 32 && format.audioFormat == 3) {
+                const auto *samples = reinterpret_cast<const float *>(data);
+                if (numChannels == 1)
+                    memcpy(out, samples, numFrames * sizeof(float));
+                else
+                    kernels::downmixStereo(out, samples, numFrames);
+                return;
+            }
+        }
 
         // Convert to mono float32
         for (int i = 0; i < numFrames; i++) {
             float sample = 0.0f;
             for (int ch = 0; ch < numChannels; ch++) {
-                const unsigned char *src = dataChunk + (i * bytesPerFrame) + (ch * bytesPerSample);
+                const unsigned char *src = data + (i * bytesPerFrame) + (ch * bytesPerSample);
 
                 float chSample = 0.0f;
                 if (bitsPerSample == 8) {
@@ -150,7 +441,7 @@ namespace soundscape {
                     int16_t s;
                     memcpy(&s, src, 2);
                     chSample = static_cast<float>(s) / 32768.0f;
-                } else if (bitsPerSample == 32 && audioFormat == 3) {
+                } else if (bitsPerSample == 32 && format.audioFormat == 3) {
                     // IEEE float
                     memcpy(&chSample, src, 4);
                 } else if (bitsPerSample == 32) {
@@ -166,34 +457,27 @@ namespace soundscape {
                 }
                 sample += chSample;
             }
-            out.samples[i] = sample / static_cast<float>(numChannels); // downmix
+            out[i] = sample / static_cast<float>(numChannels); // downmix
         }
     }
 
-    void WavDecoder::resampleTo(DecodedWav &out, int targetRate) {
-        if (out.sampleRate == targetRate || out.samples.empty()) return;
+    void WavDecoder::resampleTo(std::vector<float> &samples, int sourceRate, int targetRate,
+                                const PolyphaseFilter &filter, WorkStealingPool *pool) {
+        if (sourceRate == targetRate || samples.empty()) return;
 
-        double ratio = static_cast<double>(out.sampleRate) / static_cast<double>(targetRate);
-        int outFrames = static_cast<int>(static_cast<double>(out.samples.size()) / ratio);
+        double ratio = static_cast<double>(sourceRate) / static_cast<double>(targetRate);
+        int outFrames = static_cast<int>(static_cast<double>(samples.size()) / ratio);
 
         std::vector<float> resampled(outFrames);
 
-        for (int i = 0; i < outFrames; i++) {
-            double srcPos = i * ratio;
-            int srcIdx = static_cast<int>(srcPos);
-            float frac = static_cast<float>(srcPos - srcIdx);
-
-            if (srcIdx + 1 < static_cast<int>(out.samples.size())) {
-                resampled[i] = out.samples[srcIdx] * (1.0f - frac) + out.samples[srcIdx + 1] * frac;
-            } else if (srcIdx < static_cast<int>(out.samples.size())) {
-                resampled[i] = out.samples[srcIdx];
-            } else {
-                resampled[i] = 0.0f;
-            }
-        }
+        // Each chunk reads the samples either side of it, so they stay in place until all are
+        // done
+        int inFrames = static_cast<int>(samples.size());
+        forEachChunk(pool, outFrames, [&](int first, int count) {
+            filter.process(samples.data(), 0, inFrames, resampled.data() + first, first, count);
+        });
 
-        out.samples = std::move(resampled);
-        out.sampleRate = targetRate;
+        samples = std::move(resampled);
     }
 
 } // soundscape
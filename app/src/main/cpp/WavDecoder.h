@@ -1,46 +1,149 @@
 #pragma once
 
-#include <android/asset_manager.h>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
 
+#include "AssetSource.h"
+#include "PolyphaseFilter.h"
+#include "WorkStealingPool.h"
+
 namespace soundscape {
 
     class WavDecoder {
     public:
-        // Load WAV from AAssetManager. If targetRate > 0, resample to that rate.
+        // Load WAV from the asset source. If targetRate > 0, resample to that rate with a
+        // PolyphaseFilter of the current resample quality.
         //
         // Decoded PCM data is cached in memory, keyed by (asset path, targetRate). Earcons and
         // beacon segments are re-created from their asset on every playback, and without this
         // cache each of those calls re-opens and re-parses the WAV file while holding the
-        // engine's lock - AAssetManager_open serializes on a process-wide native mutex, so
-        // concurrent loads from multiple threads can stall that lock for long enough to ANR the
-        // main thread.
-        WavDecoder(AAssetManager *mgr, const std::string &path, int targetRate = 0);
+        // engine's lock - on Android AAssetManager_open serializes on a process-wide native mutex,
+        // so concurrent loads from multiple threads can stall that lock for long enough to ANR
+        // the main thread. Each asset and rate is decoded once, however many threads ask for it
+        // at the same time.
+        //
+        // With mapped playback, an asset which can be mapped (one stored uncompressed in the APK,
+        // or any file on a host) and is already at the target rate isn't decoded at all. read()
+        // converts straight from the mapping instead, so the samples cost no heap and their pages
+        // are only resident whilst the page cache holds them. Otherwise the decoded samples are
+        // cached, resampled, in the most compact format which holds them, usually 16 bit, and
+        // read() expands them to float.
+        WavDecoder(AssetSource *assets, const std::string &path, int targetRate = 0);
+
+        // Copy up to numFrames mono float frames at the target rate, starting at startFrame.
+        // Returns the number of frames copied, which is fewer at the end of the data. Doesn't
+        // allocate or lock, so is safe on the audio thread.
+        int read(float *out, int startFrame, int numFrames) const;
 
-        const float *data() const { return m_Data ? m_Data->samples.data() : nullptr; }
-        int numFrames() const { return m_Data ? static_cast<int>(m_Data->samples.size()) : 0; }
+        int numFrames() const { return m_Data ? m_Data->numFrames : 0; }
         int sampleRate() const { return m_SampleRate; }
 
         int originalSampleRate() const { return m_OriginalSampleRate; }
-        bool isValid() const { return m_Data && !m_Data->samples.empty(); }
+        bool isValid() const { return m_Data && m_Data->numFrames > 0; }
+
+        // Whether assets loaded from now on play from a mapping where possible, on by default.
+        // Assets already in the cache aren't affected.
+        static void setMappedPlayback(bool enabled);
+
+        // Resample quality for assets loaded from now on, MEDIUM by default. Assets already in
+        // the cache keep theirs.
+        static void setResampleQuality(ResampleQuality quality);
+
+        // The cache keeps decoded samples up to a budget in bytes, dropping the least recently
+        // used entries beyond it. Entries a WavDecoder still holds are pinned: they count towards
+        // the budget but are never dropped. Mapped assets hold no samples, so count as nothing.
+        static constexpr size_t DEFAULT_CACHE_BUDGET = 8 * 1024 * 1024;
+
+        struct CacheStats {
+            size_t bytes = 0;           // samples held, pinned or not
+            size_t pinnedBytes = 0;
+            size_t budget = 0;
+            int entries = 0;
+            int pinnedEntries = 0;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t joined = 0;        // misses which waited for another thread's decode
+            uint64_t evictions = 0;
+        };
+
+        // Takes effect straight away, dropping entries if the cache is now over budget
+        static void setCacheBudget(size_t bytes);
+
+        // Drop unpinned entries, least recently used first, until at most maxBytes are held. 0
+        // drops every entry not in use, mapped ones included.
+        static void trimCache(size_t maxBytes);
+
+        static CacheStats getCacheStats();
+
+        // Whilst mapped playback is off, decodes are split across a process-wide pool of this
+        // many workers, in chunks, and BeaconBufferGroup loads its assets across it. 0 decodes on
+        // the calling thread alone, and the default, -1, is one fewer than the cores. The pool is
+        // created the first time it's needed, after which the number of workers is fixed.
+        static void setDecodeThreads(int threads);
+
+        // The pool, or null when loads run on the calling thread alone. With mapped playback on,
+        // only assets at another rate are decoded, so there's no pool and they load serially.
+        static WorkStealingPool *decodePool();
+
+        // Load an asset into the cache without playing it, as AssetPrefetcher does, faulting a
+        // mapped one's pages in. Blocks until it's loaded.
+        static void prefetch(AssetSource *assets, const std::string &path, int targetRate = 0);
 
     private:
+        class Cache;
+        // Frames per task when a decode is split across the pool. Small enough for a one second
+        // asset to use several cores, large enough that each task outweighs handing it out.
+        static constexpr int DECODE_CHUNK = 16384;
+
+        struct WavFormat {
+            int audioFormat = 0;        // 1 = PCM, 3 = IEEE float
+            int numChannels = 0;
+            int bitsPerSample = 0;
+            int sampleRate = 0;
+            const unsigned char *samples = nullptr;   // start of the data chunk
+            int numFrames = 0;
+        };
+
         struct DecodedWav {
-            std::vector<float> samples;  // mono float32 samples
+            std::vector<unsigned char> storage; // mono samples at sampleRate, if decoded
+            std::unique_ptr<AssetData> mapping; // the asset, if played from a mapping
+            WavFormat format;                   // points into storage or mapping
+            int numFrames = 0;                  // at sampleRate
             int sampleRate = 0;
             int originalSampleRate = 0;
         };
 
-        static std::shared_ptr<const DecodedWav> loadCached(AAssetManager *mgr,
+        static Cache &cache();
+
+        static std::shared_ptr<const DecodedWav> loadCached(AssetSource *assets,
                                                               const std::string &path,
-                                                              int targetRate);
-        static std::shared_ptr<DecodedWav> decode(AAssetManager *mgr, const std::string &path,
-                                                    int targetRate);
+                                                              int targetRate, bool mapped,
+                                                              ResampleQuality quality);
+        static std::shared_ptr<DecodedWav> decode(AssetSource *assets, const std::string &path,
+                                                    int targetRate, bool mapped,
+                                                    ResampleQuality quality);
+
+        static bool parseHeader(WavFormat &format, const unsigned char *rawData, size_t rawSize);
+
+        // Convert numFrames frames from firstFrame onwards to mono float
+        static void convertToMono(const WavFormat &format, int firstFrame, int numFrames,
+                                  float *out);
+
+        // Keep decoded samples as 8 bit if they're exactly the source's mono 8 bit samples,
+        // otherwise as 16 bit if they came from 16 bits or fewer, and as float only if wider
+        static void storeCompact(DecodedWav &out, const std::vector<float> &samples,
+                                 const WavFormat &source, bool resampled,
+                                 WorkStealingPool *pool);
+
+        static void resampleTo(std::vector<float> &samples, int sourceRate, int targetRate,
+                               const PolyphaseFilter &filter, WorkStealingPool *pool);
 
-        static void parseWav(DecodedWav &out, const unsigned char *rawData, size_t rawSize);
-        static void resampleTo(DecodedWav &out, int targetRate);
+        // Call fn(first, count) over [0, total) in chunks of DECODE_CHUNK, across pool if set
+        static void forEachChunk(WorkStealingPool *pool, int total,
+                                 const std::function<void(int, int)> &fn);
 
         // Strip "file:///android_asset/" prefix if present
         static std::string stripAssetPrefix(const std::string &path);
@@ -0,0 +1,161 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+namespace soundscape {
+
+    namespace {
+        // Which pool and worker the current thread is, if any
+        thread_local const WorkStealingPool *t_Pool = nullptr;
+        thread_local int t_Worker = -1;
+
+        constexpr int MAX_THREADS = 7;
+    } // namespace
+
+    WorkStealingPool::WorkStealingPool(int threads) {
+        if (threads <= 0)
+            threads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) - 1,
+                                 1, MAX_THREADS);
+
+        for (int i = 0; i < threads; i++)
+            m_Workers.push_back(std::make_unique<Worker>());
+        for (int i = 0; i < threads; i++)
+            m_Workers[i]->thread = std::thread(&WorkStealingPool::run, this, i);
+    }
+
+    WorkStealingPool::~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            m_Quit = true;
+        }
+        m_Wake.notify_all();
+        for (auto &worker: m_Workers)
+            worker->thread.join();
+    }
+
+    void WorkStealingPool::parallelFor(WorkStealingPool *pool, int count,
+                                       const std::function<void(int)> &fn) {
+        if (pool && count > 1) {
+            pool->parallelFor(count, fn);
+            return;
+        }
+        for (int i = 0; i < count; i++)
+            fn(i);
+    }
+
+    void WorkStealingPool::parallelFor(int count, const std::function<void(int)> &fn) {
+        if (count <= 0)
+            return;
+
+        Group group;
+        group.fn = &fn;
+        group.remaining = count;
+
+        // A worker keeps its tasks for itself until others steal them, anyone else deals them
+        // out. The caller runs the first one, so it isn't queued.
+        int self = t_Pool == this ? t_Worker : -1;
+        for (int i = 1; i < count; i++) {
+            int target = self >= 0 ? self : static_cast<int>(m_NextWorker++ % m_Workers.size());
+            std::lock_guard<std::mutex> guard(m_Workers[target]->mutex);
+            m_Workers[target]->tasks.push_back({&group, i});
+        }
+        {
+            // Under the lock so that a worker can't check it and then miss the wake up
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            m_Queued += count - 1;
+        }
+        m_Wake.notify_all();
+
+        runTask({&group, 0});
+
+        // Help out until there's nothing left to take, then wait for the rest to finish. Only
+        // this loop's own tasks are taken: another's could wait on a load which is waiting on
+        // this one.
+        while (group.remaining > 0 && runOneOf(group, self)) {
+        }
+        std::unique_lock<std::mutex> lock(group.mutex);
+        group.done.wait(lock, [&group] { return group.remaining == 0; });
+    }
+
+    void WorkStealingPool::runTask(const Task &task) {
+        Group *group = task.group;
+        (*group->fn)(task.index);
+
+        // The last task wakes the caller, under the group's lock so that the group can't be
+        // destroyed before notify returns
+        std::lock_guard<std::mutex> guard(group->mutex);
+        if (--group->remaining == 0)
+            group->done.notify_all();
+    }
+
+    bool WorkStealingPool::runOne(int self) {
+        Task task{};
+        bool found = false;
+        if (self >= 0) {
+            Worker &own = *m_Workers[self];
+            std::lock_guard<std::mutex> guard(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                found = true;
+            }
+        }
+
+        int workers = static_cast<int>(m_Workers.size());
+        int start = self >= 0 ? self + 1 : static_cast<int>(m_NextWorker % workers);
+        for (int i = 0; i < workers && !found; i++) {
+            Worker &victim = *m_Workers[(start + i) % workers];
+            std::lock_guard<std::mutex> guard(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                found = true;
+            }
+        }
+
+        if (!found)
+            return false;
+        --m_Queued;
+        runTask(task);
+        return true;
+    }
+
+    bool WorkStealingPool::runOneOf(Group &group, int self) {
+        Task task{};
+        bool found = false;
+        int workers = static_cast<int>(m_Workers.size());
+        int start = std::max(self, 0);
+        for (int i = 0; i < workers && !found; i++) {
+            Worker &worker = *m_Workers[(start + i) % workers];
+            std::lock_guard<std::mutex> guard(worker.mutex);
+            auto it = std::find_if(worker.tasks.rbegin(), worker.tasks.rend(),
+                                   [&group](const Task &t) { return t.group == &group; });
+            if (it != worker.tasks.rend()) {
+                task = *it;
+                worker.tasks.erase(std::next(it).base());
+                found = true;
+            }
+        }
+
+        if (!found)
+            return false;
+        --m_Queued;
+        runTask(task);
+        return true;
+    }
+
+    void WorkStealingPool::run(int self) {
+        t_Pool = this;
+        t_Worker = self;
+        while (true) {
+            if (runOne(self))
+                continue;
+
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Wake.wait(lock, [this] { return m_Quit || m_Queued > 0; });
+            if (m_Quit)
+                return;
+        }
+    }
+
+} // soundscape
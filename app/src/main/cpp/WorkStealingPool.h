@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace soundscape {
+
+    // A few worker threads for splitting up CPU bound loading work, such as decoding a beacon's
+    // assets. Each worker has its own queue of tasks: it takes the newest of its own, and when
+    // that's empty steals the oldest of another's, so work spreads out without every thread
+    // contending on one queue.
+    //
+    // parallelFor can be called from inside a task. The thread calling it runs its own loop's
+    // tasks whilst it waits, so nested loops (a bank's assets, then each asset's chunks) use every
+    // thread. It never takes another loop's task, which might wait on something waiting on it,
+    // so loads which wait for each other's decodes can't deadlock.
+    class WorkStealingPool {
+    public:
+        // threads <= 0 picks one fewer than the number of cores, as the caller works too
+        explicit WorkStealingPool(int threads = 0);
+
+        // Waits for the tasks already running, which mustn't be given more work
+        ~WorkStealingPool();
+
+        int threadCount() const { return static_cast<int>(m_Workers.size()); }
+
+        // Call fn(i) for each i in [0, count) across the workers and the calling thread, and
+        // return once they've all finished
+        void parallelFor(int count, const std::function<void(int)> &fn);
+
+        // As above, or serially on the calling thread if pool is null
+        static void parallelFor(WorkStealingPool *pool, int count,
+                                const std::function<void(int)> &fn);
+
+    private:
+        // One parallelFor call
+        struct Group {
+            const std::function<void(int)> *fn;
+            std::atomic<int> remaining;
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+
+        struct Task {
+            Group *group;
+            int index;
+        };
+
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        // Run one task, the newest of worker self's own or else one stolen from another.
+        // self < 0 for threads outside the pool, which only steal. False if there was none.
+        bool runOne(int self);
+
+        // Run one of group's tasks which no thread has taken yet. False if there was none.
+        bool runOneOf(Group &group, int self);
+
+        static void runTask(const Task &task);
+
+        void run(int self);
+
+        std::vector<std::unique_ptr<Worker>> m_Workers;
+        std::atomic<unsigned> m_NextWorker{0};
+
+        // Tasks queued and not yet taken, for idle workers to sleep on
+        std::mutex m_Mutex;
+        std::condition_variable m_Wake;
+        std::atomic<int> m_Queued{0};
+        bool m_Quit = false;
+    };
+
+} // soundscape
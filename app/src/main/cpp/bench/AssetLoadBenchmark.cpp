@@ -0,0 +1,193 @@
+//
+// Measures how long a beacon takes to start: from the beacon type being chosen to the first
+// block of its audio, which is what the user waits for after launching the app. Each case starts
+// from an empty asset cache (the files themselves stay in the page cache, so this is decode cost
+// rather than storage), and is run with assets both decoded and mapped:
+//
+//   cold       the beacon decodes its own assets, as without prefetching
+//   prefetch   the assets are prefetched when the type is chosen and the beacon is created
+//              straight away, so it waits on decodes already under way
+//   gap N      as prefetch, with N ms between choosing the type and creating the beacon, as
+//              there is whilst the app waits for its first location
+//
+// It then has several threads create the same beacon at once, and reports how many decodes that
+// took; with single-flight decoding it's one per asset.
+//
+// Last it times building beacon banks from decoded assets, with the cache empty, on the calling
+// thread alone and then across WavDecoder's decode pool. --threads sets the pool's workers, by
+// default one fewer than the cores.
+//
+//   asset-load-benchmark [--assets DIR] [--rate HZ] [--runs N] [--threads N]
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AssetPrefetcher.h"
+#include "AssetSource.h"
+#include "AudioBeaconBuffer.h"
+#include "WavDecoder.h"
+#include "WorkStealingPool.h"
+
+using namespace soundscape;
+
+namespace {
+
+    const BeaconDescriptor BEACON = {
+            "Current",
+            6,
+            {
+                    {"file:///android_asset/Sounds/Current_A+.wav", 15.0},
+                    {"file:///android_asset/Sounds/Current_A.wav", 55.0},
+                    {"file:///android_asset/Sounds/Current_B.wav", 125.0},
+                    {"file:///android_asset/Sounds/Current_Behind.wav", 180.0},
+            }
+    };
+
+    // The longest assets
+    const BeaconDescriptor VERY_SLOW = {
+            "Mallet Very Slow",
+            18,
+            {
+                    {"file:///android_asset/Sounds/Mallet_Very_Slow_A+.wav", 15.0},
+                    {"file:///android_asset/Sounds/Mallet_Very_Slow_A.wav", 55.0},
+                    {"file:///android_asset/Sounds/Mallet_Very_Slow_Behind.wav", 180.0}
+            }
+    };
+
+    struct NoEof : public SourceEofListener {
+        void Eof() override {}
+    };
+
+    // As AudioEngine::SetBeaconType queues them
+    void prefetchBeacon(AssetPrefetcher &prefetcher, int rate) {
+        prefetcher.prefetch(BeaconBufferGroup::OUTRO_ASSET, rate, true);
+        for (auto it = BEACON.m_Beacons.rbegin(); it != BEACON.m_Beacons.rend(); ++it)
+            prefetcher.prefetch(it->m_Filename, rate, true);
+        prefetcher.prefetch(BeaconBufferGroup::INTRO_ASSET, rate, true);
+    }
+
+    // Milliseconds from the type being chosen to the beacon's first block. gapMs < 0 doesn't
+    // prefetch at all.
+    double timeToFirstBlock(AssetSource &assets, int rate, int gapMs) {
+        WavDecoder::trimCache(0);
+        AssetPrefetcher prefetcher(&assets);
+        auto listener = std::make_shared<NoEof>();
+        std::vector<float> block(1024);
+
+        auto start = std::chrono::steady_clock::now();
+        if (gapMs >= 0)
+            prefetchBeacon(prefetcher, rate);
+        if (gapMs > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(gapMs));
+        auto created = std::chrono::steady_clock::now();
+
+        BeaconBufferGroup beacon(&assets, &BEACON, listener, 0.0, rate);
+        beacon.readPcm(block.data(), static_cast<int>(block.size()));
+        auto end = std::chrono::steady_clock::now();
+
+        // Time spent in the gap would have been spent waiting for a location anyway
+        auto waited = end - (gapMs > 0 ? created : start);
+        return std::chrono::duration<double, std::milli>(waited).count();
+    }
+
+    // Milliseconds to build a bank, from an empty cache
+    double timeBankBuild(AssetSource &assets, const BeaconDescriptor &descriptor, int rate) {
+        WavDecoder::trimCache(0);
+        auto listener = std::make_shared<NoEof>();
+        auto start = std::chrono::steady_clock::now();
+        BeaconBufferGroup beacon(&assets, &descriptor, listener, 0.0, rate);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    double median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string assetsDir = SOUNDSCAPE_ASSETS_DIR;
+    int rate = 48000;
+    int runs = 21;
+    int threads = -1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--assets" && i + 1 < argc)
+            assetsDir = argv[++i];
+        else if (arg == "--rate" && i + 1 < argc)
+            rate = atoi(argv[++i]);
+        else if (arg == "--runs" && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--assets DIR] [--rate HZ] [--runs N] [--threads N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    FileAssetSource assets(assetsDir);
+    WavDecoder::setDecodeThreads(threads);
+    const int gaps[] = {-1, 0, 20, 100};
+
+    printf("Time to first beacon block at %d Hz, median of %d runs (ms)\n", rate, runs);
+    printf("%-10s %10s %10s\n", "", "decoded", "mapped");
+    for (int gap: gaps) {
+        double results[2];
+        for (int mapped = 0; mapped < 2; mapped++) {
+            WavDecoder::setMappedPlayback(mapped != 0);
+            std::vector<double> times;
+            for (int run = 0; run < runs; run++)
+                times.push_back(timeToFirstBlock(assets, rate, gap));
+            results[mapped] = median(times);
+        }
+        std::string name = gap < 0 ? "cold" : gap == 0 ? "prefetch" : "gap " + std::to_string(gap);
+        printf("%-10s %10.2f %10.2f\n", name.c_str(), results[0], results[1]);
+    }
+
+    // Several threads all creating the same beacon from a cold cache
+    const int creatorCount = 4;
+    WavDecoder::setMappedPlayback(false);
+    WavDecoder::trimCache(0);
+    auto before = WavDecoder::getCacheStats();
+    std::vector<std::thread> creators;
+    for (int t = 0; t < creatorCount; t++) {
+        creators.emplace_back([&assets, rate] {
+            auto listener = std::make_shared<NoEof>();
+            BeaconBufferGroup beacon(&assets, &BEACON, listener, 0.0, rate);
+        });
+    }
+    for (auto &creator: creators)
+        creator.join();
+    auto after = WavDecoder::getCacheStats();
+    printf("%d threads creating the same beacon: %llu decodes for %zu assets, %llu waited on "
+           "another thread's decode\n", creatorCount,
+           static_cast<unsigned long long>(after.misses - before.misses),
+           BEACON.m_Beacons.size() + 2,
+           static_cast<unsigned long long>(after.joined - before.joined));
+
+    printf("Bank build from decoded assets, median of %d runs (ms)\n", runs);
+    printf("%-18s %10s %10s\n", "", "serial", "pool");
+    for (const BeaconDescriptor *descriptor: {&BEACON, &VERY_SLOW}) {
+        double results[2];
+        for (int pooled = 0; pooled < 2; pooled++) {
+            WavDecoder::setDecodeThreads(pooled ? threads : 0);
+            std::vector<double> times;
+            for (int run = 0; run < runs; run++)
+                times.push_back(timeBankBuild(assets, *descriptor, rate));
+            results[pooled] = median(times);
+        }
+        printf("%-18s %10.2f %10.2f\n", descriptor->m_Name.c_str(), results[0], results[1]);
+    }
+    WorkStealingPool *pool = WavDecoder::decodePool();
+    printf("Pool of %d workers plus the calling thread\n", pool ? pool->threadCount() : 0);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace soundscape::bench {
+
+    // Counts CPU cycles for the calling thread using perf_event_open where the kernel allows it
+    // (Linux and most Android builds with perf_event_paranoid <= 2). When it doesn't, only wall
+    // clock time is reported.
+    class CycleCounter {
+    public:
+        CycleCounter() {
+#if defined(__linux__)
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            m_Fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+
+        ~CycleCounter() {
+            if (m_Fd >= 0)
+                close(m_Fd);
+        }
+
+        bool available() const { return m_Fd >= 0; }
+
+        void start() {
+#if defined(__linux__)
+            if (m_Fd >= 0) {
+                ioctl(m_Fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_Fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+            m_Start = std::chrono::steady_clock::now();
+        }
+
+        // Returns elapsed nanoseconds; cycles is set to 0 if the counter isn't available
+        double stop(uint64_t &cycles) {
+            auto end = std::chrono::steady_clock::now();
+            cycles = 0;
+#if defined(__linux__)
+            if (m_Fd >= 0) {
+                ioctl(m_Fd, PERF_EVENT_IOC_DISABLE, 0);
+                long long count = 0;
+                if (read(m_Fd, &count, sizeof(count)) == sizeof(count))
+                    cycles = static_cast<uint64_t>(count);
+            }
+#endif
+            return std::chrono::duration<double, std::nano>(end - m_Start).count();
+        }
+
+    private:
+        int m_Fd = -1;
+        std::chrono::steady_clock::time_point m_Start;
+    };
+
+    // Keeps the optimiser from discarding a benchmark's result
+    inline void doNotOptimize(const void *p) {
+        asm volatile("" : : "r"(p) : "memory");
+    }
+
+} // soundscape::bench
@@ -0,0 +1,130 @@
+//
+// Microbenchmark for the mixer's inner loops. Reports time and (where perf counters are
+// available) CPU cycles per frame for each kernel against a plain scalar loop, at a typical
+// callback size. Run it on the device with:
+//
+//   adb push mix-kernels-benchmark /data/local/tmp && adb shell /data/local/tmp/mix-kernels-benchmark
+//
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "MixKernels.h"
+#include "BenchUtils.h"
+
+using namespace soundscape;
+
+namespace {
+
+    constexpr int FRAMES = 1024;
+    constexpr int ITERATIONS = 20000;
+
+    void report(const char *name, int framesPerCall, const std::function<void()> &fn) {
+        bench::CycleCounter counter;
+
+        // Warm caches and branch predictors
+        for (int i = 0; i < 100; i++)
+            fn();
+
+        counter.start();
+        for (int i = 0; i < ITERATIONS; i++)
+            fn();
+        uint64_t cycles;
+        double ns = counter.stop(cycles);
+
+        double frames = static_cast<double>(framesPerCall) * ITERATIONS;
+        if (counter.available())
+            printf("  %-32s %8.3f ns/frame %8.3f cycles/frame\n", name, ns / frames,
+                   static_cast<double>(cycles) / frames);
+        else
+            printf("  %-32s %8.3f ns/frame\n", name, ns / frames);
+    }
+
+    float maxDifference(const std::vector<float> &a, const std::vector<float> &b) {
+        float diff = 0.0f;
+        for (size_t i = 0; i < a.size(); i++)
+            diff = std::max(diff, std::fabs(a[i] - b[i]));
+        return diff;
+    }
+
+} // namespace
+
+int main() {
+    std::vector<float> mono(FRAMES);
+    std::vector<float> left(FRAMES);
+    std::vector<float> right(FRAMES);
+    std::vector<float> stereoIn(FRAMES * 2);
+    std::vector<float> out(FRAMES * 2);
+    std::vector<float> reference(FRAMES * 2);
+
+    srand(1);
+    auto randomSample = []() { return static_cast<float>(rand()) / RAND_MAX * 2.4f - 1.2f; };
+    std::generate(mono.begin(), mono.end(), randomSample);
+    std::generate(left.begin(), left.end(), randomSample);
+    std::generate(right.begin(), right.end(), randomSample);
+    std::generate(stereoIn.begin(), stereoIn.end(), randomSample);
+
+    printf("Mix kernels: %s, %d frames per call\n", kernels::implementationName(), FRAMES);
+
+    // Check the vector kernels against the scalar loops before timing them
+    std::fill(out.begin(), out.end(), 0.25f);
+    std::fill(reference.begin(), reference.end(), 0.25f);
+    kernels::accumulateWithGain(out.data(), stereoIn.data(), 0.7f, FRAMES * 2);
+    for (int i = 0; i < FRAMES * 2; i++)
+        reference[i] += stereoIn[i] * 0.7f;
+    printf("  max difference from scalar reference: %g\n", maxDifference(out, reference));
+
+    std::vector<float> planar(FRAMES * 2, 0.25f);
+    kernels::accumulateMonoPlanar(planar.data(), planar.data() + FRAMES, mono.data(), 0.3f, 0.9f,
+                                  FRAMES);
+    kernels::accumulateMonoPlanar(planar.data(), planar.data() + FRAMES, stereoIn.data(), 0.7f,
+                                  0.7f, FRAMES);
+    kernels::interleaveClamped(out.data(), planar.data(), planar.data() + FRAMES, FRAMES);
+    for (int i = 0; i < FRAMES; i++) {
+        reference[i * 2] = std::clamp(0.25f + mono[i] * 0.3f + stereoIn[i] * 0.7f, -1.0f, 1.0f);
+        reference[i * 2 + 1] = std::clamp(0.25f + mono[i] * 0.9f + stereoIn[i] * 0.7f, -1.0f,
+                                          1.0f);
+    }
+    printf("  planar max difference from scalar reference: %g\n",
+           maxDifference(out, reference));
+
+    report("accumulateWithGain (scalar)", FRAMES, [&]() {
+        for (int i = 0; i < FRAMES * 2; i++)
+            out[i] += stereoIn[i] * 0.5f;
+        bench::doNotOptimize(out.data());
+    });
+    report("accumulateWithGain", FRAMES, [&]() {
+        kernels::accumulateWithGain(out.data(), stereoIn.data(), 0.5f, FRAMES * 2);
+        bench::doNotOptimize(out.data());
+    });
+
+    report("accumulateMonoPlanar (scalar)", FRAMES, [&]() {
+        for (int i = 0; i < FRAMES; i++) {
+            planar[i] += mono[i] * 0.3f;
+            planar[FRAMES + i] += mono[i] * 0.6f;
+        }
+        bench::doNotOptimize(planar.data());
+    });
+    report("accumulateMonoPlanar", FRAMES, [&]() {
+        kernels::accumulateMonoPlanar(planar.data(), planar.data() + FRAMES, mono.data(), 0.3f,
+                                      0.6f, FRAMES);
+        bench::doNotOptimize(planar.data());
+    });
+
+    report("interleaveClamped (scalar)", FRAMES, [&]() {
+        for (int i = 0; i < FRAMES; i++) {
+            out[i * 2] = std::clamp(left[i], -1.0f, 1.0f);
+            out[i * 2 + 1] = std::clamp(right[i], -1.0f, 1.0f);
+        }
+        bench::doNotOptimize(out.data());
+    });
+    report("interleaveClamped", FRAMES, [&]() {
+        kernels::interleaveClamped(out.data(), left.data(), right.data(), FRAMES);
+        bench::doNotOptimize(out.data());
+    });
+
+    return 0;
+}
@@ -0,0 +1,339 @@
+//
+// Renders a busy scene through the mixer offline, as fast as possible, and reports the real-time
+// factor, per-callback time percentiles and peak memory. Callbacks which take page faults, such as
+// the first to read each page of a mapped asset, are reported apart as well. The stereo mix can be
+// written to a WAV file so that output can be compared between builds.
+//
+//   offline-render [--assets DIR] [--seconds N] [--block FRAMES] [--callback FRAMES]
+//                  [--rate HZ] [--order 0|1|2] [--pan] [--convolution] [--decoded]
+//                  [--cache-budget KIB] [--wav out.wav]
+//
+// --block is the size the spatializer processes in and --callback the size the output asks for,
+// which defaults to the same. --convolution uses the built in convolution renderer rather than
+// Steam Audio. --decoded decodes each asset into memory when it loads instead of playing it from a
+// mapping, for comparing memory use, and --cache-budget sets the decoded asset cache's budget.
+//
+// The scene uses the app's own sources and assets: localized beacons around the listener, a
+// proximity beacon, and relative and compass positioned earcons and text to speech which come
+// and go, whilst the listener turns at 90 degrees per second. Text to speech is fed with a
+// synthesised voice through a socket, as the app's TTS engine does, and read by a TtsIngest
+// which is polled after each block rather than running on its own thread.
+//
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "AudioBeaconBuffer.h"
+#include "AudioMixer.h"
+#include "OfflineRenderer.h"
+
+using namespace soundscape;
+
+namespace {
+
+    const BeaconDescriptor BEACON = {
+            "Current",
+            6,
+            {
+                    {"file:///android_asset/Sounds/Current_A+.wav", 15.0},
+                    {"file:///android_asset/Sounds/Current_A.wav", 55.0},
+                    {"file:///android_asset/Sounds/Current_B.wav", 125.0},
+                    {"file:///android_asset/Sounds/Current_Behind.wav", 180.0},
+            }
+    };
+
+    const BeaconDescriptor PROXIMITY = {
+            "Proximity",
+            36,
+            {
+                    {"file:///android_asset/Sounds/Proximity_Close.wav", 0},
+                    {"file:///android_asset/Sounds/Proximity_Far.wav", 0},
+            }
+    };
+
+    const char *EARCONS[] = {
+            "file:///android_asset/Sounds/SS_beaconFound2_48k.wav",
+            "file:///android_asset/Sounds/SS_streetFound_48k.wav",
+    };
+
+    constexpr int TTS_SAMPLE_RATE = 22050;
+
+    struct EofFlag : public SourceEofListener {
+        void Eof() override { eof = true; }
+
+        std::atomic<bool> eof{false};
+    };
+
+    struct SceneSource {
+        std::shared_ptr<EofFlag> listener;
+        std::unique_ptr<BeaconAudioSource> source;
+    };
+
+    // Queue a second of 16 bit "speech" on a socket and close the writing end, so that the TTS
+    // source reads it all and then sees EOF. Returns the reading end, or -1 on failure.
+    int synthesiseSpeech(int utterance) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+            return -1;
+        int bufferSize = TTS_SAMPLE_RATE * 4;
+        setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+        // A buzzy fundamental with a syllable rate envelope
+        std::vector<int16_t> pcm(TTS_SAMPLE_RATE);
+        double f0 = 110.0 + 20.0 * (utterance % 4);
+        for (size_t i = 0; i < pcm.size(); i++) {
+            double t = static_cast<double>(i) / TTS_SAMPLE_RATE;
+            double envelope = 0.5 - 0.5 * cos(2.0 * M_PI * 4.0 * t);
+            double voice = 0.0;
+            for (int harmonic = 1; harmonic <= 8; harmonic++)
+                voice += sin(2.0 * M_PI * f0 * harmonic * t) / harmonic;
+            pcm[i] = static_cast<int16_t>(6000.0 * envelope * voice);
+        }
+
+        const auto *data = reinterpret_cast<const char *>(pcm.data());
+        size_t remaining = pcm.size() * sizeof(int16_t);
+        while (remaining > 0) {
+            ssize_t written = write(fds[1], data, remaining);
+            if (written <= 0)
+                break;
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        close(fds[1]);
+        return fds[0];
+    }
+
+    struct Options {
+        std::string assets = SOUNDSCAPE_ASSETS_DIR;
+        double seconds = 60.0;
+        int block = 1024;
+        int callback = 0;
+        int rate = 48000;
+        int order = 0;
+        bool pan = false;
+        bool convolution = false;
+        bool decoded = false;
+        long cacheBudgetKb = -1;
+        std::string wav;
+    };
+
+    bool parseOptions(int argc, char **argv, Options &options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = (i + 1 < argc);
+            if (arg == "--assets" && hasValue)
+                options.assets = argv[++i];
+            else if (arg == "--seconds" && hasValue)
+                options.seconds = atof(argv[++i]);
+            else if (arg == "--block" && hasValue)
+                options.block = atoi(argv[++i]);
+            else if (arg == "--callback" && hasValue)
+                options.callback = atoi(argv[++i]);
+            else if (arg == "--rate" && hasValue)
+                options.rate = atoi(argv[++i]);
+            else if (arg == "--order" && hasValue)
+                options.order = atoi(argv[++i]);
+            else if (arg == "--wav" && hasValue)
+                options.wav = argv[++i];
+            else if (arg == "--pan")
+                options.pan = true;
+            else if (arg == "--convolution")
+                options.convolution = true;
+            else if (arg == "--cache-budget" && hasValue)
+                options.cacheBudgetKb = atol(argv[++i]);
+            else if (arg == "--decoded")
+                options.decoded = true;
+            else
+                return false;
+        }
+        if (options.callback <= 0)
+            options.callback = options.block;
+        return options.seconds > 0.0 && options.block > 0 && options.rate > 0;
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--assets DIR] [--seconds N] [--block FRAMES] "
+                        "[--callback FRAMES] [--rate HZ] [--order 0|1|2] [--pan] "
+                        "[--convolution] [--decoded] [--cache-budget KIB] [--wav out.wav]\n",
+                argv[0]);
+        return 1;
+    }
+
+    WavDecoder::setMappedPlayback(!options.decoded);
+    if (options.cacheBudgetKb >= 0)
+        WavDecoder::setCacheBudget(static_cast<size_t>(options.cacheBudgetKb) * 1024);
+
+    FileAssetSource assets(options.assets);
+    AudioMixer mixer;
+    mixer.setSpatializerType(options.convolution ? SpatializerType::CONVOLUTION
+                                                 : SpatializerType::STEAM_AUDIO);
+    if (!mixer.startOffline(options.rate, options.block)) {
+        fprintf(stderr, "Failed to initialise the mixer\n");
+        return 1;
+    }
+    mixer.setUseHrtf(!options.pan);
+    mixer.setAmbisonicsOrder(options.order);
+
+    const double listenerLatitude = 55.9533;
+    const double listenerLongitude = -3.1883;
+    std::vector<SceneSource> beacons;
+
+    // Localized beacons roughly 100 m away in each direction
+    const double offsets[][2] = {{0.001, 0.0}, {0.0, 0.0015}, {-0.001, 0.0}, {0.0, -0.0015}};
+    for (const auto &offset: offsets) {
+        SceneSource beacon;
+        beacon.listener = std::make_shared<EofFlag>();
+        beacon.source = std::make_unique<BeaconBufferGroup>(&assets, &BEACON, beacon.listener,
+                                                            0.0, options.rate);
+        beacon.source->category = AudioCategory::BEACON;
+        beacon.source->azimuthMode = AzimuthMode::LOCALIZED;
+        beacon.source->positionLatitude = listenerLatitude + offset[0];
+        beacon.source->positionLongitude = listenerLongitude + offset[1];
+        mixer.addSource(beacon.source.get());
+        beacons.push_back(std::move(beacon));
+    }
+
+    // Proximity beacon, which isn't spatialized
+    SceneSource proximity;
+    proximity.listener = std::make_shared<EofFlag>();
+    proximity.source = std::make_unique<BeaconBufferGroup>(&assets, &PROXIMITY,
+                                                           proximity.listener, 0.0,
+                                                           options.rate);
+    proximity.source->category = AudioCategory::BEACON;
+    proximity.source->isProximityBeacon = true;
+    proximity.source->needsSpatialize = false;
+    proximity.source->UpdateGeometry(0.0, BeaconAudioSource::NEAR_MODE);
+    mixer.addSource(proximity.source.get());
+
+    // Earcons and speech which are added, play out and are removed as the render runs
+    TtsIngest ingest(false);
+    std::vector<SceneSource> transient;
+    int transientCount = 0;
+
+    OfflineRenderer renderer(mixer, options.callback);
+    if (!options.wav.empty() && !renderer.openWav(options.wav)) {
+        fprintf(stderr, "Failed to open %s\n", options.wav.c_str());
+        return 1;
+    }
+
+    renderer.setBlockCallback([&](int64_t frame, int64_t timeNs) {
+        // Update the listener at 10 Hz, as the app does, along with the beacons' choice of asset
+        int updateFrames = options.rate / 10;
+        if (frame % updateFrames < options.callback) {
+            ListenerPose pose;
+            pose.timeNs = timeNs;
+            pose.heading = fmod(90.0 * static_cast<double>(frame) / options.rate, 360.0);
+            pose.latitude = listenerLatitude;
+            pose.longitude = listenerLongitude;
+            mixer.setListenerPose(pose);
+
+            for (auto &beacon: beacons) {
+                float azimuth = azimuthForSource(*beacon.source, pose.heading, pose.latitude,
+                                                 pose.longitude);
+                beacon.source->UpdateGeometry(azimuth * 180.0 / M_PI,
+                                              BeaconAudioSource::DIRECTION_MODE);
+            }
+        }
+
+        // Reap anything which has finished
+        for (auto it = transient.begin(); it != transient.end();) {
+            it->source->UpdateGeometry(0.0, BeaconAudioSource::DIRECTION_MODE);
+            if (it->listener->eof || it->source->isFinished()) {
+                mixer.removeSource(std::move(it->source));
+                it = transient.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // Start a new utterance or earcon every two seconds
+        if (frame % (options.rate * 2) < options.callback) {
+            SceneSource item;
+            item.listener = std::make_shared<EofFlag>();
+            bool speech = (transientCount % 2) == 0;
+            if (speech) {
+                int socket = synthesiseSpeech(transientCount);
+                item.source = std::make_unique<TtsAudioSource>(item.listener, &ingest,
+                                                               socket, TTS_SAMPLE_RATE, 1, 1,
+                                                               options.rate);
+                close(socket);
+                item.source->azimuthMode = AzimuthMode::RELATIVE;
+            } else {
+                std::string earcon = EARCONS[(transientCount / 2) % std::size(EARCONS)];
+                item.source = std::make_unique<EarconSource>(item.listener, earcon,
+                                                             &assets, options.rate);
+                item.source->azimuthMode = AzimuthMode::COMPASS;
+            }
+            item.source->category = AudioCategory::SPEECH;
+            item.source->positionHeading = (transientCount * 45) % 360;
+            mixer.addSource(item.source.get());
+            transient.push_back(std::move(item));
+            ++transientCount;
+        }
+
+        // Read the speech the next block plays
+        ingest.poll();
+    });
+
+    auto stats = renderer.render(options.seconds);
+    printf("Block %d frames (callback %d) at %d Hz, %s, ambisonics order %d, %s assets\n",
+           options.block, options.callback, options.rate,
+           options.pan ? "panned" : mixer.getSpatializer()->getName(), options.order,
+           options.decoded ? "decoded" : "mapped");
+    OfflineRenderer::printStats(stats, stdout);
+
+    // The mixer's own breakdown, which covers the last few seconds of the render
+    auto profile = mixer.getProfile();
+    const char *stageNames[] = {"read", "spatialize", "pan", "mix", "clamp"};
+    const char *categoryNames[] = {"beacons", "speech"};
+    auto printSummary = [](const char *name, const CallbackProfiler::Summary &summary) {
+        printf("  %-11s p50 %7.1f  p99 %7.1f  max %7.1f us\n", name, summary.p50Us,
+               summary.p99Us, summary.maxUs);
+    };
+    printf("Profile: %d voices (%d spatialized, peak %d), %llu/%llu deadline misses\n",
+           profile.voices, profile.spatializedVoices, profile.peakVoices,
+           static_cast<unsigned long long>(profile.deadlineMisses),
+           static_cast<unsigned long long>(profile.callbacks));
+    auto pool = mixer.getEffectPoolStats();
+    printf("Effect pool: %llu hits, %llu misses, %d idle, %d in use\n",
+           static_cast<unsigned long long>(pool.hits),
+           static_cast<unsigned long long>(pool.misses), pool.idle, pool.inUse);
+    auto cache = WavDecoder::getCacheStats();
+    printf("Asset cache: %d entries (%d pinned), %zu/%zu KiB (%zu pinned), %llu hits, "
+           "%llu misses (%llu joined), %llu evictions\n", cache.entries, cache.pinnedEntries,
+           cache.bytes / 1024, cache.budget / 1024, cache.pinnedBytes / 1024,
+           static_cast<unsigned long long>(cache.hits),
+           static_cast<unsigned long long>(cache.misses),
+           static_cast<unsigned long long>(cache.joined),
+           static_cast<unsigned long long>(cache.evictions));
+    auto speech = ingest.jitterBuffer().getStats();
+    printf("Speech: %llu utterances, %llu late starts (max %.1f ms), %llu underruns (%.1f ms), "
+           "%llu stalls, pre-roll %.1f ms\n", static_cast<unsigned long long>(speech.utterances),
+           static_cast<unsigned long long>(speech.lateStarts), speech.maxStartDelayMs,
+           static_cast<unsigned long long>(speech.underruns), speech.underrunMs,
+           static_cast<unsigned long long>(speech.stalls), speech.preRollMs);
+    printSummary("callback", profile.callback);
+    for (int stage = 0; stage < CallbackProfiler::STAGE_COUNT; stage++)
+        printSummary(stageNames[stage], profile.stages[stage]);
+    for (int category = 0; category < CallbackProfiler::CATEGORY_COUNT; category++)
+        printSummary(categoryNames[category], profile.categories[category]);
+
+    for (auto &item: transient)
+        mixer.removeSource(std::move(item.source));
+    for (auto &beacon: beacons)
+        mixer.removeSource(std::move(beacon.source));
+    mixer.removeSource(std::move(proximity.source));
+    mixer.stop();
+    return 0;
+}
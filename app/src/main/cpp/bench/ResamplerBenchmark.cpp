@@ -0,0 +1,265 @@
+//
+// Compares the polyphase resampler WavDecoder uses, at each quality, against the linear
+// interpolation it used before. Reports throughput in millions of output samples per second on
+// one thread, and THD+N for sine tones: everything in the output other than the tone itself,
+// relative to the tone, so lower is better. Interpolation errors and aliasing both count.
+//
+// Then does the same for text to speech, streamed through a resampler one callback at a time as
+// TtsAudioSource did before TtsIngest, comparing PolyphaseResampler with the SimpleResampler it
+// replaced. Input which a resampler was given but didn't use is lost, as it was read from the
+// socket, so the share of input dropped is reported too; dropping any shifts pitch, which THD+N
+// then includes.
+//
+//   resampler-benchmark [--from HZ] [--to HZ] [--seconds N]
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "MixKernels.h"
+#include "PolyphaseFilter.h"
+#include "PolyphaseResampler.h"
+
+using namespace soundscape;
+
+namespace {
+
+    using Resample = std::function<void(const std::vector<float> &, std::vector<float> &)>;
+
+    // WavDecoder::resampleTo as it was
+    void resampleLinear(const std::vector<float> &samples, std::vector<float> &resampled,
+                        double ratio) {
+        for (size_t i = 0; i < resampled.size(); i++) {
+            double srcPos = i * ratio;
+            int srcIdx = static_cast<int>(srcPos);
+            float frac = static_cast<float>(srcPos - srcIdx);
+
+            if (srcIdx + 1 < static_cast<int>(samples.size())) {
+                resampled[i] = samples[srcIdx] * (1.0f - frac) + samples[srcIdx + 1] * frac;
+            } else if (srcIdx < static_cast<int>(samples.size())) {
+                resampled[i] = samples[srcIdx];
+            } else {
+                resampled[i] = 0.0f;
+            }
+        }
+    }
+
+    // SimpleResampler as TtsAudioSource used it: each callback reads as many frames as it
+    // estimated it needed and drops whatever the resampler didn't consume
+    class SimpleStream {
+    public:
+        explicit SimpleStream(double ratio) : m_Ratio(ratio) {}
+
+        int inputFramesNeeded(int outputFrames) const {
+            return static_cast<int>(ceil(outputFrames * m_Ratio)) + 1;
+        }
+
+        int process(const float *input, int inputFrames, float *output, int maxOutputFrames,
+                    int &inputFramesConsumed) {
+            int outWritten = 0;
+            while (outWritten < maxOutputFrames) {
+                int srcIdx = static_cast<int>(m_SrcPos);
+                float frac = static_cast<float>(m_SrcPos - srcIdx);
+                if (srcIdx >= inputFrames)
+                    break;
+                float next = srcIdx + 1 < inputFrames ? input[srcIdx + 1] : input[srcIdx];
+                output[outWritten++] = input[srcIdx] * (1.0f - frac) + next * frac;
+                m_SrcPos += m_Ratio;
+            }
+            inputFramesConsumed = std::min(static_cast<int>(m_SrcPos), inputFrames);
+            m_SrcPos -= inputFramesConsumed;
+            return outWritten;
+        }
+
+    private:
+        double m_Ratio;
+        double m_SrcPos = 0.0;
+    };
+
+    // Feed input through stream a callback at a time, reading what it asks for and, as
+    // TtsAudioSource does, not giving it back whatever it doesn't consume
+    // Returns the frames dropped.
+    template<typename Stream>
+    size_t streamThrough(Stream &stream, const std::vector<float> &input, std::vector<float> &out,
+                         int callbackFrames) {
+        size_t read = 0;
+        size_t written = 0;
+        size_t dropped = 0;
+        while (written + callbackFrames <= out.size()) {
+            int needed = stream.inputFramesNeeded(callbackFrames);
+            if (read + needed > input.size())
+                break;
+            int consumed;
+            written += stream.process(input.data() + read, needed, out.data() + written,
+                                      callbackFrames, consumed);
+            read += needed;
+            dropped += needed - consumed;
+        }
+        out.resize(written);
+        return dropped;
+    }
+
+    std::vector<float> tone(double frequency, int rate, int frames) {
+        std::vector<float> samples(frames);
+        for (int i = 0; i < frames; i++)
+            samples[i] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * frequency * i / rate));
+        return samples;
+    }
+
+    // Least squares fit of a sine at frequency over the middle of the output, away from the
+    // ends, and the power of what's left relative to it, in dB
+    double thdPlusNoise(const std::vector<float> &out, double frequency, int rate) {
+        size_t margin = out.size() / 10;
+        double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+        for (size_t i = margin; i < out.size() - margin; i++) {
+            double phase = 2.0 * M_PI * frequency * i / rate;
+            double s = std::sin(phase), c = std::cos(phase);
+            ss += s * s;
+            sc += s * c;
+            cc += c * c;
+            ys += out[i] * s;
+            yc += out[i] * c;
+        }
+        double det = ss * cc - sc * sc;
+        double a = (ys * cc - yc * sc) / det;
+        double b = (yc * ss - ys * sc) / det;
+
+        double signal = 0, residual = 0;
+        for (size_t i = margin; i < out.size() - margin; i++) {
+            double phase = 2.0 * M_PI * frequency * i / rate;
+            double fit = a * std::sin(phase) + b * std::cos(phase);
+            signal += fit * fit;
+            residual += (out[i] - fit) * (out[i] - fit);
+        }
+        return 10.0 * std::log10(residual / signal);
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    int from = 44100;
+    int to = 48000;
+    int seconds = 10;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--from" && i + 1 < argc)
+            from = atoi(argv[++i]);
+        else if (arg == "--to" && i + 1 < argc)
+            to = atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--from HZ] [--to HZ] [--seconds N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct Candidate {
+        const char *name;
+        Resample resample;
+    };
+    double ratio = static_cast<double>(from) / to;
+    std::vector<Candidate> candidates = {
+            {"linear (before)", [ratio](const std::vector<float> &in, std::vector<float> &out) {
+                resampleLinear(in, out, ratio);
+            }}
+    };
+    const std::pair<const char *, ResampleQuality> qualities[] = {
+            {"polyphase LOW", ResampleQuality::LOW},
+            {"polyphase MEDIUM", ResampleQuality::MEDIUM},
+            {"polyphase HIGH", ResampleQuality::HIGH},
+    };
+    for (const auto &[name, quality]: qualities) {
+        auto filter = PolyphaseFilter::get(from, to, quality);
+        candidates.push_back({name, [filter](const std::vector<float> &in,
+                                             std::vector<float> &out) {
+            filter->process(in.data(), 0, static_cast<int>(in.size()), out.data(), 0,
+                            static_cast<int>(out.size()));
+        }});
+    }
+
+    const double tones[] = {1000.0, 10000.0, 0.45 * std::min(from, to)};
+    int inFrames = from * seconds;
+    auto outFrames = static_cast<int>(inFrames / ratio);
+
+    printf("%d Hz -> %d Hz, %s kernels\n", from, to, kernels::implementationName());
+    printf("%-18s %12s", "", "Msamples/s");
+    for (double frequency: tones)
+        printf("   THD+N %5.0f Hz", frequency);
+    printf("\n");
+
+    for (const auto &candidate: candidates) {
+        std::vector<float> out(outFrames);
+
+        std::vector<double> rates;
+        std::vector<float> input = tone(tones[0], from, inFrames);
+        for (int run = 0; run < 5; run++) {
+            auto start = std::chrono::steady_clock::now();
+            candidate.resample(input, out);
+            double elapsed = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+            rates.push_back(outFrames / elapsed / 1e6);
+        }
+        std::sort(rates.begin(), rates.end());
+        printf("%-18s %12.1f", candidate.name, rates[rates.size() / 2]);
+
+        for (double frequency: tones) {
+            candidate.resample(tone(frequency, from, inFrames), out);
+            printf("   %11.1f dB", thdPlusNoise(out, frequency, to));
+        }
+        printf("\n");
+    }
+
+    const int callbackFrames = 1024;
+    for (int ttsRate: {22050, 24000}) {
+        printf("\nText to speech %d Hz -> %d Hz in %d frame callbacks\n", ttsRate, to,
+               callbackFrames);
+        printf("%-18s %12s %10s", "", "Msamples/s", "dropped");
+        for (double frequency: {1000.0, 5000.0})
+            printf("   THD+N %5.0f Hz", frequency);
+        printf("\n");
+
+        int inFrames = ttsRate * seconds;
+        auto streamFrames = static_cast<int>(static_cast<double>(inFrames) * to / ttsRate);
+        for (int polyphase = 0; polyphase < 2; polyphase++) {
+            size_t dropped = 0;
+            auto run = [&](const std::vector<float> &input, std::vector<float> &out) {
+                out.assign(streamFrames, 0.0f);
+                if (polyphase) {
+                    PolyphaseResampler resampler;
+                    resampler.setRates(ttsRate, to);
+                    dropped = streamThrough(resampler, input, out, callbackFrames);
+                } else {
+                    SimpleStream resampler(static_cast<double>(ttsRate) / to);
+                    dropped = streamThrough(resampler, input, out, callbackFrames);
+                }
+            };
+
+            std::vector<float> input = tone(1000.0, ttsRate, inFrames);
+            std::vector<float> out;
+            std::vector<double> rates;
+            for (int i = 0; i < 5; i++) {
+                auto start = std::chrono::steady_clock::now();
+                run(input, out);
+                double elapsed = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+                rates.push_back(out.size() / elapsed / 1e6);
+            }
+            std::sort(rates.begin(), rates.end());
+            printf("%-18s %12.1f %9.2f%%", polyphase ? "PolyphaseResampler" : "SimpleResampler",
+                   rates[rates.size() / 2], 100.0 * dropped / inFrames);
+
+            for (double frequency: {1000.0, 5000.0}) {
+                run(tone(frequency, ttsRate, inFrames), out);
+                printf("   %11.1f dB", thdPlusNoise(out, frequency, to));
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+//
+// Compares the CPU cost per callback of the two HRTF render modes as the number of voices grows:
+// a binaural effect per source, against encoding every source into a shared ambisonics bus with
+// a single binaural decode. Each is measured for both spatializers, Steam Audio and the built in
+// convolution renderer. Run it on the device with:
+//
+//   adb push spatializer-benchmark /data/local/tmp
+//   adb shell LD_LIBRARY_PATH=/data/local/tmp /data/local/tmp/spatializer-benchmark
+//
+// (libphonon.so and libc++_shared.so need to be pushed alongside it).
+//
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+#include "MixKernels.h"
+#include "Spatializer.h"
+#include "BenchUtils.h"
+
+using namespace soundscape;
+
+namespace {
+
+    constexpr int SAMPLE_RATE = 48000;
+    constexpr int FRAMES = 1024;
+    constexpr int CALLBACKS = 200;
+    const int VOICE_COUNTS[] = {1, 2, 4, 8, 16, 32};
+
+    // Returns average microseconds per callback
+    double run(Spatializer &spatializer,
+               const std::vector<Spatializer::EffectHandle> &effects,
+               int voices, int ambisonicsOrder,
+               const std::vector<float> &mono, std::vector<float> &binaural,
+               std::vector<float> &output) {
+        float *left = output.data();
+        float *right = output.data() + FRAMES;
+        bench::CycleCounter counter;
+        counter.start();
+        for (int callback = 0; callback < CALLBACKS; callback++) {
+            std::fill(output.begin(), output.end(), 0.0f);
+            if (ambisonicsOrder > 0)
+                spatializer.beginAmbisonicsBlock(ambisonicsOrder);
+
+            for (int v = 0; v < voices; v++) {
+                // Spread the voices around the listener and keep them moving
+                float az = static_cast<float>(2.0 * M_PI * v / voices + callback * 0.01);
+                if (ambisonicsOrder > 0) {
+                    spatializer.encodeToAmbisonics(effects[v], mono.data(), FRAMES,
+                                                   az, 0.0f, 0.5f);
+                } else {
+                    spatializer.spatialize(effects[v], mono.data(), binaural.data(),
+                                           binaural.data() + FRAMES, FRAMES, az, 0.0f);
+                    kernels::accumulateWithGain(left, binaural.data(), 0.5f, FRAMES);
+                    kernels::accumulateWithGain(right, binaural.data() + FRAMES, 0.5f, FRAMES);
+                }
+            }
+            if (ambisonicsOrder > 0)
+                spatializer.decodeAmbisonics(left, right, FRAMES);
+            bench::doNotOptimize(output.data());
+        }
+        uint64_t cycles;
+        return counter.stop(cycles) / 1000.0 / CALLBACKS;
+    }
+
+} // namespace
+
+int main() {
+    std::vector<float> mono(FRAMES);
+    for (int i = 0; i < FRAMES; i++)
+        mono[i] = 0.25f * sinf(static_cast<float>(2.0 * M_PI * 440.0 * i / SAMPLE_RATE));
+    // Planar, left then right, as the mixer uses them
+    std::vector<float> binaural(FRAMES * 2);
+    std::vector<float> output(FRAMES * 2);
+
+    double budget = 1e6 * FRAMES / SAMPLE_RATE;
+    printf("Microseconds per %d frame callback (budget %.0f us), %s kernels\n", FRAMES, budget,
+           kernels::implementationName());
+
+    for (auto type: {SpatializerType::STEAM_AUDIO, SpatializerType::CONVOLUTION}) {
+        auto spatializer = createSpatializer(type, SAMPLE_RATE, FRAMES);
+        if (!spatializer || !spatializer->isInitialized()) {
+            printf("Failed to initialise spatializer %d\n", static_cast<int>(type));
+            return 1;
+        }
+
+        std::vector<Spatializer::EffectHandle> effects;
+        for (int v = 0; v < VOICE_COUNTS[std::size(VOICE_COUNTS) - 1]; v++)
+            effects.push_back(spatializer->createSourceEffect());
+
+        printf("\n%s\n", spatializer->getName());
+        printf("%8s %16s %16s %16s\n", "voices", "per-source", "ambisonics o1", "ambisonics o2");
+        for (int voices: VOICE_COUNTS) {
+            double perSource = run(*spatializer, effects, voices, 0, mono, binaural, output);
+            double order1 = run(*spatializer, effects, voices, 1, mono, binaural, output);
+            double order2 = run(*spatializer, effects, voices, 2, mono, binaural, output);
+            printf("%8d %16.1f %16.1f %16.1f\n", voices, perSource, order1, order2);
+        }
+
+        for (auto &effect: effects)
+            spatializer->removeSourceEffect(effect);
+    }
+    return 0;
+}
@@ -0,0 +1,264 @@
+//
+// Stand-in for the parts of Steam Audio that SteamAudioSpatializer uses, for host builds where
+// libphonon isn't available. It spatializes with a simple interaural time and level difference
+// rather than an HRTF, and decodes ambisonics to a pair of virtual microphones, so output is
+// plausible but CPU cost is much lower than the real library. Use a host build of phonon
+// (SOUNDSCAPE_PHONON_LIBRARY) when measuring spatializer cost.
+//
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "phonon.h"
+
+struct _IPLContext_t {
+    int refs = 1;
+};
+
+struct _IPLHRTF_t {
+    int refs = 1;
+};
+
+struct _IPLBinauralEffect_t {
+    int refs = 1;
+    int sampleRate = 48000;
+    int maxDelay = 0;
+    std::vector<float> history;     // last maxDelay input samples
+    std::vector<float> delayed;     // history followed by the current block
+    float leftGain = -1.0f;
+    float rightGain = -1.0f;
+};
+
+struct _IPLAmbisonicsEncodeEffect_t {
+    int refs = 1;
+    int maxOrder = 0;
+};
+
+struct _IPLAmbisonicsBinauralEffect_t {
+    int refs = 1;
+    int maxOrder = 0;
+};
+
+namespace {
+
+    constexpr float MAX_ITD_SECONDS = 0.00066f;
+    constexpr int MAX_CHANNELS = 9;     // order 2
+
+    // Azimuth in radians, 0 ahead and positive to the right, from a Steam Audio direction
+    float azimuthOf(const IPLVector3 &direction) {
+        return atan2f(direction.x, -direction.z);
+    }
+
+    // Real spherical harmonics, ACN channel order with SN3D normalisation, for a Steam Audio
+    // direction (+x right, +y up, -z ahead)
+    int sphericalHarmonics(const IPLVector3 &direction, int order, float *coefficients) {
+        float length = sqrtf(direction.x * direction.x + direction.y * direction.y +
+                             direction.z * direction.z);
+        int channels = (order + 1) * (order + 1);
+        std::fill(coefficients, coefficients + channels, 0.0f);
+        coefficients[0] = 1.0f;
+        if (length <= 0.0f)
+            return channels;
+
+        // Ambisonics axes: x ahead, y left, z up
+        float x = -direction.z / length;
+        float y = -direction.x / length;
+        float z = direction.y / length;
+        if (order >= 1) {
+            coefficients[1] = y;
+            coefficients[2] = z;
+            coefficients[3] = x;
+        }
+        if (order >= 2) {
+            const float root3 = sqrtf(3.0f);
+            coefficients[4] = root3 * x * y;
+            coefficients[5] = root3 * y * z;
+            coefficients[6] = 0.5f * (3.0f * z * z - 1.0f);
+            coefficients[7] = root3 * x * z;
+            coefficients[8] = 0.5f * root3 * (x * x - y * y);
+        }
+        return channels;
+    }
+
+} // namespace
+
+extern "C" {
+
+IPLerror IPLCALL iplContextCreate(IPLContextSettings * /*settings*/, IPLContext *context) {
+    *context = new _IPLContext_t;
+    return IPL_STATUS_SUCCESS;
+}
+
+void IPLCALL iplContextRelease(IPLContext *context) {
+    if (context && *context && --(*context)->refs == 0)
+        delete *context;
+    if (context)
+        *context = nullptr;
+}
+
+IPLerror IPLCALL iplHRTFCreate(IPLContext /*context*/, IPLAudioSettings * /*audioSettings*/,
+                               IPLHRTFSettings * /*hrtfSettings*/, IPLHRTF *hrtf) {
+    *hrtf = new _IPLHRTF_t;
+    return IPL_STATUS_SUCCESS;
+}
+
+void IPLCALL iplHRTFRelease(IPLHRTF *hrtf) {
+    if (hrtf && *hrtf && --(*hrtf)->refs == 0)
+        delete *hrtf;
+    if (hrtf)
+        *hrtf = nullptr;
+}
+
+IPLerror IPLCALL iplBinauralEffectCreate(IPLContext /*context*/, IPLAudioSettings *audioSettings,
+                                         IPLBinauralEffectSettings * /*effectSettings*/,
+                                         IPLBinauralEffect *effect) {
+    auto *created = new _IPLBinauralEffect_t;
+    created->sampleRate = audioSettings->samplingRate;
+    created->maxDelay = static_cast<int>(ceilf(MAX_ITD_SECONDS *
+                                               static_cast<float>(created->sampleRate)));
+    created->history.assign(created->maxDelay, 0.0f);
+    created->delayed.resize(created->maxDelay + audioSettings->frameSize);
+    *effect = created;
+    return IPL_STATUS_SUCCESS;
+}
+
+void IPLCALL iplBinauralEffectRelease(IPLBinauralEffect *effect) {
+    if (effect && *effect && --(*effect)->refs == 0)
+        delete *effect;
+    if (effect)
+        *effect = nullptr;
+}
+
+void IPLCALL iplBinauralEffectReset(IPLBinauralEffect effect) {
+    std::fill(effect->history.begin(), effect->history.end(), 0.0f);
+    effect->leftGain = -1.0f;
+    effect->rightGain = -1.0f;
+}
+
+IPLAudioEffectState IPLCALL iplBinauralEffectApply(IPLBinauralEffect effect,
+                                                   IPLBinauralEffectParams *params,
+                                                   IPLAudioBuffer *in, IPLAudioBuffer *out) {
+    const int frames = in->numSamples;
+    const int maxDelay = effect->maxDelay;
+    if (static_cast<int>(effect->delayed.size()) < maxDelay + frames)
+        effect->delayed.resize(maxDelay + frames);
+
+    // Far ear is delayed and quieter; gains ramp across the block to avoid zipper noise
+    float pan = sinf(azimuthOf(params->direction));
+    float leftGain = sqrtf(0.5f * (1.0f - pan)) * 0.8f + 0.2f;
+    float rightGain = sqrtf(0.5f * (1.0f + pan)) * 0.8f + 0.2f;
+    int leftDelay = pan > 0.0f ? static_cast<int>(pan * static_cast<float>(maxDelay)) : 0;
+    int rightDelay = pan < 0.0f ? static_cast<int>(-pan * static_cast<float>(maxDelay)) : 0;
+    if (effect->leftGain < 0.0f) {
+        effect->leftGain = leftGain;
+        effect->rightGain = rightGain;
+    }
+
+    float *delayed = effect->delayed.data();
+    memcpy(delayed, effect->history.data(), maxDelay * sizeof(float));
+    memcpy(delayed + maxDelay, in->data[0], frames * sizeof(float));
+
+    float *left = out->data[0];
+    float *right = out->data[1];
+    float step = frames > 0 ? 1.0f / static_cast<float>(frames) : 0.0f;
+    for (int i = 0; i < frames; i++) {
+        float t = static_cast<float>(i) * step;
+        float lg = effect->leftGain + (leftGain - effect->leftGain) * t;
+        float rg = effect->rightGain + (rightGain - effect->rightGain) * t;
+        left[i] = lg * delayed[maxDelay + i - leftDelay];
+        right[i] = rg * delayed[maxDelay + i - rightDelay];
+    }
+
+    memcpy(effect->history.data(), delayed + frames, maxDelay * sizeof(float));
+    effect->leftGain = leftGain;
+    effect->rightGain = rightGain;
+    return IPL_AUDIOEFFECTSTATE_TAILCOMPLETE;
+}
+
+IPLerror IPLCALL iplAmbisonicsEncodeEffectCreate(IPLContext /*context*/,
+                                                 IPLAudioSettings * /*audioSettings*/,
+                                                 IPLAmbisonicsEncodeEffectSettings *effectSettings,
+                                                 IPLAmbisonicsEncodeEffect *effect) {
+    auto *created = new _IPLAmbisonicsEncodeEffect_t;
+    created->maxOrder = std::min(effectSettings->maxOrder, 2);
+    *effect = created;
+    return IPL_STATUS_SUCCESS;
+}
+
+void IPLCALL iplAmbisonicsEncodeEffectRelease(IPLAmbisonicsEncodeEffect *effect) {
+    if (effect && *effect && --(*effect)->refs == 0)
+        delete *effect;
+    if (effect)
+        *effect = nullptr;
+}
+
+void IPLCALL iplAmbisonicsEncodeEffectReset(IPLAmbisonicsEncodeEffect /*effect*/) {
+}
+
+IPLAudioEffectState IPLCALL iplAmbisonicsEncodeEffectApply(IPLAmbisonicsEncodeEffect effect,
+                                                           IPLAmbisonicsEncodeEffectParams *params,
+                                                           IPLAudioBuffer *in,
+                                                           IPLAudioBuffer *out) {
+    float coefficients[MAX_CHANNELS];
+    int order = std::clamp(params->order, 0, effect->maxOrder);
+    int channels = std::min(sphericalHarmonics(params->direction, order, coefficients),
+                            out->numChannels);
+    const float *mono = in->data[0];
+    for (int ch = 0; ch < channels; ch++) {
+        float *channel = out->data[ch];
+        for (int i = 0; i < in->numSamples; i++)
+            channel[i] = coefficients[ch] * mono[i];
+    }
+    return IPL_AUDIOEFFECTSTATE_TAILCOMPLETE;
+}
+
+IPLerror IPLCALL iplAmbisonicsBinauralEffectCreate(IPLContext /*context*/,
+                                                   IPLAudioSettings * /*audioSettings*/,
+                                                   IPLAmbisonicsBinauralEffectSettings *effectSettings,
+                                                   IPLAmbisonicsBinauralEffect *effect) {
+    auto *created = new _IPLAmbisonicsBinauralEffect_t;
+    created->maxOrder = std::min(effectSettings->maxOrder, 2);
+    *effect = created;
+    return IPL_STATUS_SUCCESS;
+}
+
+void IPLCALL iplAmbisonicsBinauralEffectRelease(IPLAmbisonicsBinauralEffect *effect) {
+    if (effect && *effect && --(*effect)->refs == 0)
+        delete *effect;
+    if (effect)
+        *effect = nullptr;
+}
+
+void IPLCALL iplAmbisonicsBinauralEffectReset(IPLAmbisonicsBinauralEffect /*effect*/) {
+}
+
+IPLAudioEffectState IPLCALL iplAmbisonicsBinauralEffectApply(IPLAmbisonicsBinauralEffect effect,
+                                                             IPLAmbisonicsBinauralEffectParams *params,
+                                                             IPLAudioBuffer *in,
+                                                             IPLAudioBuffer *out) {
+    // Sample the sound field at the left and right ears
+    float left[MAX_CHANNELS];
+    float right[MAX_CHANNELS];
+    int order = std::clamp(params->order, 0, effect->maxOrder);
+    int channels = std::min(sphericalHarmonics(IPLVector3{-1.0f, 0.0f, 0.0f}, order, left),
+                            in->numChannels);
+    sphericalHarmonics(IPLVector3{1.0f, 0.0f, 0.0f}, order, right);
+    float scale = 1.0f / static_cast<float>(order + 1);
+
+    float *leftOut = out->data[0];
+    float *rightOut = out->data[1];
+    for (int i = 0; i < in->numSamples; i++) {
+        float l = 0.0f;
+        float r = 0.0f;
+        for (int ch = 0; ch < channels; ch++) {
+            l += left[ch] * in->data[ch][i];
+            r += right[ch] * in->data[ch][i];
+        }
+        leftOut[i] = l * scale;
+        rightOut[i] = r * scale;
+    }
+    return IPL_AUDIOEFFECTSTATE_TAILCOMPLETE;
+}
+
+} // extern "C"
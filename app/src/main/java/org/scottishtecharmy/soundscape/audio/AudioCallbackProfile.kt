@@ -0,0 +1,71 @@
+package org.scottishtecharmy.soundscape.audio
+
+/**
+ * Timing of one part of the native audio callback over the last few seconds, in microseconds.
+ */
+data class CallbackTiming(val p50Us: Double, val p99Us: Double, val maxUs: Double)
+
+/**
+ * Snapshot of the native mixer's real-time behaviour, from NativeAudioEngine.getCallbackProfile.
+ * Percentiles cover roughly the last 5-10 seconds; counts are since the output was created.
+ */
+data class AudioCallbackProfile(
+    val budgetUs: Double,
+    val callbacks: Long,
+    val deadlineMisses: Long,
+    val voices: Int,
+    val spatializedVoices: Int,
+    val peakVoices: Int,
+    val callbackContention: Long,
+    val xRunCount: Int,
+    val bufferSizeInFrames: Int,
+    val lowLatency: Boolean,
+    val effectPoolHits: Long,
+    val effectPoolMisses: Long,
+    val callback: CallbackTiming,
+    val read: CallbackTiming,
+    val spatialize: CallbackTiming,
+    val pan: CallbackTiming,
+    val mix: CallbackTiming,
+    val clamp: CallbackTiming,
+    val beacons: CallbackTiming,
+    val speech: CallbackTiming,
+) {
+    companion object {
+        private const val COUNTERS = 12
+        private const val TIMINGS = 8
+
+        /**
+         * Unpacks the flat array returned over JNI, see AudioEngine::GetCallbackProfile
+         */
+        fun fromArray(values: DoubleArray): AudioCallbackProfile? {
+            if (values.size < COUNTERS + TIMINGS * 3) return null
+            fun timing(index: Int): CallbackTiming {
+                val offset = COUNTERS + index * 3
+                return CallbackTiming(values[offset], values[offset + 1], values[offset + 2])
+            }
+            return AudioCallbackProfile(
+                budgetUs = values[0],
+                callbacks = values[1].toLong(),
+                deadlineMisses = values[2].toLong(),
+                voices = values[3].toInt(),
+                spatializedVoices = values[4].toInt(),
+                peakVoices = values[5].toInt(),
+                callbackContention = values[6].toLong(),
+                xRunCount = values[7].toInt(),
+                bufferSizeInFrames = values[8].toInt(),
+                lowLatency = values[9] != 0.0,
+                effectPoolHits = values[10].toLong(),
+                effectPoolMisses = values[11].toLong(),
+                callback = timing(0),
+                read = timing(1),
+                spatialize = timing(2),
+                pan = timing(3),
+                mix = timing(4),
+                clamp = timing(5),
+                beacons = timing(6),
+                speech = timing(7),
+            )
+        }
+    }
+}
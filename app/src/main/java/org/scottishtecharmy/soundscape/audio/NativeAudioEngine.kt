@@ -13,7 +13,9 @@ import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.Job
 import kotlinx.coroutines.cancel
 import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.MutableSharedFlow
 import kotlinx.coroutines.flow.MutableStateFlow
+import kotlinx.coroutines.flow.asSharedFlow
 import kotlinx.coroutines.flow.asStateFlow
 import kotlinx.coroutines.launch
 import org.jetbrains.compose.resources.getString
@@ -60,7 +62,17 @@ class NativeAudioEngine(val service: SoundscapeService? = null) : AudioEngine {
         longitude: Double,
         heading: Double,
         ttsSocket: Int,
-        utteranceId: String
+        utteranceId: String,
+        cacheKey: String
+    ): Long
+
+    external fun createNativeCachedTextToSpeech(
+        engineHandle: Long,
+        mode: Int,
+        latitude: Double,
+        longitude: Double,
+        heading: Double,
+        cacheKey: String
     ): Long
 
     private external fun audioConfigTextToSpeech(
@@ -96,7 +108,22 @@ class NativeAudioEngine(val service: SoundscapeService? = null) : AudioEngine {
     private external fun setBeaconType(engineHandle: Long, beaconType: String)
     private external fun getListOfBeacons(): Array<String>
     private external fun setHrtfEnabled(engineHandle: Long, enabled: Boolean)
+    private external fun setAmbisonicsOrder(engineHandle: Long, order: Int)
+    private external fun setLowLatencyMode(engineHandle: Long, enabled: Boolean)
+    private external fun setProcessingBlockSize(engineHandle: Long, frames: Int)
+    private external fun setSpatializerType(engineHandle: Long, type: Int)
+    private external fun getCallbackProfile(engineHandle: Long): DoubleArray?
+    private external fun setSpeechBuffering(
+        engineHandle: Long,
+        preRollMs: Int,
+        maxPreRollMs: Int,
+        startTimeoutMs: Int,
+        stallTimeoutMs: Int
+    )
+    private external fun getSpeechBufferStats(engineHandle: Long): DoubleArray?
     private external fun setSuppressRestart(engineHandle: Long, suppress: Boolean)
+    private external fun trimMemory(level: Int)
+    private external fun getNativeSpeechCacheStats(): DoubleArray?
 
     private var _ttsRunningStateChange = MutableStateFlow(false)
     val ttsRunningStateChange = _ttsRunningStateChange.asStateFlow()
@@ -456,6 +483,131 @@ class NativeAudioEngine(val service: SoundscapeService? = null) : AudioEngine {
         }
     }
 
+    /**
+     * Selects how HRTF spatialization is rendered. 0 uses a binaural effect per source, 1 or 2
+     * mixes all sources into an ambisonics bus of that order with a single binaural decode, which
+     * keeps the CPU cost flat as the number of beacons and callouts grows.
+     */
+    fun setAmbisonicsOrder(order: Int) {
+        synchronized(engineMutex) {
+            if (engineHandle != 0L)
+                setAmbisonicsOrder(engineHandle, order)
+        }
+    }
+
+    /**
+     * Requests a low latency output stream, which follows head turns more closely at the cost of
+     * more CPU wakeups. Routes which can't support it, such as Bluetooth A2DP, carry on with the
+     * normal stream. The output is reopened when the setting changes.
+     */
+    fun setLowLatencyMode(enabled: Boolean) {
+        synchronized(engineMutex) {
+            if (engineHandle != 0L)
+                setLowLatencyMode(engineHandle, enabled)
+        }
+    }
+
+    /**
+     * Sets the block size, in frames, that spatialization runs at, independently of the size of
+     * the output's callbacks. Small blocks such as 128 or 256 reduce latency, large ones reduce
+     * CPU use. 0 follows the output's block size, which is the default.
+     */
+    fun setProcessingBlockSize(frames: Int) {
+        synchronized(engineMutex) {
+            if (engineHandle != 0L)
+                setProcessingBlockSize(engineHandle, frames)
+        }
+    }
+
+    /**
+     * Selects the HRTF renderer: SPATIALIZER_STEAM_AUDIO (the default), or
+     * SPATIALIZER_CONVOLUTION for the built in partitioned convolution renderer, which needs no
+     * third party library. The output is reopened when the setting changes.
+     */
+    fun setSpatializerType(type: Int) {
+        synchronized(engineMutex) {
+            if (engineHandle != 0L)
+                setSpatializerType(engineHandle, type)
+        }
+    }
+
+    /**
+     * Returns timing of the native audio callback, broken down by stage and by source category,
+     * along with deadline misses, voice counts and output underruns. Cheap enough to poll for
+     * field diagnostics. Returns null if the engine isn't running.
+     */
+    fun getCallbackProfile(): AudioCallbackProfile? {
+        synchronized(engineMutex) {
+            if (engineHandle == 0L) return null
+            return getCallbackProfile(engineHandle)?.let { AudioCallbackProfile.fromArray(it) }
+        }
+    }
+
+    /**
+     * Sets how text to speech is buffered. Each utterance buffers at least preRollMs before it
+     * starts, more if the synthesizer has been delivering slower than real time or running dry,
+     * up to maxPreRollMs. An utterance whose audio hasn't started arriving after startTimeoutMs
+     * is abandoned, and once it has, a pause of a few times the longest gap seen between
+     * arrivals, up to stallTimeoutMs, ends it.
+     */
+    fun setSpeechBuffering(
+        preRollMs: Int = 40,
+        maxPreRollMs: Int = 600,
+        startTimeoutMs: Int = 3000,
+        stallTimeoutMs: Int = 2000
+    ) {
+        synchronized(engineMutex) {
+            if (engineHandle != 0L)
+                setSpeechBuffering(
+                    engineHandle,
+                    preRollMs,
+                    maxPreRollMs,
+                    startTimeoutMs,
+                    stallTimeoutMs
+                )
+        }
+    }
+
+    /**
+     * Returns how text to speech has been buffering: late starts, underruns and stalls, and the
+     * pre-roll the next utterance will use. Returns null if the engine isn't running.
+     */
+    fun getSpeechBufferStats(): SpeechBufferStats? {
+        synchronized(engineMutex) {
+            if (engineHandle == 0L) return null
+            return getSpeechBufferStats(engineHandle)?.let { SpeechBufferStats.fromArray(it) }
+        }
+    }
+
+    /**
+     * How well the cache of synthesized speech is doing, shared by every engine. Returns null if
+     * the stats couldn't be read.
+     */
+    fun getSpeechCacheStats(): SpeechCacheStats? {
+        return getNativeSpeechCacheStats()?.let { SpeechCacheStats.fromArray(it) }
+    }
+
+    /**
+     * Sets how many bytes of synthesized speech are kept for reuse, 6 MiB by default. Speech
+     * which is playing is always kept, and counts towards the budget.
+     */
+    external fun setSpeechCacheBudget(bytes: Long)
+
+    /**
+     * Releases decoded audio assets and cached speech which aren't playing, more of them the
+     * higher the level.
+     * Pass on the level from ComponentCallbacks2.onTrimMemory.
+     */
+    fun onTrimMemory(level: Int) {
+        trimMemory(level)
+    }
+
+    /**
+     * Sets how many bytes of decoded audio assets are kept cached for reuse, 8 MiB by default.
+     * Assets which are playing are always kept, and count towards the budget.
+     */
+    external fun setAssetCacheBudget(bytes: Long)
+
     fun setSuppressRestart(suppress: Boolean) {
         synchronized(engineMutex) {
             if (engineHandle != 0L)
@@ -463,6 +615,21 @@ class NativeAudioEngine(val service: SoundscapeService? = null) : AudioEngine {
         }
     }
 
+    private val _audioFinished = MutableSharedFlow<Long>(extraBufferCapacity = 64)
+
+    /**
+     * Handles of speech and earcons as they finish playing, as soon as the engine has removed them.
+     */
+    val audioFinished = _audioFinished.asSharedFlow()
+
+    /**
+     * Called from JNI, on the engine's dispatcher thread, as soon as queued audio has finished and
+     * the next has been started. It must not wait on engineMutex.
+     */
+    fun onAudioFinished(handle: Long) {
+        _audioFinished.tryEmit(handle)
+    }
+
     /**
      * Called from JNI when all beacons have been cleared from the AudioEngine.
      */
@@ -489,6 +656,10 @@ class NativeAudioEngine(val service: SoundscapeService? = null) : AudioEngine {
             System.loadLibrary("soundscape-audio")
         }
 
+        // HRTF renderers for setSpatializerType, matching AudioEngine::SetSpatializerType
+        const val SPATIALIZER_STEAM_AUDIO = 0
+        const val SPATIALIZER_CONVOLUTION = 1
+
         // Earcon asset filenames
         const val EARCON_CALIBRATION_IN_PROGRESS =
             "file:///android_asset/Sounds/calibration_in_progress.wav"
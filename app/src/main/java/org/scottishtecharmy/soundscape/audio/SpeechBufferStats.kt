@@ -0,0 +1,39 @@
+package org.scottishtecharmy.soundscape.audio
+
+/**
+ * How text to speech has been buffering, from NativeAudioEngine.getSpeechBufferStats. Counts and
+ * totals are since the engine was created; times are in milliseconds of audio.
+ */
+data class SpeechBufferStats(
+    val utterances: Long,
+    val lateStarts: Long,
+    val startDelayMs: Double,
+    val maxStartDelayMs: Double,
+    val underruns: Long,
+    val underrunMs: Double,
+    val stalls: Long,
+    val preRollMs: Double,
+    val arrivalRate: Double,
+) {
+    companion object {
+        private const val VALUES = 9
+
+        /**
+         * Unpacks the flat array returned over JNI, see AudioEngine::GetSpeechBufferStats
+         */
+        fun fromArray(values: DoubleArray): SpeechBufferStats? {
+            if (values.size < VALUES) return null
+            return SpeechBufferStats(
+                utterances = values[0].toLong(),
+                lateStarts = values[1].toLong(),
+                startDelayMs = values[2],
+                maxStartDelayMs = values[3],
+                underruns = values[4].toLong(),
+                underrunMs = values[5],
+                stalls = values[6].toLong(),
+                preRollMs = values[7],
+                arrivalRate = values[8],
+            )
+        }
+    }
+}
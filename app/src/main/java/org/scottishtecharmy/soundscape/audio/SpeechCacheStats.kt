@@ -0,0 +1,38 @@
+package org.scottishtecharmy.soundscape.audio
+
+/**
+ * How the cache of synthesized speech is doing, from NativeAudioEngine.getSpeechCacheStats.
+ * Counts are since the app started.
+ */
+data class SpeechCacheStats(
+    val bytes: Long,
+    val budget: Long,
+    val entries: Int,
+    val hits: Long,
+    val misses: Long,
+    val insertions: Long,
+    val evictions: Long,
+) {
+    val hitRate: Double
+        get() = if (hits + misses > 0) hits.toDouble() / (hits + misses) else 0.0
+
+    companion object {
+        private const val VALUES = 7
+
+        /**
+         * Unpacks the flat array returned over JNI, see AudioEngine::GetSpeechCacheStats
+         */
+        fun fromArray(values: DoubleArray): SpeechCacheStats? {
+            if (values.size < VALUES) return null
+            return SpeechCacheStats(
+                bytes = values[0].toLong(),
+                budget = values[1].toLong(),
+                entries = values[2].toInt(),
+                hits = values[3].toLong(),
+                misses = values[4].toLong(),
+                insertions = values[5].toLong(),
+                evictions = values[6].toLong(),
+            )
+        }
+    }
+}
@@ -32,6 +32,7 @@ class TtsEngine(
     private lateinit var textToSpeech: TextToSpeech
     private var textToSpeechVoiceType = MainActivity.VOICE_TYPE_DEFAULT
     private var textToSpeechRate = 0.1f
+    private var textToSpeechLanguage = ""
 
     private var sharedPreferences: SharedPreferences? = null
     private var context: Context? = null
@@ -157,6 +158,7 @@ class TtsEngine(
             Log.e(TAG, "The Language not supported!")
             return false
         }
+        textToSpeechLanguage = language
         return true
     }
 
@@ -384,6 +386,20 @@ class TtsEngine(
         longitude: Double,
         heading: Double
     ): Long {
+        // The same callouts come round again and again, so play from the native speech cache
+        // if this has been heard before, skipping synthesis altogether
+        val cacheKey = speechCacheKey(text)
+        val cachedHandle = audioEngine.createNativeCachedTextToSpeech(
+            engineHandle,
+            type.type,
+            latitude,
+            longitude,
+            heading,
+            cacheKey
+        )
+        if (cachedHandle != 0L)
+            return cachedHandle
+
         val ttsSocketPair = ParcelFileDescriptor.createReliableSocketPair()
         val ttsSocket = ttsSocketPair[0]
 
@@ -402,12 +418,27 @@ class TtsEngine(
             longitude,
             heading,
             ttsSocketPair[1].fd,
-            utteranceId
+            utteranceId,
+            cacheKey
         )
         textToSpeech.synthesizeToFile(text, params, ttsSocket, utteranceId)
         return ttsHandle
     }
 
+    /**
+     * Identifies how text would sound with the current settings. Pitch isn't set by the app, so
+     * is the engine's default and covered by the engine and voice.
+     */
+    private fun speechCacheKey(text: String): String {
+        return listOf(
+            engineLabelAndName.orEmpty(),
+            textToSpeechLanguage,
+            textToSpeechVoiceType,
+            textToSpeechRate.toString(),
+            text
+        ).joinToString("\u0000")
+    }
+
     companion object {
         private const val TAG = "TTS"
     }
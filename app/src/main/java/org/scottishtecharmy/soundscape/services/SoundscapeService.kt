@@ -42,10 +42,12 @@ import kotlinx.coroutines.ensureActive
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.flow.collectLatest
+import kotlinx.coroutines.flow.first
 import kotlinx.coroutines.flow.flow
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.runBlocking
 import kotlinx.coroutines.withContext
+import kotlinx.coroutines.withTimeoutOrNull
 import org.jetbrains.compose.resources.getString
 import org.scottishtecharmy.soundscape.BuildConfig
 import org.scottishtecharmy.soundscape.MainActivity
@@ -583,6 +585,11 @@ class SoundscapeService : MediaSessionService(), GeoEngineListener, MediaControl
         Log.d(TAG, "onTaskRemoved for service - ignoring, as we want to keep running")
     }
 
+    override fun onTrimMemory(level: Int) {
+        super.onTrimMemory(level)
+        audioEngine.onTrimMemory(level)
+    }
+
     override fun onDestroy() {
         suppressionJob?.cancel()
 
@@ -880,8 +887,12 @@ class SoundscapeService : MediaSessionService(), GeoEngineListener, MediaControl
         beaconPreviewController.stop(commit, chosenBeaconType)
 
     private suspend fun awaitHandle(handle: Long) {
+        // Woken as soon as the engine reports the audio finished. The timeout covers it finishing
+        // between the check and the wait.
         while (handle != 0L && audioEngine.isHandleActive(handle)) {
-            delay(100)
+            withTimeoutOrNull(100) {
+                audioEngine.audioFinished.first { it == handle }
+            }
         }
     }
 